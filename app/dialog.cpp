@@ -7,6 +7,7 @@
 */
 
 #include "dialog.h"
+#include "log.h"
 #include "theme.h"
 
 Dialog::Dialog(QWidget *parent)
@@ -44,6 +45,7 @@ Dialog::Dialog(QWidget *parent)
     , backlightBatteryLowerCheck(0)
     , backlightACHigherCheck(0)
     , inhibitorTree(0)
+    , sleepTree(0)
     , warnOnLowBattery(0)
     , warnOnVeryLowBattery(0)
     , aboutButton(0)
@@ -608,6 +610,13 @@ Dialog::Dialog(QWidget *parent)
     inhibitorTree->setHeaderHidden(true);
     inhibitorTree->setStyleSheet("QTreeWidget {border:0;}");
 
+    // suspend/resume history
+    sleepTree = new QTreeWidget(this);
+    sleepTree->setHeaderLabels(QStringList() << tr("Suspended")
+                               << tr("Asleep") << tr("Resume"));
+    sleepTree->setRootIsDecorated(false);
+    sleepTree->setStyleSheet("QTreeWidget {border:0;}");
+
     // add tabs
     containerWidget->addTab(statusContainer,
                             QIcon::fromTheme(DEFAULT_INFO_ICON),
@@ -618,6 +627,9 @@ Dialog::Dialog(QWidget *parent)
     containerWidget->addTab(inhibitorTree,
                             QIcon::fromTheme(DEFAULT_VIDEO_ICON),
                             tr("Inhibitors"));
+    containerWidget->addTab(sleepTree,
+                            QIcon::fromTheme(DEFAULT_SUSPEND_ICON),
+                            tr("Sleep"));
 
     populate(); // populate boxes
     loadSettings(); // load settings
@@ -900,7 +912,7 @@ void Dialog::loadSettings()
     bool canSuspend = man->CanSuspend();
     bool canHibernate = man->CanHibernate() && Common::kernelCanResume(bypassKernel->isChecked());
     bool canShutdown = man->CanPowerOff();
-    qDebug() << "can suspend?" << canSuspend << "can hibernate?" << canHibernate << "can shutdown?" << canShutdown;
+    qCDebug(PK_TRAY) << "can suspend?" << canSuspend << "can hibernate?" << canHibernate << "can shutdown?" << canShutdown;
     QString notSupported = tr("%1 is not supported. Check permissions and/or settings.");
     sleepButton->setEnabled(canSuspend);
     hibernateButton->setEnabled(canHibernate &&
@@ -978,6 +990,9 @@ void Dialog::loadSettings()
 
     // check inhibitors
     getInhibitors();
+
+    // suspend history
+    getSuspendHistory();
 }
 
 void Dialog::saveSettings()
@@ -1293,10 +1308,11 @@ void Dialog::checkDevices()
         batteryLabel->setText(QString("<h1 style=\"font-weight:normal;\">%1</h1>").arg(tr("AC")));
     }
 
+    QVariantMap health = man->BatteryHealth();
     QMapIterator<QString, Device*> i(man->getDevices());
     while (i.hasNext()) {
         i.next();
-        //qDebug() << i.value()->name << i.value()->model << i.value()->type  << i.value()->isPresent << i.value()->objectName() << i.value()->percentage;
+        //qCDebug(PK_TRAY) << i.value()->name << i.value()->model << i.value()->type  << i.value()->isPresent << i.value()->objectName() << i.value()->percentage;
         QString uid = i.value()->path;
         if (!i.value()->isPresent) {
             if (deviceExists(uid)) { deviceRemove(uid); }
@@ -1327,6 +1343,9 @@ void Dialog::checkDevices()
         } else {
             devicesProg[i.value()->path]->setValue((int)i.value()->percentage);
         }
+        if (health.contains(i.value()->name)) {
+            devicesProg[uid]->setToolTip(healthText(health.value(i.value()->name).toMap()));
+        }
     }
 
     QIcon icon = QIcon::fromTheme(DEFAULT_AC_ICON);
@@ -1351,6 +1370,24 @@ void Dialog::checkDevices()
     batteryIcon->setPixmap(icon.pixmap(QSize(48, 48)));
 }
 
+QString Dialog::healthText(const QVariantMap &health)
+{
+    QString result = QString("%1: %2%").arg(tr("Health"))
+                     .arg(health.value("health").toDouble(), 0, 'f', 1);
+    result.append(QString("\n%1: %2").arg(tr("Charge cycles"))
+                  .arg(health.value("cycles").toDouble(), 0, 'f', 1));
+    double fade = health.value("fade_per_year").toDouble();
+    if (fade>=0) {
+        result.append(QString("\n%1: %2%").arg(tr("Capacity loss per year"))
+                      .arg(fade, 0, 'f', 1));
+    }
+    QString eol = health.value("end_of_life").toString();
+    if (!eol.isEmpty()) {
+        result.append(QString("\n%1: %2").arg(tr("Estimated end of life")).arg(eol));
+    }
+    return result;
+}
+
 bool Dialog::deviceExists(QString uid)
 {
     for (int i=0;i<deviceTree->topLevelItemCount();++i) {
@@ -1459,6 +1496,54 @@ void Dialog::getInhibitors()
     }
 }
 
+// newest first, stage latencies and kernel stats in the tooltip
+void Dialog::getSuspendHistory()
+{
+    sleepTree->clear();
+    QVariantMap report = man->SuspendHistory();
+    QVariantMap kernel = report.value("kernel").toMap();
+    QString kernelText;
+    if (!kernel.isEmpty()) {
+        kernelText = QString("\n%1: %2, %3: %4")
+                     .arg(tr("Kernel successful"))
+                     .arg(kernel.value("success").toLongLong())
+                     .arg(tr("failed"))
+                     .arg(kernel.value("fail").toLongLong());
+    }
+    QVariantList cycles = report.value("cycles").toList();
+    for (int i=cycles.size()-1;i>=0;--i) {
+        QVariantMap cycle = cycles.at(i).toMap();
+        qint64 asleep = cycle.value("asleep_msecs").toLongLong();
+        qint64 resume = cycle.value("resume_msecs").toLongLong();
+        QTreeWidgetItem *item = new QTreeWidgetItem(sleepTree);
+        item->setText(0, QDateTime::fromTime_t(cycle.value("start").toUInt())
+                         .toString("yyyy-MM-dd hh:mm"));
+        item->setText(1, asleep<0?tr("Suspended"):
+                         QDateTime::fromTime_t(asleep/1000).toUTC().toString("hh:mm:ss"));
+        item->setText(2, resume<0?QString("-"):QString("%1 ms").arg(resume));
+        item->setFlags(Qt::ItemIsEnabled);
+        item->setIcon(0, QIcon::fromTheme(cycle.value("failed").toBool()?
+                                          DEFAULT_NONE_ICON:DEFAULT_SUSPEND_ICON));
+        QStringList stages, labels;
+        stages << "devices_msecs" << "lock_msecs" << "tray_msecs" << "hw_sleep_msecs";
+        labels << tr("Devices refreshed") << tr("Screen locked")
+               << tr("Tray ready") << tr("Hardware sleep");
+        QStringList lines;
+        double drain = cycle.value("drain_wh_per_hour").toDouble();
+        if (drain>=0) {
+            lines << QString("%1: %2 W").arg(tr("Battery drain")).arg(drain, 0, 'f', 2);
+        }
+        for (int s=0;s<stages.size();++s) {
+            qint64 value = cycle.value(stages.at(s)).toLongLong();
+            if (value<0) { continue; }
+            lines << QString("%1: %2 ms").arg(labels.at(s)).arg(value);
+        }
+        QString tooltip = lines.join("\n");
+        tooltip.append(kernelText);
+        for (int c=0;c<3;++c) { item->setToolTip(c, tooltip); }
+    }
+}
+
 void Dialog::enableBacklight(bool enabled)
 {
     backlightSlider->setEnabled(enabled);
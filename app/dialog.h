@@ -100,6 +100,7 @@ private:
     QCheckBox *backlightBatteryLowerCheck;
     QCheckBox *backlightACHigherCheck;
     QTreeWidget *inhibitorTree;
+    QTreeWidget *sleepTree;
     QCheckBox *warnOnLowBattery;
     QCheckBox *warnOnVeryLowBattery;
     QPushButton *aboutButton;
@@ -142,6 +143,7 @@ private slots:
     void handleBacklightSlider(int value);
     void updateBacklight(QString file);
     void checkDevices();
+    QString healthText(const QVariantMap &health);
     bool deviceExists(QString uid);
     void deviceRemove(QString uid);
     void handleDeviceAdded(QString uid);
@@ -155,6 +157,7 @@ private slots:
     void handleBacklightACCheckHigher(bool triggered);
     void handleUpdatedInhibitors();
     void getInhibitors();
+    void getSuspendHistory();
     void enableBacklight(bool enabled);
     void showAboutDialog();
     void handleWarnOnLowBattery(bool triggered);
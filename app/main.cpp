@@ -11,9 +11,59 @@
 #include "dialog.h"
 
 #include "powerkit.h"
+#include "trace.h"
+#include "simulator.h"
+
+#include <QTextStream>
 
 int main(int argc, char *argv[])
 {
+    // replay a recorded policy trace, no display needed
+    if (argc>2 && QString(argv[1]) == "--replay") {
+        QCoreApplication app(argc, argv);
+        bool ok = false;
+        QList<TraceEvent> trace = TraceRecorder::read(QString::fromLocal8Bit(argv[2]), &ok);
+        if (trace.isEmpty()) {
+            qWarning() << QObject::tr("Unable to read trace") << argv[2];
+            return 1;
+        }
+        if (!ok) { qWarning() << QObject::tr("Trace is truncated"); }
+        TraceReplay replay;
+        replay.run(trace);
+        QTextStream(stdout) << replay.report();
+        return 0;
+    }
+
+    // what-if simulation of a trace with other settings,
+    // without settings files the current settings are used
+    if (argc>2 && QString(argv[1]) == "--simulate") {
+        QCoreApplication app(argc, argv);
+        QList<TraceEvent> trace = TraceRecorder::read(QString::fromLocal8Bit(argv[2]));
+        if (trace.isEmpty()) {
+            qWarning() << QObject::tr("Unable to read trace") << argv[2];
+            return 1;
+        }
+        QStringList names;
+        QList<PowerSettings> settings;
+        for (int i=3;i<argc;++i) {
+            names << QString::fromLocal8Bit(argv[i]);
+            settings << Simulator::loadSettings(names.last());
+        }
+        if (settings.isEmpty()) {
+            names << "current";
+            settings << PowerSettings::load();
+        }
+        Simulator simulator(trace);
+        QList<Simulator::Result> results = simulator.sweep(settings);
+        QTextStream out(stdout);
+        out << "# active drain " << simulator.activeRate() << " %/hour\n";
+        out << Simulator::header() << "\n";
+        for (int i=0;i<results.size();++i) {
+            out << Simulator::format(names.at(i), results.at(i)) << "\n";
+        }
+        return 0;
+    }
+
     QApplication a(argc, argv);
     QCoreApplication::setApplicationName("freedesktop");
     QCoreApplication::setOrganizationDomain("org");
@@ -9,6 +9,7 @@
 #include "systray.h"
 #include "def.h"
 #include "theme.h"
+#include "probes.h"
 #include <QMessageBox>
 #include <QApplication>
 
@@ -16,47 +17,31 @@ SysTray::SysTray(QObject *parent)
     : QObject(parent)
     , tray(0)
     , man(0)
+    , exporter(0)
     , pm(0)
     , ss(0)
-    , wasLowBattery(false)
-    , wasVeryLowBattery(false)
-    , lowBatteryValue(LOW_BATTERY)
-    , critBatteryValue(CRITICAL_BATTERY)
+    , maintenance(0)
     , hasService(false)
-    , lidActionBattery(LID_BATTERY_DEFAULT)
-    , lidActionAC(LID_AC_DEFAULT)
-    , criticalAction(CRITICAL_DEFAULT)
-    , autoSuspendBattery(AUTO_SLEEP_BATTERY)
-    , autoSuspendAC(0)
-    , timer(0)
-    , timeouts(0)
+    , idleTask(-1)
+    , criticalTimer(0)
+    , recorder(0)
     , showNotifications(true)
     , desktopSS(true)
     , desktopPM(true)
     , showTray(true)
-    , disableLidOnExternalMonitors(false)
-    , autoSuspendBatteryAction(suspendSleep)
-    , autoSuspendACAction(suspendNone)
     , xscreensaver(0)
     , startupScreensaver(true)
     , watcher(0)
     , lidXrandr(false)
-    , lidWasClosed(false)
     , hasBacklight(false)
-    , backlightOnBattery(false)
-    , backlightOnAC(false)
-    , backlightBatteryValue(0)
-    , backlightACValue(0)
-    , backlightBatteryDisableIfLower(false)
-    , backlightACDisableIfHigher(false)
     , configDialog(0)
-    , warnOnLowBattery(true)
-    , warnOnVeryLowBattery(true)
-    , notifyOnBattery(true)
-    , notifyOnAC(true)
     , backlightMouseWheel(true)
     , ignoreKernelResume(false)
+    , runtimePM(false)
+    , runtimePMDelay(RUNTIME_PM_DELAY)
 {
+    FlightRecorder::watchSignal(this);
+
     // setup tray
     tray = new TrayIcon(this);
     connect(tray,
@@ -70,6 +55,8 @@ SysTray::SysTray(QObject *parent)
 
     // setup manager
     man = new PowerKit(this);
+    man->setRecording(true);
+    exporter = new PrometheusExporter(man, this);
     connect(man,
             SIGNAL(UpdatedDevices()),
             this,
@@ -98,6 +85,10 @@ SysTray::SysTray(QObject *parent)
             SIGNAL(PrepareForResume()),
             this,
             SLOT(handlePrepareForResume()));
+    connect(man,
+            SIGNAL(MaintenanceWakeup()),
+            this,
+            SLOT(handleMaintenanceWakeup()));
     connect(man,
             SIGNAL(DeviceWasAdded(QString)),
             this,
@@ -134,6 +125,13 @@ SysTray::SysTray(QObject *parent)
             man,
             SLOT(handleDelInhibitPowerManagement(quint32)));
 
+    // scheduled wakeups for a batch job
+    maintenance = new Maintenance(man, pm, this);
+    connect(maintenance,
+            SIGNAL(userActive()),
+            this,
+            SLOT(handleMaintenanceActive()));
+
     // setup org.freedesktop.ScreenSaver
     ss = new ScreenSaver(this);
     connect(ss,
@@ -160,14 +158,18 @@ SysTray::SysTray(QObject *parent)
             this,
             SLOT(handleScreensaverFinished(int)));
 
-    // setup timer
-    timer = new QTimer(this);
-    timer->setInterval(60000);
-    connect(timer,
+    // setup idle check
+    idleTask = Scheduler::global()->addTask(this,
+                                            "timeout",
+                                            IDLE_TIMEOUT);
+
+    // setup critical re-check
+    criticalTimer = new QTimer(this);
+    criticalTimer->setSingleShot(true);
+    connect(criticalTimer,
             SIGNAL(timeout()),
             this,
-            SLOT(timeout()));
-    timer->start();
+            SLOT(checkDevices()));
 
     // check for config
     Common::checkSettings();
@@ -219,6 +221,7 @@ SysTray::SysTray(QObject *parent)
 SysTray::~SysTray()
 {
     if (xscreensaver->isOpen()) { xscreensaver->close(); }
+    delete recorder;
 }
 
 // what to do when user clicks systray
@@ -239,15 +242,26 @@ void SysTray::checkDevices()
 
     // get battery left and add tooltip
     double batteryLeft = man->BatteryLeft();
-    qDebug() << "battery at" << batteryLeft;
+    qCDebug(PK_DEVICE) << "battery at" << batteryLeft;
     if (batteryLeft > 0 && man->HasBattery()) {
         tray->setToolTip(QString("%1 %2%").arg(tr("Battery at")).arg(batteryLeft));
-        if (man->TimeToEmpty()>0 && man->OnBattery()) {
+        qlonglong timeLeft = man->TimeToEmpty();
+        if (timeLeft>0 && man->OnBattery()) {
             tray->setToolTip(tray->toolTip()
                              .append(QString(", %1 %2")
-                             .arg(QDateTime::fromTime_t((uint)man->TimeToEmpty())
+                             .arg(QDateTime::fromTime_t((uint)timeLeft)
                                                         .toUTC().toString("hh:mm")))
                              .arg(tr("left")));
+            qlonglong timeLow = man->TimeToEmptyLow();
+            qlonglong timeHigh = man->TimeToEmptyHigh();
+            if (timeLow>0 && timeHigh>timeLow) {
+                tray->setToolTip(tray->toolTip()
+                                 .append(QString(" (%1-%2)")
+                                 .arg(QDateTime::fromTime_t((uint)timeLow)
+                                                            .toUTC().toString("hh:mm"))
+                                 .arg(QDateTime::fromTime_t((uint)timeHigh)
+                                                            .toUTC().toString("hh:mm"))));
+            }
         }
         if (batteryLeft > 99) { tray->setToolTip(tr("Charged")); }
         if (!man->OnBattery() &&
@@ -288,14 +302,8 @@ void SysTray::checkDevices()
     // draw battery systray
     drawBattery(batteryLeft);
 
-    // low battery?
-    handleLow(batteryLeft);
-
-    // very low battery?
-    handleVeryLow(batteryLeft);
-
-    // critical battery?
-    handleCritical(batteryLeft);
+    // low, very low or critical battery?
+    handleBattery(batteryLeft);
 
     // Register service if not already registered
     if (!hasService) { registerService(); }
@@ -304,131 +312,87 @@ void SysTray::checkDevices()
 // what to do when user close lid
 void SysTray::handleClosedLid()
 {
-    qDebug() << "lid closed";
-    lidWasClosed = true;
-
-    int type = lidNone;
-    if (man->OnBattery()) {  // on battery
-        type = lidActionBattery;
-    } else { // on ac
-        type = lidActionAC;
-    }
-
-    if (disableLidOnExternalMonitors &&
-            externalMonitorIsConnected()) {
-        qDebug() << "external monitor is connected, ignore lid action";
-        switchInternalMonitor(false /* turn off screen */);
-        return;
-    }
-
-    qDebug() << "lid action" << type;
-    switch(type) {
-    case lidLock:
-        man->LockScreen();
-        break;
-    case lidSleep:
-        man->Suspend();
-        break;
-    case lidHibernate:
-        man->Hibernate();
-        break;
-    case lidShutdown:
-        man->PowerOff();
-        break;
-    case lidHybridSleep:
-        man->HybridSleep();
-        break;
-    default: ;
-    }
+    qCDebug(PK_POWER) << "lid closed";
+    bool onBattery = man->OnBattery();
+    bool external = settings.disableLidOnExternalMonitors && externalMonitorIsConnected();
+    record(TraceEvent::TraceLid, true, onBattery, external);
+    execute(policy.lidClosed(onBattery, external));
 }
 
 // what to do when user open lid
 void SysTray::handleOpenedLid()
 {
-    qDebug() << "lid is now open";
-    lidWasClosed = false;
-    if (disableLidOnExternalMonitors) {
-        switchInternalMonitor(true /* turn on screen */);
-    }
+    qCDebug(PK_POWER) << "lid is now open";
+    record(TraceEvent::TraceLid, false);
+    execute(policy.lidOpened());
 }
 
 // do something when switched to battery power
 void SysTray::handleOnBattery()
 {
-    if (notifyOnBattery) {
-        showMessage(tr("On Battery"),
-                    tr("Switched to battery power."));
-    }
-
-    // brightness
-    if (hasBacklight &&
-        backlightOnBattery &&
-        backlightBatteryValue>0) {
-        qDebug() << "set brightness on battery";
-        if (backlightBatteryDisableIfLower &&
-            backlightBatteryValue>Common::backlightValue(backlightDevice)) {
-            qDebug() << "brightness is lower than battery value, ignore";
-            return;
-        }
-        Common::adjustBacklight(backlightDevice, backlightBatteryValue);
-    }
+    int backlight = hasBacklight?Common::backlightValue(backlightDevice):-1;
+    record(TraceEvent::TracePower, true, backlight);
+    execute(policy.switchedToBattery(backlight));
+    setCpuProfile(true);
+    setRuntimePM(true);
 }
 
 // do something when switched to ac power
 void SysTray::handleOnAC()
 {
-    if (notifyOnAC) {
-        showMessage(tr("On AC"),
-                    tr("Switched to AC power."));
-    }
+    int backlight = hasBacklight?Common::backlightValue(backlightDevice):-1;
+    record(TraceEvent::TracePower, false, backlight);
+    execute(policy.switchedToAC(backlight));
+    setCpuProfile(false);
+    setRuntimePM(false);
+}
 
-    wasLowBattery = false;
-    wasVeryLowBattery = false;
+// profile for the power source, nothing is changed if none is set.
+// settings are reloaded on any config change, only a new profile
+// is sent to powerkitd
+void SysTray::setCpuProfile(bool onBattery)
+{
+    QString profile = onBattery?cpuProfileBattery:cpuProfileAC;
+    if (profile.isEmpty() || profile == cpuProfileApplied) { return; }
+    if (man->setCpuProfile(profile)) { cpuProfileApplied = profile; }
+}
 
-    // brightness
-    if (hasBacklight &&
-        backlightOnAC &&
-        backlightACValue>0) {
-        qDebug() << "set brightness on ac";
-        if (backlightACDisableIfHigher &&
-            backlightACValue<Common::backlightValue(backlightDevice)) {
-            qDebug() << "brightness is higher than ac value, ignore";
-            return;
-        }
-        Common::adjustBacklight(backlightDevice, backlightACValue);
+// runtime pm on battery, on AC the devices are as before.
+// only sent to powerkitd when the state or the settings changed
+void SysTray::setRuntimePM(bool onBattery)
+{
+    QVariantMap state;
+    state["enabled"] = runtimePM && onBattery;
+    state["allow"] = runtimePMAllow;
+    state["deny"] = runtimePMDeny;
+    state["delay"] = runtimePMDelay;
+    if (state == runtimePMApplied) { return; }
+    if (man->setRuntimePM(state["enabled"].toBool(),
+                          runtimePMAllow,
+                          runtimePMDeny,
+                          runtimePMDelay)) { runtimePMApplied = state; }
+}
+
+// "8086:a348,1d6b" or a list, as QSettings may read it either way
+static QStringList deviceIds(const QString &key)
+{
+    QStringList result;
+    QString ids = Common::loadPowerSettings(key).toStringList().join(",");
+    foreach (QString id, ids.split(",", QString::SkipEmptyParts)) {
+        if (!id.trimmed().isEmpty()) { result << id.trimmed(); }
     }
+    return result;
 }
 
 // load default settings
 void SysTray::loadSettings()
 {
-    qDebug() << "(re)load settings...";
+    qCDebug(PK_TRAY) << "(re)load settings...";
+
+    // power policy settings
+    settings = PowerSettings::load();
 
     // set default settings
-    if (Common::validPowerSettings(CONF_SUSPEND_BATTERY_TIMEOUT)) {
-        autoSuspendBattery = Common::loadPowerSettings(CONF_SUSPEND_BATTERY_TIMEOUT).toInt();
-    }
-    if (Common::validPowerSettings(CONF_SUSPEND_AC_TIMEOUT)) {
-        autoSuspendAC = Common::loadPowerSettings(CONF_SUSPEND_AC_TIMEOUT).toInt();
-    }
-    if (Common::validPowerSettings(CONF_SUSPEND_BATTERY_ACTION)) {
-        autoSuspendBatteryAction = Common::loadPowerSettings(CONF_SUSPEND_BATTERY_ACTION).toInt();
-    }
-    if (Common::validPowerSettings(CONF_SUSPEND_AC_ACTION)) {
-        autoSuspendACAction = Common::loadPowerSettings(CONF_SUSPEND_AC_ACTION).toInt();
-    }
-    if (Common::validPowerSettings(CONF_CRITICAL_BATTERY_TIMEOUT)) {
-        critBatteryValue = Common::loadPowerSettings(CONF_CRITICAL_BATTERY_TIMEOUT).toInt();
-    }
-    if (Common::validPowerSettings(CONF_LID_BATTERY_ACTION)) {
-        lidActionBattery = Common::loadPowerSettings(CONF_LID_BATTERY_ACTION).toInt();
-    }
-    if (Common::validPowerSettings(CONF_LID_AC_ACTION)) {
-        lidActionAC = Common::loadPowerSettings(CONF_LID_AC_ACTION).toInt();
-    }
-    if (Common::validPowerSettings(CONF_CRITICAL_BATTERY_ACTION)) {
-        criticalAction = Common::loadPowerSettings(CONF_CRITICAL_BATTERY_ACTION).toInt();
-    }
     if (Common::validPowerSettings(CONF_FREEDESKTOP_SS)) {
         desktopSS = Common::loadPowerSettings(CONF_FREEDESKTOP_SS).toBool();
     }
@@ -441,56 +405,76 @@ void SysTray::loadSettings()
     if (Common::validPowerSettings(CONF_TRAY_SHOW)) {
         showTray = Common::loadPowerSettings(CONF_TRAY_SHOW).toBool();
     }
-    if (Common::validPowerSettings(CONF_LID_DISABLE_IF_EXTERNAL)) {
-        disableLidOnExternalMonitors = Common::loadPowerSettings(CONF_LID_DISABLE_IF_EXTERNAL).toBool();
-    }
     if (Common::validPowerSettings(CONF_LID_XRANDR)) {
         lidXrandr = Common::loadPowerSettings(CONF_LID_XRANDR).toBool();
     }
-    if (Common::validPowerSettings(CONF_BACKLIGHT_AC_ENABLE)) {
-        backlightOnAC = Common::loadPowerSettings(CONF_BACKLIGHT_AC_ENABLE).toBool();
-    }
-    if (Common::validPowerSettings(CONF_BACKLIGHT_AC)) {
-        backlightACValue = Common::loadPowerSettings(CONF_BACKLIGHT_AC).toInt();
+    if (Common::validPowerSettings(CONF_SUSPEND_LOCK_SCREEN)) {
+        man->setLockScreenOnSuspend(Common::loadPowerSettings(CONF_SUSPEND_LOCK_SCREEN).toBool());
     }
-    if (Common::validPowerSettings(CONF_BACKLIGHT_BATTERY_ENABLE)) {
-        backlightOnBattery = Common::loadPowerSettings(CONF_BACKLIGHT_BATTERY_ENABLE).toBool();
+    if (Common::validPowerSettings(CONF_RESUME_LOCK_SCREEN)) {
+        man->setLockScreenOnResume(Common::loadPowerSettings(CONF_RESUME_LOCK_SCREEN).toBool());
     }
-    if (Common::validPowerSettings(CONF_BACKLIGHT_BATTERY)) {
-        backlightBatteryValue = Common::loadPowerSettings(CONF_BACKLIGHT_BATTERY).toInt();
+    if (Common::validPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_BATTERY)) {
+        man->setSuspendWakeAlarmOnBattery(Common::loadPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_BATTERY).toInt());
     }
-    if (Common::validPowerSettings(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER)) {
-        backlightBatteryDisableIfLower =  Common::loadPowerSettings(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER)
-                                                                    .toBool();
+    if (Common::validPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_AC)) {
+        man->setSuspendWakeAlarmOnAC(Common::loadPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_AC).toInt());
     }
-    if (Common::validPowerSettings(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER)) {
-        backlightACDisableIfHigher = Common::loadPowerSettings(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER)
-                                                               .toBool();
+    if (Common::validPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_AUTO)) {
+        man->setSuspendWakeAlarmAuto(Common::loadPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_AUTO).toBool());
     }
-    if (Common::validPowerSettings(CONF_WARN_ON_LOW_BATTERY)) {
-        warnOnLowBattery = Common::loadPowerSettings(CONF_WARN_ON_LOW_BATTERY).toBool();
+    // never plan to wake below the critical level
+    int reserve = SUSPEND_WAKEUP_RESERVE;
+    if (Common::validPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_RESERVE)) {
+        reserve = Common::loadPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_RESERVE).toInt();
     }
-    if (Common::validPowerSettings(CONF_WARN_ON_VERYLOW_BATTERY)) {
-        warnOnVeryLowBattery = Common::loadPowerSettings(CONF_WARN_ON_VERYLOW_BATTERY).toBool();
+    man->setSuspendWakeAlarmReserve(qMax(reserve, settings.criticalBattery));
+
+    // maintenance window, off unless a time is set
+    man->setMaintenanceTime(Common::loadPowerSettings(CONF_MAINTENANCE_TIME).toString());
+    maintenance->setCommand(Common::loadPowerSettings(CONF_MAINTENANCE_COMMAND).toString());
+    if (Common::validPowerSettings(CONF_MAINTENANCE_TIMEOUT)) {
+        maintenance->setTimeout(Common::loadPowerSettings(CONF_MAINTENANCE_TIMEOUT).toInt());
     }
-    if (Common::validPowerSettings(CONF_NOTIFY_ON_BATTERY)) {
-        notifyOnBattery = Common::loadPowerSettings(CONF_NOTIFY_ON_BATTERY).toBool();
+    if (Common::validPowerSettings(CONF_MAINTENANCE_MIN_BATTERY)) {
+        maintenance->setMinBattery(Common::loadPowerSettings(CONF_MAINTENANCE_MIN_BATTERY).toInt());
     }
-    if (Common::validPowerSettings(CONF_NOTIFY_ON_AC)) {
-        notifyOnAC = Common::loadPowerSettings(CONF_NOTIFY_ON_AC).toBool();
+
+    // node_exporter textfile output, off unless a file is set
+    if (Common::validPowerSettings(CONF_PROMETHEUS_INTERVAL)) {
+        exporter->setInterval(Common::loadPowerSettings(CONF_PROMETHEUS_INTERVAL).toInt());
     }
-    if (Common::validPowerSettings(CONF_SUSPEND_LOCK_SCREEN)) {
-        man->setLockScreenOnSuspend(Common::loadPowerSettings(CONF_SUSPEND_LOCK_SCREEN).toBool());
+    if (Common::validPowerSettings(CONF_PROMETHEUS_FILE)) {
+        exporter->setFile(Common::loadPowerSettings(CONF_PROMETHEUS_FILE).toString());
+    } else {
+        exporter->setFile(QString());
     }
-    if (Common::validPowerSettings(CONF_RESUME_LOCK_SCREEN)) {
-        man->setLockScreenOnResume(Common::loadPowerSettings(CONF_RESUME_LOCK_SCREEN).toBool());
+
+    // record policy inputs for replay, off unless a file is set
+    QString traceFile;
+    if (Common::validPowerSettings(CONF_TRACE_FILE)) {
+        traceFile = Common::loadPowerSettings(CONF_TRACE_FILE).toString();
     }
-    if (Common::validPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_BATTERY)) {
-        man->setSuspendWakeAlarmOnBattery(Common::loadPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_BATTERY).toInt());
+    if (recorder && traceFile != recorder->fileName()) {
+        delete recorder;
+        recorder = NULL;
     }
-    if (Common::validPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_AC)) {
-        man->setSuspendWakeAlarmOnAC(Common::loadPowerSettings(CONF_SUSPEND_WAKEUP_HIBERNATE_AC).toInt());
+    if (!recorder && !traceFile.isEmpty()) { recorder = new TraceRecorder(traceFile); }
+
+    // cpu profiles per power source, applied through powerkitd
+    cpuProfileAC = Common::loadPowerSettings(CONF_CPU_PROFILE_AC).toString();
+    cpuProfileBattery = Common::loadPowerSettings(CONF_CPU_PROFILE_BATTERY).toString();
+    setCpuProfile(man->OnBattery());
+
+    // runtime pm of pci and usb devices on battery, off by default
+    runtimePM = Common::loadPowerSettings(CONF_RUNTIME_PM).toBool();
+    runtimePMDelay = RUNTIME_PM_DELAY;
+    if (Common::validPowerSettings(CONF_RUNTIME_PM_DELAY)) {
+        runtimePMDelay = Common::loadPowerSettings(CONF_RUNTIME_PM_DELAY).toInt();
     }
+    runtimePMAllow = deviceIds(CONF_RUNTIME_PM_ALLOW);
+    runtimePMDeny = deviceIds(CONF_RUNTIME_PM_DENY);
+    setRuntimePM(man->OnBattery());
 
     if (Common::validPowerSettings(CONF_KERNEL_BYPASS)) {
         ignoreKernelResume = Common::loadPowerSettings(CONF_KERNEL_BYPASS).toBool();
@@ -500,17 +484,19 @@ void SysTray::loadSettings()
 
     // verify
     if (!Common::kernelCanResume(ignoreKernelResume)) {
-        qDebug() << "hibernate is not activated in kernel (add resume=...)";
+        qCDebug(PK_POWER) << "hibernate is not activated in kernel (add resume=...)";
         disableHibernate();
     }
     if (!man->CanHibernate()) {
-        qDebug() << "hibernate is not supported";
+        qCDebug(PK_POWER) << "hibernate is not supported";
         disableHibernate();
     }
     if (!man->CanSuspend()) {
-        qDebug() << "suspend not supported";
+        qCDebug(PK_POWER) << "suspend not supported";
         disableSuspend();
     }
+    policy.setSettings(settings);
+    recordSettings();
 
     // backlight
     backlightDevice = Common::backlightDevice();
@@ -525,119 +511,172 @@ void SysTray::registerService()
 {
     if (hasService) { return; }
     if (!QDBusConnection::sessionBus().isConnected()) {
-        qWarning("Cannot connect to D-Bus.");
+        qCWarning(PK_CORE) << "Cannot connect to D-Bus.";
         return;
     }
     if (desktopPM) {
         if (!QDBusConnection::sessionBus().registerService(PM_SERVICE)) {
-            qWarning() << QDBusConnection::sessionBus().lastError().message();
+            qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
             return;
         }
         if (!QDBusConnection::sessionBus().registerObject(PM_PATH,
                                                               pm,
                                                               QDBusConnection::ExportAllSlots)) {
-            qWarning() << QDBusConnection::sessionBus().lastError().message();
+            qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
             return;
         }
         if (!QDBusConnection::sessionBus().registerObject(PM_FULL_PATH,
                                                               pm,
                                                               QDBusConnection::ExportAllSlots)) {
-            qWarning() << QDBusConnection::sessionBus().lastError().message();
+            qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
             return;
         }
-        qDebug() << "Enabled org.freedesktop.PowerManagement";
+        qCDebug(PK_CORE) << "Enabled org.freedesktop.PowerManagement";
     }
     if (desktopSS) {
         if (!QDBusConnection::sessionBus().registerService(SS_SERVICE)) {
-            qWarning() << QDBusConnection::sessionBus().lastError().message();
+            qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
             return;
         }
         if (!QDBusConnection::sessionBus().registerObject(SS_PATH,
                                                           ss,
                                                           QDBusConnection::ExportAllSlots)) {
-            qWarning() << QDBusConnection::sessionBus().lastError().message();
+            qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
             return;
         }
         if (!QDBusConnection::sessionBus().registerObject(SS_FULL_PATH,
                                                           ss,
                                                           QDBusConnection::ExportAllSlots)) {
-            qWarning() << QDBusConnection::sessionBus().lastError().message();
+            qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
             return;
         }
-        qDebug() << "Enabled org.freedesktop.ScreenSaver";
+        qCDebug(PK_CORE) << "Enabled org.freedesktop.ScreenSaver";
     }
     if (!QDBusConnection::sessionBus().registerService(POWERKIT_SERVICE)) {
-        qWarning() << QDBusConnection::sessionBus().lastError().message();
+        qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
         return;
     }
     if (!QDBusConnection::sessionBus().registerObject(POWERKIT_PATH, man,
                                                       QDBusConnection::ExportAllContents)) {
-        qWarning() << QDBusConnection::sessionBus().lastError().message();
+        qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
         return;
     }
     if (!QDBusConnection::sessionBus().registerObject(POWERKIT_FULL_PATH, man,
                                                       QDBusConnection::ExportAllContents)) {
-        qWarning() << QDBusConnection::sessionBus().lastError().message();
+        qCWarning(PK_CORE) << QDBusConnection::sessionBus().lastError().message();
         return;
     }
-    qDebug() << "Enabled org.freedesktop.PowerKit";
+    qCDebug(PK_CORE) << "Enabled org.freedesktop.PowerKit";
     hasService = true;
 }
 
 // dbus session inhibit status handler
 void SysTray::handleHasInhibitChanged(bool has_inhibit)
 {
-    if (has_inhibit) { resetTimer(); }
+    if (!has_inhibit) { return; }
+    record(TraceEvent::TraceActivity);
+    resetTimer();
 }
 
-void SysTray::handleLow(double left)
+// low, very low and critical battery
+void SysTray::handleBattery(double left)
 {
-    if (!warnOnLowBattery) { return; }
-    double batteryLow = (double)(lowBatteryValue+critBatteryValue);
-    if (left<=batteryLow && man->OnBattery()) {
-        if (!wasLowBattery) {
-            showMessage(QString("%1 (%2%)").arg(tr("Low Battery!")).arg(left),
+    bool onBattery = man->OnBattery();
+    qlonglong timeLeft = onBattery?man->TimeToEmpty():0;
+    qlonglong timeToCritical = onBattery?man->TimeToLevel(settings.criticalBattery):-1;
+    record(TraceEvent::TraceBattery,
+           qRound64(left*100),
+           onBattery,
+           timeLeft,
+           timeToCritical);
+    execute(policy.battery(left, onBattery, timeLeft, timeToCritical));
+}
+
+// run the actions decided by the policy
+void SysTray::execute(const Policy::Actions &actions)
+{
+    foreach (Policy::Action action, actions) {
+        qCDebug(PK_POWER) << "policy action" << Policy::actionName(action.type) << action.value;
+        FlightRecorder::record("policy_action", action.type, (qint64)action.value);
+        switch(action.type) {
+        case Policy::ActionLock:
+            man->LockScreen();
+            break;
+        case Policy::ActionSuspend:
+            man->Suspend();
+            break;
+        case Policy::ActionHibernate:
+            man->Hibernate();
+            break;
+        case Policy::ActionPowerOff:
+            man->PowerOff();
+            break;
+        case Policy::ActionHybridSleep:
+            man->HybridSleep();
+            break;
+        case Policy::ActionWarnLow:
+            showMessage(QString("%1 (%2%)").arg(tr("Low Battery!")).arg(action.value),
                         tr("The battery is low,"
                            " please consider connecting"
                            " your computer to a power supply."),
                         true);
-            wasLowBattery = true;
-        }
-    }
-}
-
-void SysTray::handleVeryLow(double left)
-{
-    if (!warnOnVeryLowBattery) { return; }
-    double batteryVeryLow = (double)(critBatteryValue+1);
-    if (left<=batteryVeryLow && man->OnBattery()) {
-        if (!wasVeryLowBattery) {
-            showMessage(QString("%1 (%2%)").arg(tr("Very Low Battery!")).arg(left),
+            break;
+        case Policy::ActionWarnVeryLow:
+            showMessage(QString("%1 (%2%)").arg(tr("Very Low Battery!")).arg(action.value),
                         tr("The battery is almost empty,"
                            " please connect"
                            " your computer to a power supply now."),
                         true);
-            wasVeryLowBattery = true;
+            break;
+        case Policy::ActionNotifyBattery:
+            showMessage(tr("On Battery"),
+                        tr("Switched to battery power."));
+            break;
+        case Policy::ActionNotifyAC:
+            showMessage(tr("On AC"),
+                        tr("Switched to AC power."));
+            break;
+        case Policy::ActionBacklight:
+            Common::adjustBacklight(backlightDevice, (int)action.value);
+            break;
+        case Policy::ActionMonitorOn:
+            switchInternalMonitor(true /* turn on screen */);
+            break;
+        case Policy::ActionMonitorOff:
+            switchInternalMonitor(false /* turn off screen */);
+            break;
+        case Policy::ActionRecheck:
+            criticalTimer->start((int)action.value*1000);
+            break;
+        case Policy::ActionCancelRecheck:
+            criticalTimer->stop();
+            break;
+        case Policy::ActionCpuLimit:
+            man->setCpuLimit((int)action.value);
+            break;
+        default:;
         }
     }
 }
 
-// handle critical battery
-void SysTray::handleCritical(double left)
+// add an input event to the trace (if enabled)
+void SysTray::record(int type, qint64 v0, qint64 v1, qint64 v2, qint64 v3)
 {
-    if (left<=0 ||
-        left>(double)critBatteryValue ||
-        !man->OnBattery()) { return; }
-    qDebug() << "critical battery!" << criticalAction << left;
-    switch(criticalAction) {
-    case criticalHibernate:
-        man->Hibernate();
-        break;
-    case criticalShutdown:
-        man->PowerOff();
-        break;
-    default: ;
-    }
+    if (!recorder) { return; }
+    TraceEvent event(type, Clock::system()->wallMsecs());
+    event.values[0] = v0;
+    event.values[1] = v1;
+    event.values[2] = v2;
+    event.values[3] = v3;
+    recorder->record(event);
+}
+
+void SysTray::recordSettings()
+{
+    if (!recorder) { return; }
+    TraceEvent event(TraceEvent::TraceSettings, Clock::system()->wallMsecs());
+    event.data = settings.toMap();
+    recorder->record(event);
 }
 
 // draw battery tray icon
@@ -676,7 +715,6 @@ void SysTray::drawBattery(double left)
 }
 
 // timeout, check if idle
-// timeouts and xss must be >= user value and service has to be empty before suspend
 void SysTray::timeout()
 {
     if (!showTray &&
@@ -685,77 +723,30 @@ void SysTray::timeout()
         !tray->isVisible() &&
         showTray) { tray->show(); }
 
-    int uIdle = xIdle();
-
-    qDebug() << "timeout?" << timeouts << "idle?" << uIdle << "inhibit?" << pm->HasInhibit() << pmInhibitors << ssInhibitors;
+    int uIdle = Idle::minutes();
+    bool onBattery = man->OnBattery();
+    bool inhibited = pm->HasInhibit();
 
-    int autoSuspend = 0;
-    int autoSuspendAction = suspendNone;
-    if (man->OnBattery()) {
-        autoSuspend = autoSuspendBattery;
-        autoSuspendAction = autoSuspendBatteryAction;
-    }
-    else {
-        autoSuspend = autoSuspendAC;
-        autoSuspendAction = autoSuspendACAction;
-    }
-
-    bool doSuspend = false;
-    if (autoSuspend>0 &&
-        timeouts>=autoSuspend &&
-        uIdle>=autoSuspend &&
-        !pm->HasInhibit()) { doSuspend = true; }
-    if (!doSuspend) { timeouts++; }
-    else {
-        timeouts = 0;
-        qDebug() << "auto suspend activated" << autoSuspendAction;
-        switch (autoSuspendAction) {
-        case suspendSleep:
-            man->Suspend();
-            break;
-        case suspendHibernate:
-            man->Hibernate();
-            break;
-        case suspendShutdown:
-            man->PowerOff();
-            break;
-        case suspendHybrid:
-            man->HybridSleep();
-            break;
-        default: break;
-        }
-    }
-}
+    qCDebug(PK_TRAY) << "timeout?" << policy.timeouts() << "idle?" << uIdle << "inhibit?" << inhibited << pmInhibitors << ssInhibitors;
 
-// get user idle time
-int SysTray::xIdle()
-{
-    long idle = 0;
-    Display *display = XOpenDisplay(0);
-    if (display != 0) {
-        XScreenSaverInfo *info = XScreenSaverAllocInfo();
-        XScreenSaverQueryInfo(display, DefaultRootWindow(display), info);
-        if (info) {
-            idle = info->idle;
-            XFree(info);
-        }
-    }
-    XCloseDisplay(display);
-    int minutes = (idle-(1000*60))/(1000*60);
-    return minutes;
+    record(TraceEvent::TraceIdle, uIdle, onBattery, inhibited);
+    Policy::Actions actions = policy.idle(uIdle, onBattery, inhibited);
+    PK_PROBE4(idle_decision, uIdle, (int)onBattery, (int)inhibited,
+              actions.isEmpty()?(int)Policy::ActionNone:actions.first().type);
+    execute(actions);
 }
 
 // reset the idle timer
 void SysTray::resetTimer()
 {
-    timeouts = 0;
+    policy.resetIdle();
 }
 
 // set "internal" monitor
 void SysTray::setInternalMonitor()
 {
     internalMonitor = Screens::internal();
-    qDebug() << "internal monitor set to" << internalMonitor;
+    qCDebug(PK_SCREEN) << "internal monitor set to" << internalMonitor;
 }
 
 // is "internal" monitor connected?
@@ -765,7 +756,7 @@ bool SysTray::internalMonitorIsConnected()
     while (i.hasNext()) {
         i.next();
         if (i.key() == internalMonitor) {
-            qDebug() << "internal monitor connected?" << i.key() << i.value();
+            qCDebug(PK_SCREEN) << "internal monitor connected?" << i.key() << i.value();
             return i.value();
         }
     }
@@ -780,7 +771,7 @@ bool SysTray::externalMonitorIsConnected()
         i.next();
         if (i.key()!=internalMonitor &&
             !i.key().startsWith(VIRTUAL_MONITOR)) {
-            qDebug() << "external monitor connected?" << i.key() << i.value();
+            qCDebug(PK_SCREEN) << "external monitor connected?" << i.key() << i.value();
             if (i.value()) { return true; }
         }
     }
@@ -792,9 +783,10 @@ void SysTray::handleNewInhibitScreenSaver(const QString &application,
                                           const QString &reason,
                                           quint32 cookie)
 {
-    qDebug() << "new screensaver inhibit" << application << reason << cookie;
+    qCDebug(PK_INHIBIT) << "new screensaver inhibit" << application << reason << cookie;
     Q_UNUSED(reason)
     ssInhibitors[cookie] = application;
+    record(TraceEvent::TraceInhibit, 0, ssInhibitors.size());
     checkDevices();
 }
 
@@ -802,17 +794,19 @@ void SysTray::handleNewInhibitPowerManagement(const QString &application,
                                               const QString &reason,
                                               quint32 cookie)
 {
-    qDebug() << "new powermanagement inhibit" << application << reason << cookie;
+    qCDebug(PK_INHIBIT) << "new powermanagement inhibit" << application << reason << cookie;
     Q_UNUSED(reason)
     pmInhibitors[cookie] = application;
+    record(TraceEvent::TraceInhibit, 1, pmInhibitors.size());
     checkDevices();
 }
 
 void SysTray::handleDelInhibitScreenSaver(quint32 cookie)
 {
     if (ssInhibitors.contains(cookie)) {
-        qDebug() << "removed screensaver inhibitor" << ssInhibitors[cookie];
+        qCDebug(PK_INHIBIT) << "removed screensaver inhibitor" << ssInhibitors[cookie];
         ssInhibitors.remove(cookie);
+        record(TraceEvent::TraceInhibit, 0, ssInhibitors.size());
         checkDevices();
     }
 }
@@ -820,8 +814,9 @@ void SysTray::handleDelInhibitScreenSaver(quint32 cookie)
 void SysTray::handleDelInhibitPowerManagement(quint32 cookie)
 {
     if (pmInhibitors.contains(cookie)) {
-        qDebug() << "removed powermanagement inhibitor" << pmInhibitors[cookie];
+        qCDebug(PK_INHIBIT) << "removed powermanagement inhibitor" << pmInhibitors[cookie];
         pmInhibitors.remove(cookie);
+        record(TraceEvent::TraceInhibit, 1, pmInhibitors.size());
         checkDevices();
     }
 }
@@ -858,83 +853,117 @@ void SysTray::handleConfChanged(const QString &file)
 // disable hibernate if enabled
 void SysTray::disableHibernate()
 {
-    if (criticalAction == criticalHibernate) {
-        qWarning() << "reset critical action to shutdown";
-        criticalAction = criticalShutdown;
+    if (settings.criticalAction == criticalHibernate) {
+        qCWarning(PK_TRAY) << "reset critical action to shutdown";
+        settings.criticalAction = criticalShutdown;
         Common::savePowerSettings(CONF_CRITICAL_BATTERY_ACTION,
-                                  criticalAction);
+                                  settings.criticalAction);
     }
-    if (lidActionBattery == lidHibernate) {
-        qWarning() << "reset lid battery action to lock";
-        lidActionBattery = lidLock;
+    if (settings.lidActionBattery == lidHibernate) {
+        qCWarning(PK_TRAY) << "reset lid battery action to lock";
+        settings.lidActionBattery = lidLock;
         Common::savePowerSettings(CONF_LID_BATTERY_ACTION,
-                                  lidActionBattery);
+                                  settings.lidActionBattery);
     }
-    if (lidActionAC == lidHibernate) {
-        qWarning() << "reset lid ac action to lock";
-        lidActionAC = lidLock;
+    if (settings.lidActionAC == lidHibernate) {
+        qCWarning(PK_TRAY) << "reset lid ac action to lock";
+        settings.lidActionAC = lidLock;
         Common::savePowerSettings(CONF_LID_AC_ACTION,
-                                  lidActionAC);
+                                  settings.lidActionAC);
     }
-    if (autoSuspendBatteryAction == suspendHibernate) {
-        qWarning() << "reset auto suspend battery action to none";
-        autoSuspendBatteryAction = suspendNone;
+    if (settings.autoSuspendBatteryAction == suspendHibernate) {
+        qCWarning(PK_TRAY) << "reset auto suspend battery action to none";
+        settings.autoSuspendBatteryAction = suspendNone;
         Common::savePowerSettings(CONF_SUSPEND_BATTERY_ACTION,
-                                  autoSuspendBatteryAction);
+                                  settings.autoSuspendBatteryAction);
     }
-    if (autoSuspendACAction == suspendHibernate) {
-        qWarning() << "reset auto suspend ac action to none";
-        autoSuspendACAction = suspendNone;
+    if (settings.autoSuspendACAction == suspendHibernate) {
+        qCWarning(PK_TRAY) << "reset auto suspend ac action to none";
+        settings.autoSuspendACAction = suspendNone;
         Common::savePowerSettings(CONF_SUSPEND_AC_ACTION,
-                                  autoSuspendACAction);
+                                  settings.autoSuspendACAction);
     }
 }
 
 // disable suspend if enabled
 void SysTray::disableSuspend()
 {
-    if (lidActionBattery == lidSleep) {
-        qWarning() << "reset lid battery action to lock";
-        lidActionBattery = lidLock;
+    if (settings.lidActionBattery == lidSleep) {
+        qCWarning(PK_TRAY) << "reset lid battery action to lock";
+        settings.lidActionBattery = lidLock;
         Common::savePowerSettings(CONF_LID_BATTERY_ACTION,
-                                  lidActionBattery);
+                                  settings.lidActionBattery);
     }
-    if (lidActionAC == lidSleep) {
-        qWarning() << "reset lid ac action to lock";
-        lidActionAC = lidLock;
+    if (settings.lidActionAC == lidSleep) {
+        qCWarning(PK_TRAY) << "reset lid ac action to lock";
+        settings.lidActionAC = lidLock;
         Common::savePowerSettings(CONF_LID_AC_ACTION,
-                                  lidActionAC);
+                                  settings.lidActionAC);
     }
-    if (autoSuspendBatteryAction == suspendSleep) {
-        qWarning() << "reset auto suspend battery action to none";
-        autoSuspendBatteryAction = suspendNone;
+    if (settings.autoSuspendBatteryAction == suspendSleep) {
+        qCWarning(PK_TRAY) << "reset auto suspend battery action to none";
+        settings.autoSuspendBatteryAction = suspendNone;
         Common::savePowerSettings(CONF_SUSPEND_BATTERY_ACTION,
-                                  autoSuspendBatteryAction);
+                                  settings.autoSuspendBatteryAction);
     }
-    if (autoSuspendACAction == suspendSleep) {
-        qWarning() << "reset auto suspend ac action to none";
-        autoSuspendACAction = suspendNone;
+    if (settings.autoSuspendACAction == suspendSleep) {
+        qCWarning(PK_TRAY) << "reset auto suspend ac action to none";
+        settings.autoSuspendACAction = suspendNone;
         Common::savePowerSettings(CONF_SUSPEND_AC_ACTION,
-                                  autoSuspendACAction);
+                                  settings.autoSuspendACAction);
     }
 }
 
 // prepare for suspend
 void SysTray::handlePrepareForSuspend()
 {
-    /*qDebug() << "prepare for suspend";
+    /*qCDebug(PK_POWER) << "prepare for suspend";
     resetTimer();
     man->releaseSuspendLock();*/
-    qDebug() << "do nothing";
+    qCDebug(PK_POWER) << "do nothing";
+    record(TraceEvent::TraceSuspend);
 }
 
 // prepare for resume
 void SysTray::handlePrepareForResume()
 {
-    qDebug() << "prepare for resume ...";
+    qCDebug(PK_POWER) << "prepare for resume ...";
+    record(TraceEvent::TraceResume);
+    resumeSession();
+    // runs after the pending paint events
+    QTimer::singleShot(0, this, SLOT(handleResumeDrawn()));
+}
+
+// the user is back, idle starts over
+void SysTray::resumeSession()
+{
     resetTimer();
     tray->showMessage(QString(), QString());
-    ss->SimulateUserActivity();
+    // forks xscreensaver-command, not needed to be usable
+    QTimer::singleShot(0, ss, SLOT(SimulateUserActivity()));
+}
+
+void SysTray::handleResumeDrawn()
+{
+    man->resumeReady(SuspendReport::StageTray);
+}
+
+// woken for maintenance, the display stays off and the
+// idle timer is not reset until the user shows up
+void SysTray::handleMaintenanceWakeup()
+{
+    qCDebug(PK_POWER) << "maintenance wakeup";
+    record(TraceEvent::TraceResume);
+    QTimer::singleShot(0, this, SLOT(handleResumeDrawn()));
+    maintenance->run();
+}
+
+// used during maintenance, no suspend after the job
+void SysTray::handleMaintenanceActive()
+{
+    qCDebug(PK_POWER) << "user active during maintenance, resume";
+    record(TraceEvent::TraceActivity);
+    resumeSession();
 }
 
 // turn off/on monitor using xrandr
@@ -942,7 +971,7 @@ void SysTray::handlePrepareForResume()
 void SysTray::switchInternalMonitor(bool toggle)
 {
     if (!lidXrandr) { return; }
-    qDebug() << "using xrandr to turn on/off internal monitor" << toggle;
+    qCDebug(PK_SCREEN) << "using xrandr to turn on/off internal monitor" << toggle;
     QProcess xrandr;
     xrandr.start(QString(toggle?TURN_ON_MONITOR:TURN_OFF_MONITOR).arg(internalMonitor));
     xrandr.waitForFinished();
@@ -27,12 +27,19 @@
 #include <QWheelEvent>
 
 #include "common.h"
+#include "log.h"
 #include "powermanagement.h"
 #include "screensaver.h"
 #include "screens.h"
 #include "powerkit.h"
+#include "scheduler.h"
+#include "prometheus.h"
+#include "policy.h"
+#include "trace.h"
+#include "maintenance.h"
+#include "runtimepm.h"
 
-#include <X11/extensions/scrnsaver.h>
+#include "idle.h"
 #undef CursorShape
 #undef Bool
 #undef Status
@@ -78,27 +85,20 @@ public:
 private:
     TrayIcon *tray;
     PowerKit *man;
+    PrometheusExporter *exporter;
     PowerManagement *pm;
     ScreenSaver *ss;
-    bool wasLowBattery;
-    bool wasVeryLowBattery;
-    int lowBatteryValue;
-    int critBatteryValue;
+    Maintenance *maintenance;
     bool hasService;
-    int lidActionBattery;
-    int lidActionAC;
-    int criticalAction;
-    int autoSuspendBattery;
-    int autoSuspendAC;
-    QTimer *timer;
-    int timeouts;
+    int idleTask;
+    QTimer *criticalTimer;
+    PowerSettings settings;
+    Policy policy;
+    TraceRecorder *recorder;
     bool showNotifications;
     bool desktopSS;
     bool desktopPM;
     bool showTray;
-    bool disableLidOnExternalMonitors;
-    int autoSuspendBatteryAction;
-    int autoSuspendACAction;
     QProcess *xscreensaver;
     bool startupScreensaver;
     QMap<quint32,QString> ssInhibitors;
@@ -106,22 +106,22 @@ private:
     QString internalMonitor;
     QFileSystemWatcher *watcher;
     bool lidXrandr;
-    bool lidWasClosed;
     QString backlightDevice;
     bool hasBacklight;
-    bool backlightOnBattery;
-    bool backlightOnAC;
-    int backlightBatteryValue;
-    int backlightACValue;
-    bool backlightBatteryDisableIfLower;
-    bool backlightACDisableIfHigher;
     QProcess *configDialog;
-    bool warnOnLowBattery;
-    bool warnOnVeryLowBattery;
-    bool notifyOnBattery;
-    bool notifyOnAC;
     bool backlightMouseWheel;
     bool ignoreKernelResume;
+    QString cpuProfileAC;
+    QString cpuProfileBattery;
+    QString cpuProfileApplied; // last profile powerkitd accepted
+    bool runtimePM;
+    int runtimePMDelay;
+    QStringList runtimePMAllow;
+    QStringList runtimePMDeny;
+    QVariantMap runtimePMApplied; // last state powerkitd accepted
+
+    void setCpuProfile(bool onBattery);
+    void setRuntimePM(bool onBattery);
 
 private slots:
     void trayActivated(QSystemTrayIcon::ActivationReason reason);
@@ -133,13 +133,18 @@ private slots:
     void loadSettings();
     void registerService();
     void handleHasInhibitChanged(bool has_inhibit);
-    void handleLow(double left);
-    void handleVeryLow(double left);
-    void handleCritical(double left);
+    void handleBattery(double left);
+    void execute(const Policy::Actions &actions);
+    void record(int type,
+                qint64 v0 = 0,
+                qint64 v1 = 0,
+                qint64 v2 = 0,
+                qint64 v3 = 0);
+    void recordSettings();
     void drawBattery(double left);
     void timeout();
-    int xIdle();
     void resetTimer();
+    void resumeSession();
     void setInternalMonitor();
     bool internalMonitorIsConnected();
     bool externalMonitorIsConnected();
@@ -160,6 +165,9 @@ private slots:
     void disableSuspend();
     void handlePrepareForSuspend();
     void handlePrepareForResume();
+    void handleResumeDrawn();
+    void handleMaintenanceWakeup();
+    void handleMaintenanceActive();
     void switchInternalMonitor(bool toggle);
     void handleTrayWheel(TrayIcon::WheelAction action);
     void handleDeviceChanged(const QString &path);
@@ -16,6 +16,7 @@
 
 #include "def.h"
 #include "common.h"
+#include "log.h"
 
 void Theme::setIconTheme()
 {
@@ -29,7 +30,7 @@ void Theme::setIconTheme()
         !iconsPath.contains(iconsHome)) { iconsPath.prepend(iconsHome); }
     iconsPath << QString("%1/../share/icons").arg(qApp->applicationDirPath());
     QIcon::setThemeSearchPaths(iconsPath);
-    qDebug() << "using icon theme search path" << QIcon::themeSearchPaths();
+    qCDebug(PK_TRAY) << "using icon theme search path" << QIcon::themeSearchPaths();
 
     QString theme = QIcon::themeName();
     if (theme.isEmpty() || theme == "hicolor") { // try to load saved theme
@@ -48,13 +49,13 @@ void Theme::setIconTheme()
         if(theme.isNull()) { theme = DEFAULT_THEME; }
         if (!theme.isEmpty()) { Common::savePowerSettings(CONF_ICON_THEME, theme); }
     }
-    qDebug() << "Using icon theme" << theme;
+    qCDebug(PK_TRAY) << "Using icon theme" << theme;
     QIcon::setThemeName(theme);
 #ifdef BUNDLE_ICONS
     if (theme != DEFAULT_THEME) { // validate theme
         QIcon testTheme = QIcon::fromTheme(DEFAULT_AC_ICON);
         if (testTheme.isNull()) {
-            qDebug() << "icon theme is broken, use failsafe!";
+            qCDebug(PK_TRAY) << "icon theme is broken, use failsafe!";
             QIcon::setThemeName(DEFAULT_THEME);
             Common::savePowerSettings(CONF_ICON_THEME, DEFAULT_THEME);
         }
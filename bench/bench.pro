@@ -0,0 +1,57 @@
+#
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+#
+# Benchmarks for the lib hot paths, build with 'qmake CONFIG+=bench'.
+# Results are written as JSON to stdout or to '--json file'.
+#
+# D-Bus cases use a fake UPower on a private bus and X11 cases
+# need a display, they are skipped if missing. xvfb-bench.sh runs
+# the bench on Xvfb and a private D-Bus:
+#
+#   ./xvfb-bench.sh ./powerkit-bench --json bench.json
+#
+
+TARGET = powerkit-bench
+QT += core dbus testlib
+QT -= gui
+CONFIG += console
+CONFIG -= app_bundle
+TEMPLATE = app
+SOURCES += \
+    main.cpp \
+    benchutil.cpp \
+    benchmark.cpp \
+    schedulerbench.cpp \
+    historybench.cpp \
+    suspendbench.cpp \
+    policybench.cpp \
+    xbenchmark.cpp \
+    fakeupower.cpp \
+    fakelogind.cpp \
+    fakepowerkitd.cpp
+HEADERS += \
+    benchutil.h \
+    benchmark.h \
+    schedulerbench.h \
+    historybench.h \
+    suspendbench.h \
+    policybench.h \
+    xbenchmark.h \
+    fakeupower.h \
+    fakelogind.h \
+    fakepowerkitd.h
+
+# daemon parts without a bus
+SOURCES += ../daemon/alarmqueue.cpp
+HEADERS += ../daemon/alarmqueue.h
+INCLUDEPATH += ../daemon
+OTHER_FILES += xvfb-bench.sh
+
+LIBS += -L../lib -lPowerKit
+INCLUDEPATH += ../lib
+include(../powerkit.pri)
+LIBS += -lXtst
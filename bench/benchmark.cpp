@@ -0,0 +1,344 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "benchmark.h"
+#include "benchutil.h"
+#include "common.h"
+#include "deferredjob.h"
+#include "device.h"
+#include "policy.h"
+#include "powerkit.h"
+#include "powermanagement.h"
+#include "prometheus.h"
+#include "screensaver.h"
+
+#include <QDBusConnection>
+#include <QDBusInterface>
+#include <QDBusMessage>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QStringList>
+#include <QtTest/QtTest>
+
+// Xlib macros clash with Qt, keep last
+#include "screens.h"
+
+#define BENCH_BACKLIGHT_MAX 1000
+#define BENCH_JOB_WAIT 5000 // ms for the bus to report a client gone
+
+Benchmark::Benchmark(const QString &root,
+                     FakeUPower *upower,
+                     QObject *parent)
+    : QObject(parent)
+    , root(root)
+    , upower(upower)
+{
+}
+
+void Benchmark::initTestCase()
+{
+    // sysfs backlight look-alike
+    backlight = QString("%1/backlight/bench0").arg(root);
+    QVERIFY(QDir().mkpath(backlight));
+    QVERIFY(BenchUtil::writeFile(QString("%1/max_brightness").arg(backlight),
+                                 QString::number(BENCH_BACKLIGHT_MAX)));
+    QVERIFY(BenchUtil::writeFile(QString("%1/brightness").arg(backlight),
+                                 QString::number(BENCH_BACKLIGHT_MAX/2)));
+}
+
+void Benchmark::deviceUpdate()
+{
+    if (!upower) { QSKIP("no private system bus", SkipAll); }
+    Device device(upower->batteryPath());
+    QCOMPARE(device.nativePath, QString("BAT0"));
+    QBENCHMARK { device.update(); }
+}
+
+void Benchmark::batteryLeft()
+{
+    if (!upower) { QSKIP("no private system bus", SkipAll); }
+    PowerKit pk;
+    QCOMPARE(pk.BatteryLeft(), 55.0);
+    QBENCHMARK { pk.BatteryLeft(); }
+}
+
+void Benchmark::timeToEmpty()
+{
+    if (!upower) { QSKIP("no private system bus", SkipAll); }
+    PowerKit pk;
+    QVERIFY(pk.TimeToEmpty()>0);
+    QBENCHMARK { pk.TimeToEmpty(); }
+}
+
+// the exact textfile output for a known snapshot, labels escaped
+void Benchmark::prometheusFormat()
+{
+    QVariantMap battery;
+    battery["energy"] = 45.5;
+    battery["energy_full"] = 50.25;
+    battery["energy_full_design"] = 57;
+    battery["percentage"] = 90.5;
+    battery["rate"] = 8.125;
+    QVariantMap batteries;
+    batteries["BAT\"0"] = battery;
+    QVariantMap ss, pm, calls, seconds, op, x11;
+    ss["vlc"] = 1;
+    pm["a\\b"] = 2;
+    calls["Get"] = 12;
+    seconds["Get"] = 0.5;
+    op["calls"] = 3;
+    op["requests"] = 4;
+    op["round_trips"] = 1;
+    x11["idle"] = op;
+    QVariantMap snapshot;
+    snapshot["batteries"] = batteries;
+    snapshot["on_battery"] = true;
+    snapshot["lid_closed"] = false;
+    snapshot["inhibitors_screensaver"] = ss;
+    snapshot["inhibitors_power"] = pm;
+    snapshot["suspends"] = 3;
+    snapshot["resumes"] = 2;
+    snapshot["suspend_seconds"] = 3600;
+    snapshot["suspend_seconds_last"] = 1200;
+    snapshot["dbus_calls"] = calls;
+    snapshot["dbus_call_seconds"] = seconds;
+    snapshot["x11"] = x11;
+    snapshot["wakeups"] = 42;
+    snapshot["scheduler_active_tasks"] = 5;
+
+    QString expected =
+        "# HELP powerkit_battery_energy_wh Energy left in the battery.\n"
+        "# TYPE powerkit_battery_energy_wh gauge\n"
+        "powerkit_battery_energy_wh{device=\"BAT\\\"0\"} 45.5\n"
+        "# HELP powerkit_battery_energy_full_wh Energy when the battery is full.\n"
+        "# TYPE powerkit_battery_energy_full_wh gauge\n"
+        "powerkit_battery_energy_full_wh{device=\"BAT\\\"0\"} 50.25\n"
+        "# HELP powerkit_battery_energy_full_design_wh Design energy of the battery.\n"
+        "# TYPE powerkit_battery_energy_full_design_wh gauge\n"
+        "powerkit_battery_energy_full_design_wh{device=\"BAT\\\"0\"} 57\n"
+        "# HELP powerkit_battery_percentage Battery charge in percent.\n"
+        "# TYPE powerkit_battery_percentage gauge\n"
+        "powerkit_battery_percentage{device=\"BAT\\\"0\"} 90.5\n"
+        "# HELP powerkit_battery_rate_watts Battery charge or discharge rate.\n"
+        "# TYPE powerkit_battery_rate_watts gauge\n"
+        "powerkit_battery_rate_watts{device=\"BAT\\\"0\"} 8.125\n"
+        "# HELP powerkit_on_battery 1 if running on battery, 0 on AC.\n"
+        "# TYPE powerkit_on_battery gauge\n"
+        "powerkit_on_battery 1\n"
+        "# HELP powerkit_lid_closed 1 if the lid is closed.\n"
+        "# TYPE powerkit_lid_closed gauge\n"
+        "powerkit_lid_closed 0\n"
+        "# HELP powerkit_inhibitors Active inhibitors by type and application.\n"
+        "# TYPE powerkit_inhibitors gauge\n"
+        "powerkit_inhibitors{type=\"screensaver\",application=\"vlc\"} 1\n"
+        "powerkit_inhibitors{type=\"power\",application=\"a\\\\b\"} 2\n"
+        "# HELP powerkit_suspends_total Suspend requests seen.\n"
+        "# TYPE powerkit_suspends_total counter\n"
+        "powerkit_suspends_total 3\n"
+        "# HELP powerkit_resumes_total Resumes seen.\n"
+        "# TYPE powerkit_resumes_total counter\n"
+        "powerkit_resumes_total 2\n"
+        "# HELP powerkit_suspend_seconds_total Time spent suspended.\n"
+        "# TYPE powerkit_suspend_seconds_total counter\n"
+        "powerkit_suspend_seconds_total 3600\n"
+        "# HELP powerkit_suspend_last_seconds Duration of the last suspend.\n"
+        "# TYPE powerkit_suspend_last_seconds gauge\n"
+        "powerkit_suspend_last_seconds 1200\n"
+        "# HELP powerkit_dbus_calls_total Blocking D-Bus calls made by PowerKit.\n"
+        "# TYPE powerkit_dbus_calls_total counter\n"
+        "powerkit_dbus_calls_total{method=\"Get\"} 12\n"
+        "# HELP powerkit_dbus_call_seconds_total Time spent in blocking D-Bus calls.\n"
+        "# TYPE powerkit_dbus_call_seconds_total counter\n"
+        "powerkit_dbus_call_seconds_total{method=\"Get\"} 0.5\n"
+        "# HELP powerkit_x11_calls_total X11 calls by operation.\n"
+        "# TYPE powerkit_x11_calls_total counter\n"
+        "powerkit_x11_calls_total{operation=\"idle\"} 3\n"
+        "# HELP powerkit_x11_requests_total X11 requests by operation.\n"
+        "# TYPE powerkit_x11_requests_total counter\n"
+        "powerkit_x11_requests_total{operation=\"idle\"} 4\n"
+        "# HELP powerkit_x11_round_trips_total X11 round trips by operation.\n"
+        "# TYPE powerkit_x11_round_trips_total counter\n"
+        "powerkit_x11_round_trips_total{operation=\"idle\"} 1\n"
+        "# HELP powerkit_wakeups_total Scheduler timer wakeups.\n"
+        "# TYPE powerkit_wakeups_total counter\n"
+        "powerkit_wakeups_total 42\n"
+        "# HELP powerkit_scheduler_active_tasks Active scheduler tasks.\n"
+        "# TYPE powerkit_scheduler_active_tasks gauge\n"
+        "powerkit_scheduler_active_tasks 5\n";
+    QCOMPARE(PrometheusExporter::format(snapshot), expected);
+    QBENCHMARK { PrometheusExporter::format(snapshot); }
+}
+
+// includes the activity ping, as on a real inhibit
+void Benchmark::screenSaverInhibit()
+{
+    ScreenSaver ss;
+    QBENCHMARK {
+        quint32 cookie = ss.Inhibit("bench", "benchmark");
+        ss.UnInhibit(cookie);
+    }
+}
+
+void Benchmark::powerManagementInhibit()
+{
+    PowerManagement pm;
+    QBENCHMARK {
+        quint32 cookie = pm.Inhibit("bench", "benchmark");
+        pm.HasInhibit();
+        pm.UnInhibit(cookie);
+    }
+}
+
+// jobs start paused, JobMayRun follows once the conditions hold
+// and JobMustPause when they stop. the fake is on battery at 55%
+void Benchmark::deferredJobGating()
+{
+    if (!upower) { QSKIP("no private system bus", SkipAll); }
+    PowerKit pk;
+    QSignalSpy mayRun(&pk, SIGNAL(JobMayRun(QString,QString)));
+    QSignalSpy mustPause(&pk, SIGNAL(JobMustPause(QString,QString)));
+    QVariantMap level;
+    level[JOB_BATTERY_MIN] = 50;
+    QVariantMap ac;
+    ac[JOB_ON_AC] = true;
+    QVariantMap idle;
+    idle[JOB_IDLE_MINUTES] = 60;
+    QVariantMap typo;
+    typo["on_battery"] = false;
+
+    QVERIFY(!pk.RegisterDeferredJob("typo", typo));
+    QVERIFY(pk.RegisterDeferredJob("level", level));
+    QVERIFY(pk.RegisterDeferredJob("ac", ac));
+    QVERIFY(pk.RegisterDeferredJob("idle", idle));
+    QCOMPARE(mayRun.count(), 0); // after the reply
+    QCoreApplication::processEvents();
+    QCOMPARE(mayRun.count(), 1);
+    QCOMPARE(mayRun.at(0).at(0).toString(), QString()); // not from the bus
+    QCOMPARE(mayRun.at(0).at(1).toString(), QString("level"));
+    QVariantMap jobs = pk.DeferredJobs();
+    QCOMPARE(jobs.size(), 3);
+    QVERIFY(jobs.value(" level").toMap().value("running").toBool());
+    QVERIFY(!jobs.value(" ac").toMap().value("running").toBool());
+    QVERIFY(!jobs.value(" idle").toMap().value("running").toBool());
+
+    // idle past the threshold, then input
+    QMetaObject::invokeMethod(&pk, "handleIdle", Q_ARG(qint64, Q_INT64_C(3600000)));
+    QCOMPARE(mayRun.count(), 2);
+    QCOMPARE(mayRun.at(1).at(1).toString(), QString("idle"));
+    QMetaObject::invokeMethod(&pk, "handleActive");
+    QCOMPARE(mustPause.count(), 1);
+    QCOMPARE(mustPause.at(0).at(1).toString(), QString("idle"));
+
+    // stricter conditions pause a running job
+    level[JOB_BATTERY_MIN] = 60;
+    QVERIFY(pk.RegisterDeferredJob("level", level));
+    QCoreApplication::processEvents();
+    QCOMPARE(mustPause.count(), 2);
+    QCOMPARE(mustPause.at(1).at(1).toString(), QString("level"));
+    QCOMPARE(mayRun.count(), 2);
+
+    pk.UnregisterDeferredJob("level");
+    jobs = pk.DeferredJobs();
+    QCOMPARE(jobs.size(), 2);
+    QVERIFY(!jobs.contains(" level"));
+}
+
+static bool registerJob(QDBusInterface *iface, const QString &name)
+{
+    QVariantMap conditions;
+    conditions[JOB_BATTERY_MIN] = 50;
+    QDBusMessage reply = iface->call(QDBus::BlockWithGui,
+                                     "RegisterDeferredJob",
+                                     name,
+                                     conditions);
+    return reply.errorMessage().isEmpty() &&
+           !reply.arguments().isEmpty() &&
+           reply.arguments().first().toBool();
+}
+
+// jobs belong to the bus name that registered them. the same name
+// from another client is another job, and a client unregistering or
+// leaving the bus only releases its own jobs. the calls come from
+// two extra connections, PowerKit answers in the local event loop
+void Benchmark::deferredJobOwners()
+{
+    if (!upower) { QSKIP("no private system bus", SkipAll); }
+    QDBusConnection system = QDBusConnection::systemBus();
+    PowerKit pk;
+    QVERIFY(system.registerObject(POWERKIT_PATH, &pk, QDBusConnection::ExportAllContents));
+    QDBusConnection first = QDBusConnection::connectToBus(QDBusConnection::SystemBus,
+                                                          "bench-job-first");
+    QDBusConnection second = QDBusConnection::connectToBus(QDBusConnection::SystemBus,
+                                                           "bench-job-second");
+    QDBusInterface firstJobs(system.baseService(), POWERKIT_PATH, QString(), first);
+    QDBusInterface secondJobs(system.baseService(), POWERKIT_PATH, QString(), second);
+    QString firstKey = QString("%1 backup").arg(first.baseService());
+    QString secondKey = QString("%1 backup").arg(second.baseService());
+
+    QVERIFY(registerJob(&firstJobs, "backup"));
+    QVERIFY(registerJob(&secondJobs, "backup"));
+    QVariantMap jobs = pk.DeferredJobs();
+    QCOMPARE(jobs.size(), 2);
+    QCOMPARE(jobs.value(firstKey).toMap().value("owner").toString(), first.baseService());
+    QCOMPARE(jobs.value(secondKey).toMap().value("owner").toString(), second.baseService());
+
+    secondJobs.call(QDBus::BlockWithGui, "UnregisterDeferredJob", QString("backup"));
+    jobs = pk.DeferredJobs();
+    QVERIFY(jobs.contains(firstKey));
+    QVERIFY(!jobs.contains(secondKey));
+
+    QVERIFY(registerJob(&secondJobs, "backup"));
+    QDBusConnection::disconnectFromBus("bench-job-first");
+    QElapsedTimer timer;
+    timer.start();
+    while (pk.DeferredJobs().contains(firstKey) && timer.elapsed()<BENCH_JOB_WAIT) {
+        QTest::qWait(10);
+    }
+    jobs = pk.DeferredJobs();
+    QVERIFY(!jobs.contains(firstKey));
+    QVERIFY(jobs.contains(secondKey));
+
+    QDBusConnection::disconnectFromBus("bench-job-second");
+    system.unregisterObject(POWERKIT_PATH);
+}
+
+void Benchmark::loadPowerSettings()
+{
+    QStringList keys = PowerSettings().toMap().keys();
+    QBENCHMARK {
+        foreach (QString key, keys) { Common::loadPowerSettings(key); }
+    }
+}
+
+void Benchmark::loadSettings()
+{
+    QBENCHMARK { PowerSettings::load(); }
+}
+
+void Benchmark::screensOutputs()
+{
+    Display *dpy = XOpenDisplay(NULL);
+    if (dpy == NULL) { QSKIP("no X11 display (run on Xvfb)", SkipAll); }
+    XCloseDisplay(dpy);
+    QBENCHMARK { Screens::outputs(); }
+}
+
+void Benchmark::backlightRead()
+{
+    QCOMPARE(Common::backlightMax(backlight), BENCH_BACKLIGHT_MAX);
+    QBENCHMARK { Common::backlightValue(backlight); }
+}
+
+void Benchmark::backlightWrite()
+{
+    int value = 0;
+    QBENCHMARK {
+        QVERIFY(Common::adjustBacklight(backlight, value));
+        value = (value+1)%BENCH_BACKLIGHT_MAX;
+    }
+}
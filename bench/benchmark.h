@@ -0,0 +1,52 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BENCHMARK_H
+#define BENCHMARK_H
+
+#include <QObject>
+#include <QString>
+
+#include "fakeupower.h"
+
+// QBENCHMARK cases for the lib hot paths: devices, inhibitors,
+// deferred jobs, settings, backlight, screens and the exporter.
+// D-Bus cases need the fake UPower, X11 cases a display,
+// they are skipped otherwise.
+class Benchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Benchmark(const QString &root,
+                       FakeUPower *upower,
+                       QObject *parent = NULL);
+
+private:
+    QString root; // scratch dir, config and fake sysfs
+    QString backlight;
+    FakeUPower *upower; // NULL without a private system bus
+
+private slots:
+    void initTestCase();
+    void deviceUpdate();
+    void batteryLeft();
+    void timeToEmpty();
+    void prometheusFormat();
+    void screenSaverInhibit();
+    void powerManagementInhibit();
+    void deferredJobGating();
+    void deferredJobOwners();
+    void loadPowerSettings();
+    void loadSettings();
+    void screensOutputs();
+    void backlightRead();
+    void backlightWrite();
+};
+
+#endif // BENCHMARK_H
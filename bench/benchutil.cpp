@@ -0,0 +1,45 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "benchutil.h"
+#include "clock.h"
+#include "rtc.h"
+
+#include <QDir>
+#include <QFile>
+#include <QTextStream>
+
+bool BenchUtil::writeFile(const QString &path, const QString &value)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) { return false; }
+    QTextStream out(&file);
+    out << value;
+    return true;
+}
+
+// sysfs rtc with an empty wakealarm node, the node dir or
+// empty if it could not be made
+QString BenchUtil::fakeRtc(const QString &root, const QString &name)
+{
+    QString sysfs = QString("%1/rtc/%2").arg(root).arg(name);
+    if (!QDir().mkpath(sysfs) ||
+        !writeFile(QString("%1/%2").arg(sysfs).arg(RTC_WAKEALARM), QString())) {
+        return QString();
+    }
+    return sysfs;
+}
+
+// wall time forward to 'time', asleep or awake
+void BenchUtil::moveTestClock(TestClock *clock, qint64 time, bool suspended)
+{
+    qint64 delta = time-clock->wallMsecs();
+    if (delta<=0) { return; }
+    if (suspended) { clock->suspend(delta); }
+    else { clock->advance(delta); }
+}
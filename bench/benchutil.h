@@ -0,0 +1,26 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+#include <QString>
+
+class TestClock;
+
+// fixtures shared by the bench suites, files go below the
+// scratch dir main() passes to every suite
+class BenchUtil
+{
+public:
+    static bool writeFile(const QString &path, const QString &value);
+    static QString fakeRtc(const QString &root, const QString &name);
+    static void moveTestClock(TestClock *clock, qint64 time, bool suspended);
+};
+
+#endif // BENCHUTIL_H
@@ -0,0 +1,90 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "fakelogind.h"
+#include "powerkit.h"
+
+#include <QDBusConnection>
+
+#include <unistd.h>
+
+FakeLogind::FakeLogind(QObject *parent)
+    : QObject(parent)
+    , inhibitCount(0)
+    , suspendCount(0)
+    , registered(false)
+{
+}
+
+bool FakeLogind::start()
+{
+    QDBusConnection system = QDBusConnection::systemBus();
+    if (!system.isConnected()) { return false; }
+    if (!system.registerService(LOGIND_SERVICE)) { return false; }
+    registered = true;
+    if (!system.registerObject(LOGIND_PATH, this, QDBusConnection::ExportAllSlots)) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void FakeLogind::stop()
+{
+    if (!registered) { return; }
+    QDBusConnection system = QDBusConnection::systemBus();
+    system.unregisterObject(LOGIND_PATH);
+    system.unregisterService(LOGIND_SERVICE);
+    registered = false;
+}
+
+int FakeLogind::inhibits()
+{
+    return inhibitCount;
+}
+
+int FakeLogind::suspends()
+{
+    return suspendCount;
+}
+
+// the read end of a pipe, QDBusUnixFileDescriptor keeps a dup
+QDBusUnixFileDescriptor FakeLogind::Inhibit(const QString &what,
+                                            const QString &who,
+                                            const QString &why,
+                                            const QString &mode)
+{
+    Q_UNUSED(what)
+    Q_UNUSED(who)
+    Q_UNUSED(why)
+    Q_UNUSED(mode)
+    int fds[2];
+    if (pipe(fds) != 0) { return QDBusUnixFileDescriptor(); }
+    QDBusUnixFileDescriptor result(fds[0]);
+    close(fds[0]);
+    close(fds[1]);
+    inhibitCount++;
+    return result;
+}
+
+// counted only, PrepareForSleep is left to the cases
+void FakeLogind::Suspend(bool interactive)
+{
+    Q_UNUSED(interactive)
+    suspendCount++;
+}
+
+QString FakeLogind::CanSuspend()
+{
+    return "yes";
+}
+
+QString FakeLogind::CanHibernate()
+{
+    return "na";
+}
@@ -0,0 +1,46 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef FAKELOGIND_H
+#define FAKELOGIND_H
+
+#include <QObject>
+#include <QString>
+#include <QDBusUnixFileDescriptor>
+
+// Minimal logind manager for the benchmarks, hands out delay
+// inhibitor fds and counts them and the suspend requests.
+// Registered like FakeUPower.
+class FakeLogind : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.login1.Manager")
+
+public:
+    explicit FakeLogind(QObject *parent = NULL);
+    bool start();
+    void stop();
+    int inhibits();
+    int suspends();
+
+private:
+    int inhibitCount;
+    int suspendCount;
+    bool registered;
+
+public slots:
+    QDBusUnixFileDescriptor Inhibit(const QString &what,
+                                    const QString &who,
+                                    const QString &why,
+                                    const QString &mode);
+    void Suspend(bool interactive);
+    QString CanSuspend();
+    QString CanHibernate();
+};
+
+#endif // FAKELOGIND_H
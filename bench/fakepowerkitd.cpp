@@ -0,0 +1,59 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "fakepowerkitd.h"
+#include "powerkit.h"
+
+#include <QDBusConnection>
+
+FakePowerKitd::FakePowerKitd(QObject *parent)
+    : QObject(parent)
+    , registered(false)
+{
+}
+
+bool FakePowerKitd::start()
+{
+    QDBusConnection system = QDBusConnection::systemBus();
+    if (!system.isConnected()) { return false; }
+    if (!system.registerService(PMD_SERVICE)) { return false; }
+    registered = true;
+    if (!system.registerObject(PMD_PATH, this, QDBusConnection::ExportAllSlots)) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void FakePowerKitd::stop()
+{
+    if (!registered) { return; }
+    QDBusConnection system = QDBusConnection::systemBus();
+    system.unregisterObject(PMD_PATH);
+    system.unregisterService(PMD_SERVICE);
+    registered = false;
+}
+
+QDateTime FakePowerKitd::alarm(const QString &name)
+{
+    return alarms.value(name);
+}
+
+// same format as the daemon, replaces an alarm with the same name
+bool FakePowerKitd::addWakeAlarm(const QString &name, const QString &alarm)
+{
+    QDateTime date = QDateTime::fromString(alarm, "yyyy-MM-dd HH:mm:ss");
+    if (name.isEmpty() || !date.isValid()) { return false; }
+    alarms[name] = date;
+    return true;
+}
+
+bool FakePowerKitd::cancelWakeAlarm(const QString &name)
+{
+    return alarms.remove(name)>0;
+}
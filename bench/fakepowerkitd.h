@@ -0,0 +1,39 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef FAKEPOWERKITD_H
+#define FAKEPOWERKITD_H
+
+#include <QObject>
+#include <QString>
+#include <QMap>
+#include <QDateTime>
+
+// Minimal powerkitd manager for the benchmarks, keeps the named
+// wake alarms in a map. Registered like FakeUPower.
+class FakePowerKitd : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.powerkitd.Manager")
+
+public:
+    explicit FakePowerKitd(QObject *parent = NULL);
+    bool start();
+    void stop();
+    QDateTime alarm(const QString &name); // invalid if not queued
+
+private:
+    QMap<QString, QDateTime> alarms;
+    bool registered;
+
+public slots:
+    bool addWakeAlarm(const QString &name, const QString &alarm);
+    bool cancelWakeAlarm(const QString &name);
+};
+
+#endif // FAKEPOWERKITD_H
@@ -0,0 +1,68 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "fakeupower.h"
+#include "powerkit.h"
+
+#include <QDBusConnection>
+
+#define FAKE_BATTERY "battery_BAT0"
+#define FAKE_AC "line_power_AC"
+
+FakeUPowerDevice::FakeUPowerDevice(const QString &nativePath,
+                                   uint type,
+                                   QObject *parent)
+    : QObject(parent)
+    , devNativePath(nativePath)
+    , devType(type)
+{
+}
+
+FakeUPower::FakeUPower(QObject *parent)
+    : QObject(parent)
+    , battery(0)
+    , ac(0)
+    , registered(false)
+{
+    battery = new FakeUPowerDevice("BAT0", Device::DeviceBattery, this);
+    ac = new FakeUPowerDevice("AC", Device::DeviceLinePower, this);
+}
+
+bool FakeUPower::start()
+{
+    QDBusConnection system = QDBusConnection::systemBus();
+    if (!system.isConnected()) { return false; }
+    if (!system.registerService(UPOWER_SERVICE)) { return false; }
+    registered = true;
+    QDBusConnection::RegisterOptions options = QDBusConnection::ExportAllProperties;
+    if (!system.registerObject(UPOWER_PATH, this, options) ||
+        !system.registerObject(QString("%1%2").arg(UPOWER_DEVICES).arg(FAKE_BATTERY),
+                               battery,
+                               options) ||
+        !system.registerObject(QString("%1%2").arg(UPOWER_DEVICES).arg(FAKE_AC),
+                               ac,
+                               options)) {
+        stop();
+        return false;
+    }
+    return true;
+}
+
+void FakeUPower::stop()
+{
+    if (!registered) { return; }
+    QDBusConnection system = QDBusConnection::systemBus();
+    system.unregisterObject(UPOWER_PATH, QDBusConnection::UnregisterTree);
+    system.unregisterService(UPOWER_SERVICE);
+    registered = false;
+}
+
+QString FakeUPower::batteryPath()
+{
+    return QString("%1%2").arg(UPOWER_DEVICES).arg(FAKE_BATTERY);
+}
@@ -0,0 +1,95 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef FAKEUPOWER_H
+#define FAKEUPOWER_H
+
+#include <QObject>
+#include <QString>
+
+// a UPower device with fixed properties
+class FakeUPowerDevice : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.UPower.Device")
+    Q_PROPERTY(QString Model READ model)
+    Q_PROPERTY(double Capacity READ capacity)
+    Q_PROPERTY(bool IsRechargeable READ isRechargeable)
+    Q_PROPERTY(bool IsPresent READ isPresent)
+    Q_PROPERTY(double Percentage READ percentage)
+    Q_PROPERTY(double EnergyFullDesign READ energyFullDesign)
+    Q_PROPERTY(double EnergyFull READ energyFull)
+    Q_PROPERTY(double EnergyEmpty READ energyEmpty)
+    Q_PROPERTY(double Energy READ energy)
+    Q_PROPERTY(double EnergyRate READ energyRate)
+    Q_PROPERTY(bool Online READ online)
+    Q_PROPERTY(bool PowerSupply READ powerSupply)
+    Q_PROPERTY(qlonglong TimeToEmpty READ timeToEmpty)
+    Q_PROPERTY(qlonglong TimeToFull READ timeToFull)
+    Q_PROPERTY(uint Type READ type)
+    Q_PROPERTY(QString Vendor READ vendor)
+    Q_PROPERTY(QString NativePath READ nativePath)
+
+public:
+    FakeUPowerDevice(const QString &nativePath,
+                     uint type,
+                     QObject *parent = NULL);
+
+    QString model() const { return "Bench"; }
+    double capacity() const { return 90; }
+    bool isRechargeable() const { return devType == 2; }
+    bool isPresent() const { return true; }
+    double percentage() const { return 55; }
+    double energyFullDesign() const { return 50; }
+    double energyFull() const { return 45; }
+    double energyEmpty() const { return 0; }
+    double energy() const { return 24.75; }
+    double energyRate() const { return 9.5; }
+    bool online() const { return false; }
+    bool powerSupply() const { return true; }
+    qlonglong timeToEmpty() const { return 9378; }
+    qlonglong timeToFull() const { return 0; }
+    uint type() const { return devType; }
+    QString vendor() const { return "PowerKit"; }
+    QString nativePath() const { return devNativePath; }
+
+private:
+    QString devNativePath;
+    uint devType;
+};
+
+// Minimal UPower service for the benchmarks, a battery and a line
+// power device. Runs on the system bus connection of this process,
+// start the bench on a private bus (see bench.pro).
+class FakeUPower : public QObject
+{
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.freedesktop.UPower")
+    Q_PROPERTY(bool OnBattery READ onBattery)
+    Q_PROPERTY(bool LidIsPresent READ lidIsPresent)
+    Q_PROPERTY(bool LidIsClosed READ lidIsClosed)
+    Q_PROPERTY(bool IsDocked READ isDocked)
+
+public:
+    explicit FakeUPower(QObject *parent = NULL);
+    bool start();
+    void stop();
+    QString batteryPath();
+
+    bool onBattery() const { return true; }
+    bool lidIsPresent() const { return true; }
+    bool lidIsClosed() const { return false; }
+    bool isDocked() const { return false; }
+
+private:
+    FakeUPowerDevice *battery;
+    FakeUPowerDevice *ac;
+    bool registered;
+};
+
+#endif // FAKEUPOWER_H
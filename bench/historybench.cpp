@@ -0,0 +1,215 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "historybench.h"
+#include "clock.h"
+#include "common.h"
+#include "device.h"
+#include "estimator.h"
+#include "health.h"
+#include "history.h"
+
+#include <QFile>
+#include <QtTest/QtTest>
+
+#define BENCH_HISTORY_SAMPLES 5000
+#define BENCH_HISTORY_END Q_INT64_C(4102444800) // 2100-01-01
+#define BENCH_HISTORY_USED 4 // offset of Block::used, see history.h
+#define BENCH_ESTIMATOR_MAE 540 // seconds
+
+static QByteArray readBytes(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) { return QByteArray(); }
+    return file.readAll();
+}
+
+static bool writeBytes(const QString &path, const QByteArray &data)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) { return false; }
+    return file.write(data) == data.size();
+}
+
+// one sample a minute, uneven drain so the deltas vary
+static HistorySample historySample(int i)
+{
+    HistorySample sample;
+    sample.timestamp = 1500000000+(qint64)i*60;
+    sample.energy = 50.0-(double)(i%500)*0.09-(double)(i%7)*0.01;
+    sample.rate = 8.0+(double)(i%13)*0.25;
+    sample.percentage = 100.0-(double)(i%500)*0.18;
+    sample.source = HistorySample::SourceBattery;
+    return sample;
+}
+
+static bool sameSample(const HistorySample &a, const HistorySample &b)
+{
+    return a.timestamp == b.timestamp &&
+           qRound64(a.energy*1000) == qRound64(b.energy*1000) &&
+           qRound64(a.rate*1000) == qRound64(b.rate*1000) &&
+           qRound64(a.percentage*100) == qRound64(b.percentage*100) &&
+           a.source == b.source;
+}
+
+HistoryBench::HistoryBench(const QString &root, QObject *parent)
+    : QObject(parent)
+    , root(root)
+{
+}
+
+// three hours on battery, a sample every 30s. the draw switches
+// between 12 and 15W, upower only updates energy every other minute
+// (0.1Wh steps) and the rate has bursts and jitter. the trace goes
+// through the history ring and is replayed from it
+void HistoryBench::estimatorReplay()
+{
+    QString path = QString("%1/history/estimator.%2").arg(root).arg(HISTORY_SUFFIX);
+    BatteryHistory history(path, 4);
+    QVERIFY(history.isOpen());
+    double energy = 50;
+    double shown = energy;
+    quint64 seed = 12345;
+    for (int i=0;i<=360;++i) {
+        double draw = (i/40)%2?15:12;
+        if (i>0) { energy -= draw*30/3600; }
+        if (i%4 == 0) { shown = qRound(energy*10)/10.0; }
+        seed = (seed*1103515245+12345)&0x7fffffff;
+        HistorySample sample;
+        sample.timestamp = 1500000000+(qint64)i*30;
+        sample.energy = shown;
+        sample.rate = draw+(i%7 == 0?15:0)+(double)((int)((seed>>16)%100)-50)/50.0;
+        sample.source = HistorySample::SourceBattery;
+        QVERIFY(history.append(sample));
+    }
+    QList<HistorySample> trace = history.query(0, BENCH_HISTORY_END);
+    QCOMPARE(trace.size(), 361);
+
+    double error = DischargeEstimator::meanAbsoluteError(trace);
+    double baseline = DischargeEstimator::meanAbsoluteError(trace, true);
+    QVERIFY(error>=0);
+    QVERIFY(error<BENCH_ESTIMATOR_MAE);
+    QVERIFY(error<baseline);
+    QBENCHMARK { DischargeEstimator::meanAbsoluteError(trace); }
+}
+
+// a battery losing 0.02Wh of 50Wh a day for 60 days on a test
+// clock, saved outside the watched config dir
+void HistoryBench::healthProjection()
+{
+    TestClock clock(Q_INT64_C(1500000000000));
+    HealthTracker health;
+    health.setClock(&clock);
+    Device device("/org/freedesktop/UPower/devices/battery_BENCH0");
+    device.isBattery = true;
+    device.isPresent = true;
+    device.vendor = "bench";
+    device.model = "health";
+    device.energyFullDesign = 50;
+    device.energy = 40;
+    QString key = HealthTracker::keyForDevice(&device);
+    for (int day=0;day<60;++day) {
+        device.energyFull = 48-day*0.02;
+        health.update(&device);
+        clock.advance(86400000);
+    }
+    QVERIFY(health.contains(key));
+    QCOMPARE(health.report(key).value("samples").toInt(), 60);
+    QVERIFY(qAbs(health.fadePerYear(key)-0.02*365/50*100)<0.1);
+    // 48Wh to the 40Wh end of life at 0.02Wh/day
+    QDate eol = QDateTime::fromMSecsSinceEpoch(Q_INT64_C(1500000000000)).date().addDays(400);
+    QVERIFY(qAbs(health.endOfLife(key).daysTo(eol))<=1);
+
+    QString file = QString("%1/%2/%3").arg(Common::confDir()).arg(HEALTH_DIR).arg(HEALTH_FILE);
+    QVERIFY(QFile::exists(file));
+    QVERIFY(!QFile::exists(QString("%1/%2").arg(Common::confDir()).arg(HEALTH_FILE)));
+    QBENCHMARK { health.update(&device); }
+    QVERIFY(QFile::remove(file));
+}
+
+// a two block ring filled a few times over keeps the newest
+// samples in order, also after being opened again
+void HistoryBench::historyWrap()
+{
+    QString path = QString("%1/history/wrap.%2").arg(root).arg(HISTORY_SUFFIX);
+    QList<HistorySample> samples;
+    {
+        BatteryHistory history(path, 2);
+        QVERIFY(history.isOpen());
+        for (int i=0;i<BENCH_HISTORY_SAMPLES;++i) {
+            QVERIFY(history.append(historySample(i)));
+        }
+        samples = history.query(0, BENCH_HISTORY_END);
+    }
+    QVERIFY(samples.size()>0);
+    QVERIFY(samples.size()<BENCH_HISTORY_SAMPLES/2); // recycled
+    int first = BENCH_HISTORY_SAMPLES-samples.size();
+    for (int i=0;i<samples.size();++i) {
+        QVERIFY(sameSample(samples.at(i), historySample(first+i)));
+    }
+
+    BatteryHistory history(path, 2);
+    QVERIFY(history.isOpen());
+    QVERIFY(sameSample(history.last(), historySample(BENCH_HISTORY_SAMPLES-1)));
+    QCOMPARE(history.query(0, BENCH_HISTORY_END).size(), samples.size());
+    QVERIFY(history.append(historySample(BENCH_HISTORY_SAMPLES)));
+    QVERIFY(sameSample(history.query(0, BENCH_HISTORY_END).last(),
+                       historySample(BENCH_HISTORY_SAMPLES)));
+    int i = BENCH_HISTORY_SAMPLES;
+    QBENCHMARK { history.append(historySample(++i)); }
+}
+
+// a crash after the record is written but before it is committed
+// leaves junk past 'used', it must be ignored and overwritten.
+// a truncated file is started over
+void HistoryBench::historyTornWrite()
+{
+    QString path = QString("%1/history/torn.%2").arg(root).arg(HISTORY_SUFFIX);
+    int count = 100;
+    {
+        BatteryHistory history(path, 4);
+        QVERIFY(history.isOpen());
+        for (int i=0;i<count;++i) { QVERIFY(history.append(historySample(i))); }
+    }
+    QByteArray before = readBytes(path);
+    {
+        BatteryHistory history(path, 4);
+        QVERIFY(history.append(historySample(count)));
+    }
+    QByteArray torn = readBytes(path);
+    QVERIFY(torn != before);
+    // first block, the only one in use
+    int used = HISTORY_BLOCK_SIZE+BENCH_HISTORY_USED;
+    torn.replace(used, 4, before.mid(used, 4));
+    QVERIFY(writeBytes(path, torn));
+    {
+        BatteryHistory history(path, 4);
+        QVERIFY(history.isOpen());
+        QCOMPARE(history.query(0, BENCH_HISTORY_END).size(), count);
+        QVERIFY(sameSample(history.last(), historySample(count-1)));
+        HistorySample next = historySample(count);
+        next.energy += 1.5;
+        next.source = HistorySample::SourceAC;
+        QVERIFY(history.append(next));
+        QList<HistorySample> samples = history.query(0, BENCH_HISTORY_END);
+        QCOMPARE(samples.size(), count+1);
+        QVERIFY(sameSample(samples.last(), next));
+        QVERIFY(sameSample(samples.at(count-1), historySample(count-1)));
+    }
+
+    QVERIFY(writeBytes(path, torn.left(torn.size()/2)));
+    BatteryHistory history(path, 4);
+    QVERIFY(history.isOpen());
+    QCOMPARE(history.query(0, BENCH_HISTORY_END).size(), 0);
+    QVERIFY(history.append(historySample(0)));
+    QCOMPARE(history.query(0, BENCH_HISTORY_END).size(), 1);
+    QBENCHMARK {
+        BatteryHistory reopened(path, 4);
+        reopened.last();
+    }
+}
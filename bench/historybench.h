@@ -0,0 +1,34 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef HISTORYBENCH_H
+#define HISTORYBENCH_H
+
+#include <QObject>
+#include <QString>
+
+// battery history ring, discharge estimator and health tracker,
+// files below the scratch dir.
+class HistoryBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit HistoryBench(const QString &root, QObject *parent = NULL);
+
+private:
+    QString root;
+
+private slots:
+    void estimatorReplay();
+    void healthProjection();
+    void historyWrap();
+    void historyTornWrite();
+};
+
+#endif // HISTORYBENCH_H
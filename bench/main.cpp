@@ -0,0 +1,174 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QTextStream>
+#include <QXmlStreamReader>
+#include <QtTest/QtTest>
+
+#include "benchmark.h"
+#include "common.h"
+#include "fakelogind.h"
+#include "fakepowerkitd.h"
+#include "fakeupower.h"
+#include "historybench.h"
+#include "policybench.h"
+#include "schedulerbench.h"
+#include "suspendbench.h"
+#include "xbenchmark.h"
+
+#include <unistd.h>
+
+// prefer tmpfs for the fake sysfs tree
+static QString scratchDir()
+{
+    QString base = QDir::tempPath();
+    QFileInfo shm("/dev/shm");
+    if (shm.isDir() && shm.isWritable()) { base = shm.absoluteFilePath(); }
+    return QString("%1/powerkit-bench-%2").arg(base).arg(getpid());
+}
+
+static void removeTree(const QString &path)
+{
+    QDir dir(path);
+    QFileInfoList entries = dir.entryInfoList(QDir::NoDotAndDotDot|
+                                              QDir::AllEntries|
+                                              QDir::Hidden|
+                                              QDir::System);
+    foreach (QFileInfo entry, entries) {
+        if (entry.isDir() && !entry.isSymLink()) { removeTree(entry.absoluteFilePath()); }
+        else { QFile::remove(entry.absoluteFilePath()); }
+    }
+    QDir().rmdir(path);
+}
+
+static QString jsonString(const QString &value)
+{
+    QString result;
+    for (int i=0;i<value.size();++i) {
+        QChar c = value.at(i);
+        if (c == '"' || c == '\\') { result.append('\\').append(c); }
+        else if (c.unicode()<0x20) {
+            result.append(QString("\\u%1").arg((int)c.unicode(), 4, 16, QChar('0')));
+        }
+        else { result.append(c); }
+    }
+    return QString("\"%1\"").arg(result);
+}
+
+// QtTest XML logs to JSON, one entry per benchmark result
+static QString toJson(const QStringList &logs, int failed)
+{
+    QStringList results;
+    QStringList skipped;
+    foreach (QString xml, logs) {
+        QFile file(xml);
+        if (!file.open(QIODevice::ReadOnly)) { continue; }
+        QXmlStreamReader reader(&file);
+        QString function;
+        while (!reader.atEnd()) {
+            reader.readNext();
+            if (!reader.isStartElement()) { continue; }
+            QXmlStreamAttributes attr = reader.attributes();
+            QString name = reader.name().toString();
+            if (name == "TestFunction") {
+                function = attr.value("name").toString();
+            } else if ((name == "Incident" || name == "Message") &&
+                       attr.value("type").toString() == "skip") {
+                if (!skipped.contains(function)) { skipped << function; }
+            } else if (name == "BenchmarkResult") {
+                results << QString("    {\"name\": %1, \"tag\": %2, \"metric\": %3, "
+                                   "\"value\": %4, \"iterations\": %5}")
+                           .arg(jsonString(function))
+                           .arg(jsonString(attr.value("tag").toString()))
+                           .arg(jsonString(attr.value("metric").toString()))
+                           .arg(attr.value("value").toString().toDouble(), 0, 'g', 12)
+                           .arg(attr.value("iterations").toString().toInt());
+            }
+        }
+    }
+    QStringList skippedJson;
+    foreach (QString name, skipped) { skippedJson << jsonString(name); }
+    return QString("{\n"
+                   "  \"benchmark\": \"powerkit\",\n"
+                   "  \"qt\": %1,\n"
+                   "  \"failed\": %2,\n"
+                   "  \"skipped\": [%3],\n"
+                   "  \"results\": [\n%4\n  ]\n"
+                   "}\n")
+            .arg(jsonString(qVersion()))
+            .arg(failed)
+            .arg(skippedJson.join(", "))
+            .arg(results.join(",\n"));
+}
+
+// powerkit-bench [--json file] [QtTest options]
+int main(int argc, char *argv[])
+{
+    QString root = scratchDir();
+    QDir().mkpath(QString("%1/config").arg(root));
+    qputenv("XDG_CONFIG_HOME", QFile::encodeName(QString("%1/config").arg(root)));
+
+    QCoreApplication app(argc, argv);
+    QStringList args = app.arguments();
+    QString json;
+    int index = args.indexOf("--json");
+    if (index>0 && index+1<args.size()) {
+        json = args.at(index+1);
+        args.removeAt(index+1);
+        args.removeAt(index);
+    }
+
+    // settings end up in $XDG_CONFIG_HOME
+    Common::saveDefaultSettings();
+
+    // shared by the suites, NULL without a private system bus
+    FakeUPower upower;
+    FakeLogind logind;
+    FakePowerKitd pmd;
+    bool hasUPower = upower.start();
+    bool hasLogind = logind.start();
+    bool hasPmd = pmd.start();
+
+    Benchmark bench(root, hasUPower?&upower:NULL);
+    SchedulerBench schedulerBench;
+    HistoryBench historyBench(root);
+    SuspendBench suspendBench(root,
+                              hasUPower?&upower:NULL,
+                              hasLogind?&logind:NULL,
+                              hasPmd?&pmd:NULL);
+    PolicyBench policyBench(root);
+    XBenchmark xbench;
+    QList<QObject*> suites;
+    suites << &bench << &schedulerBench << &historyBench
+           << &suspendBench << &policyBench << &xbench;
+    QStringList logs;
+    int failed = 0;
+    for (int i=0;i<suites.size();++i) {
+        logs << QString("%1/results-%2.xml").arg(root).arg(i);
+        failed += QTest::qExec(suites.at(i), QStringList(args) << "-xml" << "-o" << logs.last());
+    }
+
+    QString result = toJson(logs, failed);
+    if (json.isEmpty()) { QTextStream(stdout) << result; }
+    else {
+        QFile out(json);
+        if (out.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+            QTextStream(&out) << result;
+        } else { qWarning() << "unable to write" << json; }
+    }
+    upower.stop();
+    logind.stop();
+    pmd.stop();
+    removeTree(root);
+    return failed;
+}
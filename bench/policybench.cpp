@@ -0,0 +1,452 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "policybench.h"
+#include "benchutil.h"
+#include "clock.h"
+#include "cpuprofile.h"
+#include "def.h"
+#include "policy.h"
+#include "runtimepm.h"
+#include "simulator.h"
+#include "sysfstransaction.h"
+#include "trace.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QStringList>
+#include <QtTest/QtTest>
+
+static void addDecisions(QStringList *out, int event, const Policy::Actions &actions)
+{
+    foreach (Policy::Action action, actions) {
+        if (action.type == Policy::ActionCancelRecheck) { continue; }
+        out->append(QString("%1 %2 %3")
+                    .arg(event)
+                    .arg(Policy::actionName(action.type))
+                    .arg(action.value));
+    }
+}
+
+PolicyBench::PolicyBench(const QString &root, QObject *parent)
+    : QObject(parent)
+    , root(root)
+{
+}
+
+// every event type, negative values and two sessions appended to
+// the same file (the second starts earlier, absolute time again)
+void PolicyBench::traceRoundTrip()
+{
+    QString path = QString("%1/trace/roundtrip.trace").arg(root);
+    QFile::remove(path);
+    PowerSettings settings;
+    settings.autoSuspendBattery = 7;
+    settings.batterySaver = "30:70";
+    QList<TraceEvent> events;
+    qint64 time = Q_INT64_C(1500000000000);
+    for (int type=0;type<TraceEvent::TraceTypes;++type) {
+        TraceEvent event(type, time);
+        for (int i=0;i<TraceEvent::valueCount(type);++i) {
+            event.values[i] = (i%2?-1:1)*(qint64)(type*1000+i);
+        }
+        if (type == TraceEvent::TraceSettings) { event.data = settings.toMap(); }
+        events << event;
+        time += 1500*type;
+    }
+    TraceEvent battery(TraceEvent::TraceBattery, time+Q_INT64_C(86400000)*40);
+    battery.values[0] = 2550;
+    battery.values[1] = 1;
+    battery.values[2] = -1;
+    battery.values[3] = Q_INT64_C(5000000000);
+    events << battery;
+    {
+        TraceRecorder recorder(path);
+        QVERIFY(recorder.isOpen());
+        foreach (TraceEvent event, events) { QVERIFY(recorder.record(event)); }
+    }
+    TraceEvent earlier(TraceEvent::TraceIdle, Q_INT64_C(1400000000000));
+    earlier.values[0] = 3;
+    {
+        TraceRecorder recorder(path);
+        QVERIFY(recorder.record(earlier));
+    }
+    events << earlier;
+
+    bool ok = false;
+    QList<TraceEvent> read = TraceRecorder::read(path, &ok);
+    QVERIFY(ok);
+    QCOMPARE(read.size(), events.size());
+    for (int i=0;i<events.size();++i) {
+        QCOMPARE(read.at(i).time, events.at(i).time);
+        QCOMPARE(read.at(i).type, events.at(i).type);
+        for (int v=0;v<TRACE_VALUES;++v) {
+            QCOMPARE(read.at(i).values[v], events.at(i).values[v]);
+        }
+        QCOMPARE(read.at(i).data, events.at(i).data);
+    }
+    QCOMPARE(PowerSettings::fromMap(read.first().data).autoSuspendBattery, 7);
+    QCOMPARE(PowerSettings::fromMap(read.first().data).batterySaver, QString("30:70"));
+
+    // a truncated last record is dropped, the rest is kept
+    QFile file(path);
+    QVERIFY(file.resize(file.size()-1));
+    read = TraceRecorder::read(path, &ok);
+    QVERIFY(!ok);
+    QCOMPARE(read.size(), events.size()-1);
+    QBENCHMARK { TraceRecorder::read(path); }
+}
+
+// a tray session run on a live policy and recorded, the replay of
+// the recording must make the same decisions at the same events
+void PolicyBench::traceReplay()
+{
+    QString path = QString("%1/trace/replay.trace").arg(root);
+    QFile::remove(path);
+    qint64 start = Q_INT64_C(1500000000000);
+    TestClock clock(start);
+    Policy policy(PowerSettings(), &clock);
+    QStringList live;
+    QList<TraceEvent> events;
+    bool suspended = false;
+    {
+        TraceRecorder recorder(path);
+        QVERIFY(recorder.isOpen());
+
+        PowerSettings settings;
+        settings.autoSuspendBattery = 5;
+        settings.autoSuspendBatteryAction = suspendSleep;
+        settings.lidActionBattery = lidSleep;
+        settings.criticalBattery = 10;
+        settings.criticalAction = criticalHibernate;
+        settings.batterySaver = "30:70,15:50";
+        TraceEvent event(TraceEvent::TraceSettings, start);
+        event.data = settings.toMap();
+        events << event;
+        policy.setSettings(settings);
+
+        event = TraceEvent(TraceEvent::TracePower, start+1000);
+        event.values[0] = 1;
+        event.values[1] = 50;
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.switchedToBattery(50));
+
+        event = TraceEvent(TraceEvent::TraceBattery, start+60000);
+        event.values[0] = 2500;
+        event.values[1] = 1;
+        event.values[2] = -1;
+        event.values[3] = -1;
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.battery(25, true, -1, -1));
+
+        event = TraceEvent(TraceEvent::TraceIdle, start+360000);
+        event.values[0] = 6;
+        event.values[1] = 1;
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.idle(6, true, false));
+
+        events << TraceEvent(TraceEvent::TraceSuspend, start+361000);
+        BenchUtil::moveTestClock(&clock, start+361000, suspended);
+        suspended = true;
+
+        events << TraceEvent(TraceEvent::TraceResume, start+4000000);
+        BenchUtil::moveTestClock(&clock, start+4000000, suspended);
+        suspended = false;
+        policy.resetIdle();
+
+        event = TraceEvent(TraceEvent::TraceIdle, start+4120000);
+        event.values[0] = 2;
+        event.values[1] = 1;
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.idle(2, true, false));
+
+        event = TraceEvent(TraceEvent::TraceLid, start+4200000);
+        event.values[0] = 1;
+        event.values[1] = 1;
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.lidClosed(true, false));
+
+        event = TraceEvent(TraceEvent::TraceLid, start+4300000);
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.lidOpened());
+
+        event = TraceEvent(TraceEvent::TraceBattery, start+4400000);
+        event.values[0] = 1100;
+        event.values[1] = 1;
+        event.values[2] = -1;
+        event.values[3] = -1;
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.battery(11, true, -1, -1));
+
+        event = TraceEvent(TraceEvent::TracePower, start+4500000);
+        event.values[1] = 80;
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.switchedToAC(80));
+
+        event = TraceEvent(TraceEvent::TraceBattery, start+4600000);
+        event.values[0] = 1200;
+        event.values[2] = -1;
+        event.values[3] = -1;
+        events << event;
+        BenchUtil::moveTestClock(&clock, event.time, suspended);
+        addDecisions(&live, events.size()-1, policy.battery(12, false, -1, -1));
+
+        foreach (TraceEvent next, events) { QVERIFY(recorder.record(next)); }
+    }
+    QVERIFY(live.join(" ").contains("suspend"));
+    QVERIFY(live.join(" ").contains("cpu_limit"));
+
+    bool ok = false;
+    QList<TraceEvent> trace = TraceRecorder::read(path, &ok);
+    QVERIFY(ok);
+    TraceReplay replay;
+    replay.run(trace);
+    QStringList replayed;
+    foreach (TraceReplay::Entry entry, replay.actions()) {
+        addDecisions(&replayed, entry.event, Policy::Actions() << entry.action);
+    }
+    QCOMPARE(replayed, live);
+    QBENCHMARK { replay.run(trace); }
+}
+
+// 2%/minute from 20%, the critical action must run once
+// and before the battery is empty
+void PolicyBench::criticalFastDrain()
+{
+    QList<TraceEvent> trace;
+    for (int i=0;i<=10;++i) {
+        TraceEvent event(TraceEvent::TraceBattery, (qint64)i*60000);
+        event.values[0] = (20-i*2)*100;
+        event.values[1] = 1;
+        event.values[2] = -1;
+        event.values[3] = -1;
+        trace << event;
+    }
+    PowerSettings settings;
+    settings.autoSuspendBattery = 0;
+    settings.criticalBattery = 10;
+    settings.criticalAction = criticalHibernate;
+
+    Simulator simulator(trace);
+    Simulator::Result result = simulator.run(settings);
+    QCOMPARE(result.criticalActions, 1);
+    QCOMPARE(result.depleted, 0);
+    QBENCHMARK { simulator.run(settings); }
+}
+
+void PolicyBench::criticalPrediction_data()
+{
+    QTest::addColumn<double>("left");
+    QTest::addColumn<qlonglong>("timeToEmpty");
+    QTest::addColumn<qlonglong>("timeToCritical");
+    QTest::addColumn<int>("action");
+    QTest::addColumn<double>("wait");
+    QTest::newRow("no estimate") << 20.0 << (qlonglong)-1 << (qlonglong)-1
+                                 << (int)Policy::ActionNone << 0.0;
+    QTest::newRow("recheck") << 20.0 << (qlonglong)-1 << (qlonglong)600
+                             << (int)Policy::ActionRecheck
+                             << (double)(600-CRITICAL_HIBERNATE_LEAD-CRITICAL_RECHECK_MARGIN);
+    QTest::newRow("recheck soon") << 14.0 << (qlonglong)-1 << (qlonglong)(CRITICAL_HIBERNATE_LEAD+5)
+                                  << (int)Policy::ActionRecheck
+                                  << (double)CRITICAL_RECHECK_MARGIN;
+    QTest::newRow("predicted critical") << 12.0 << (qlonglong)-1 << (qlonglong)45
+                                        << (int)Policy::ActionHibernate << 0.0;
+    QTest::newRow("short time to empty") << 20.0 << (qlonglong)60 << (qlonglong)-1
+                                         << (int)Policy::ActionNone << 0.0;
+    QTest::newRow("threshold") << 10.0 << (qlonglong)-1 << (qlonglong)0
+                               << (int)Policy::ActionHibernate << 0.0;
+}
+
+// the critical action runs when the predicted time to the critical
+// level is within the time hibernate needs, before the level is seen
+void PolicyBench::criticalPrediction()
+{
+    QFETCH(double, left);
+    QFETCH(qlonglong, timeToEmpty);
+    QFETCH(qlonglong, timeToCritical);
+    QFETCH(int, action);
+    QFETCH(double, wait);
+    PowerSettings settings;
+    settings.warnOnLowBattery = false;
+    settings.warnOnVeryLowBattery = false;
+    settings.criticalBattery = 10;
+    settings.criticalAction = criticalHibernate;
+
+    Policy policy(settings);
+    int found = Policy::ActionNone;
+    double value = 0;
+    foreach (Policy::Action next, policy.battery(left, true, timeToEmpty, timeToCritical)) {
+        if (next.type == Policy::ActionCancelRecheck) { continue; }
+        found = next.type;
+        value = next.value;
+    }
+    QCOMPARE(Policy::actionName(found), Policy::actionName(action));
+    QCOMPARE(value, wait);
+    QBENCHMARK { policy.battery(left, true, timeToEmpty, timeToCritical); }
+}
+
+// battery going 31..28% and back a few times, then down through
+// both bands and onto AC. one cap per band and a lift on AC
+void PolicyBench::batterySaver()
+{
+    PowerSettings settings;
+    settings.warnOnLowBattery = false;
+    settings.warnOnVeryLowBattery = false;
+    settings.batterySaver = "30:70,15:50";
+    QList<double> levels;
+    for (int i=0;i<5;++i) { levels << 31 << 30 << 29 << 30 << 31 << 32 << 30; }
+    for (int i=29;i>=12;--i) { levels << i; }
+    levels << 14 << 16 << 17 << 15;
+
+    Policy policy(settings);
+    QList<int> caps;
+    foreach (double left, levels) {
+        foreach (Policy::Action action, policy.battery(left, true, -1, -1)) {
+            if (action.type == Policy::ActionCpuLimit) { caps << (int)action.value; }
+        }
+    }
+    foreach (Policy::Action action, policy.battery(15, false, -1, -1)) {
+        if (action.type == Policy::ActionCpuLimit) { caps << (int)action.value; }
+    }
+    QCOMPARE(caps, QList<int>() << 70 << 50 << 100);
+    QBENCHMARK {
+        foreach (double left, levels) { policy.battery(left, true, -1, -1); }
+    }
+}
+
+// two intel_pstate policies and a platform profile in a fake sysfs,
+// a failed write must leave every value as it was
+void PolicyBench::cpuProfile()
+{
+    QString cpu = QString("%1/cpu%2").arg(root).arg(CPU_SYSFS);
+    for (int i=0;i<2;++i) {
+        QString policy = QString("%1/cpufreq/policy%2").arg(cpu).arg(i);
+        QVERIFY(QDir().mkpath(policy));
+        QVERIFY(BenchUtil::writeFile(QString("%1/scaling_available_governors").arg(policy),
+                          "performance powersave"));
+        QVERIFY(BenchUtil::writeFile(QString("%1/scaling_governor").arg(policy), "powersave"));
+        QVERIFY(BenchUtil::writeFile(QString("%1/energy_performance_available_preferences").arg(policy),
+                          "default performance balance_performance balance_power power"));
+        QVERIFY(BenchUtil::writeFile(QString("%1/energy_performance_preference").arg(policy),
+                          "balance_performance"));
+        QVERIFY(BenchUtil::writeFile(QString("%1/cpuinfo_min_freq").arg(policy), "400000"));
+        QVERIFY(BenchUtil::writeFile(QString("%1/cpuinfo_max_freq").arg(policy), "4000000"));
+        QVERIFY(BenchUtil::writeFile(QString("%1/scaling_max_freq").arg(policy), "4000000"));
+    }
+    QVERIFY(QDir().mkpath(QString("%1/intel_pstate").arg(cpu)));
+    QVERIFY(BenchUtil::writeFile(QString("%1/intel_pstate/no_turbo").arg(cpu), "0"));
+    QString platform = QString("%1/cpu%2").arg(root).arg(CPU_PLATFORM_PROFILE);
+    QVERIFY(QDir().mkpath(QFileInfo(platform).absolutePath()));
+    QVERIFY(BenchUtil::writeFile(QString("%1_choices").arg(platform), "low-power balanced performance"));
+    QVERIFY(BenchUtil::writeFile(platform, "balanced"));
+
+    CpuProfile profile(QString("%1/cpu").arg(root));
+    QVERIFY(profile.apply(CpuProfile::profile(CPU_PROFILE_POWERSAVE)));
+    QVariantMap state = profile.state();
+    QCOMPARE(state.value(CPU_GOVERNOR).toString(), QString("powersave"));
+    QCOMPARE(state.value(CPU_EPP).toString(), QString("power"));
+    QCOMPARE(state.value(CPU_PLATFORM).toString(), QString("low-power"));
+    QCOMPARE(state.value(CPU_BOOST).toBool(), false);
+    QVERIFY(!profile.apply(QVariantMap()));
+
+    QVariantMap limit;
+    limit[CPU_MAX_FREQ] = 5;
+    QVERIFY(profile.apply(limit));
+    QCOMPARE(SysfsTransaction::read(QString("%1/cpufreq/policy1/scaling_max_freq").arg(cpu)),
+             QString("400000"));
+    limit[CPU_MAX_FREQ] = 100;
+    QVERIFY(profile.apply(limit));
+    QCOMPARE(profile.state().value(CPU_MAX_FREQ).toInt(), 100);
+    limit[CPU_MAX_FREQ] = 0;
+    QVERIFY(!profile.apply(limit));
+
+    // the platform profile can't be written, the policies are rolled back
+    QVERIFY(QFile::remove(platform));
+    QVERIFY(QDir().mkpath(platform));
+    QVERIFY(!profile.apply(CpuProfile::profile(CPU_PROFILE_PERFORMANCE)));
+    QCOMPARE(profile.state().value(CPU_GOVERNOR).toString(), QString("powersave"));
+    QCOMPARE(profile.state().value(CPU_EPP).toString(), QString("power"));
+    QVERIFY(QDir().rmdir(platform));
+    QVERIFY(BenchUtil::writeFile(platform, "low-power"));
+
+    QBENCHMARK {
+        profile.apply(CpuProfile::profile(CPU_PROFILE_PERFORMANCE));
+        profile.apply(CpuProfile::profile(CPU_PROFILE_POWERSAVE));
+    }
+}
+
+// a pci device, a usb mouse and a usb network adapter in a fake
+// sysfs, the mouse and the denied device are left alone
+void PolicyBench::runtimePM()
+{
+    QString sysfs = QString("%1/runtime").arg(root);
+    QStringList devices;
+    devices << QString("%1%2/0000:00:02.0").arg(sysfs).arg(RUNTIME_PM_PCI)
+            << QString("%1%2/1-1").arg(sysfs).arg(RUNTIME_PM_USB)
+            << QString("%1%2/1-2").arg(sysfs).arg(RUNTIME_PM_USB);
+    foreach (QString device, devices) {
+        QVERIFY(QDir().mkpath(QString("%1/power").arg(device)));
+        QVERIFY(BenchUtil::writeFile(QString("%1/power/control").arg(device), "on"));
+        QVERIFY(BenchUtil::writeFile(QString("%1/power/runtime_status").arg(device), "active"));
+    }
+    QVERIFY(BenchUtil::writeFile(QString("%1/vendor").arg(devices.at(0)), "0x8086"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/device").arg(devices.at(0)), "0x1234"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/idVendor").arg(devices.at(1)), "046d"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/idProduct").arg(devices.at(1)), "c52b"));
+    QVERIFY(QDir().mkpath(QString("%1/1-1:1.0").arg(devices.at(1))));
+    QVERIFY(BenchUtil::writeFile(QString("%1/1-1:1.0/bInterfaceClass").arg(devices.at(1)), "03"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/idVendor").arg(devices.at(2)), "0bda"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/idProduct").arg(devices.at(2)), "8153"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/power/autosuspend_delay_ms").arg(devices.at(2)), "2000"));
+
+    RuntimePM pm(sysfs);
+    QVERIFY(pm.enable(QStringList(), QStringList() << "8086:1234", 500));
+    QCOMPARE(pm.managed().size(), 1);
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/control").arg(devices.at(0))), QString("on"));
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/control").arg(devices.at(1))), QString("on"));
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/control").arg(devices.at(2))), QString("auto"));
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/autosuspend_delay_ms").arg(devices.at(2))), QString("500"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/power/runtime_status").arg(devices.at(2)), "suspended"));
+    QCOMPARE(pm.suspended().size(), 1);
+
+    // enabled again with the mouse allowed, restore goes back to the start
+    QVERIFY(pm.enable(QStringList() << "046d", QStringList(), 500));
+    QCOMPARE(pm.managed().size(), 1);
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/control").arg(devices.at(1))), QString("auto"));
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/control").arg(devices.at(2))), QString("on"));
+    QVERIFY(pm.restore());
+    foreach (QString device, devices) {
+        QCOMPARE(SysfsTransaction::read(QString("%1/power/control").arg(device)), QString("on"));
+    }
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/autosuspend_delay_ms").arg(devices.at(2))), QString("2000"));
+
+    // a write fails, nothing is changed
+    QString control = QString("%1/power/control").arg(devices.at(2));
+    QVERIFY(QFile::remove(control));
+    QVERIFY(QDir().mkpath(control));
+    QVERIFY(!pm.enable(QStringList(), QStringList()));
+    QVERIFY(!pm.isEnabled());
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/control").arg(devices.at(0))), QString("on"));
+    QCOMPARE(SysfsTransaction::read(QString("%1/power/autosuspend_delay_ms").arg(devices.at(2))), QString("2000"));
+    QVERIFY(QDir().rmdir(control));
+    QVERIFY(BenchUtil::writeFile(control, "on"));
+
+    QBENCHMARK {
+        pm.enable(QStringList(), QStringList());
+        pm.restore();
+    }
+}
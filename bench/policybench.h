@@ -0,0 +1,38 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POLICYBENCH_H
+#define POLICYBENCH_H
+
+#include <QObject>
+#include <QString>
+
+// tray policy decisions, traces and replays, and the powerkitd
+// backends the battery saver drives (cpu profiles, runtime pm).
+class PolicyBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PolicyBench(const QString &root, QObject *parent = NULL);
+
+private:
+    QString root;
+
+private slots:
+    void traceRoundTrip();
+    void traceReplay();
+    void criticalFastDrain();
+    void criticalPrediction_data();
+    void criticalPrediction();
+    void batterySaver();
+    void cpuProfile();
+    void runtimePM();
+};
+
+#endif // POLICYBENCH_H
@@ -0,0 +1,66 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "schedulerbench.h"
+#include "def.h"
+#include "scheduler.h"
+
+#include <QtTest/QtTest>
+
+SchedulerBench::SchedulerBench(QObject *parent)
+    : QObject(parent)
+{
+}
+
+void SchedulerBench::tick()
+{
+}
+
+// the tray and library tasks over a simulated hour
+void SchedulerBench::schedulerHour()
+{
+    Scheduler scheduler;
+    scheduler.addTask(this, "tick", IDLE_TIMEOUT);
+    scheduler.addTask(this, "tick", SS_TIMEOUT);
+    scheduler.addTask(this, "tick", PM_TIMEOUT);
+    QBENCHMARK { scheduler.simulate(3600000); }
+}
+
+// wakeups per hour, not time. the cached count follows the tasks
+void SchedulerBench::schedulerHourWakeups()
+{
+    Scheduler scheduler;
+    scheduler.addTask(this, "tick", IDLE_TIMEOUT);
+    int id = scheduler.addTask(this, "tick", SS_TIMEOUT);
+    scheduler.addTask(this, "tick", PM_TIMEOUT);
+    qlonglong wakeups = scheduler.simulate(3600000);
+    QCOMPARE(scheduler.plannedWakeupsPerHour(), wakeups);
+    scheduler.setTaskActive(id, false);
+    QVERIFY(scheduler.plannedWakeupsPerHour()<wakeups);
+    scheduler.setTaskActive(id, true);
+    QCOMPARE(scheduler.plannedWakeupsPerHour(), wakeups);
+    QTest::setBenchmarkResult(wakeups, QTest::Events);
+}
+
+// a task switched on and off many times between wakeups (an
+// inhibitor held briefly) must not grow the heaps
+void SchedulerBench::schedulerToggle()
+{
+    Scheduler scheduler;
+    int id = scheduler.addTask(this, "tick", PM_TIMEOUT);
+    scheduler.addTask(this, "tick", IDLE_TIMEOUT);
+    for (int i=0;i<1000;++i) {
+        scheduler.setTaskActive(id, false);
+        scheduler.setTaskActive(id, true);
+    }
+    QVERIFY(scheduler.pending()<=SCHEDULER_COMPACT*3*2);
+    QBENCHMARK {
+        scheduler.setTaskActive(id, false);
+        scheduler.setTaskActive(id, true);
+    }
+}
@@ -0,0 +1,31 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SCHEDULERBENCH_H
+#define SCHEDULERBENCH_H
+
+#include <QObject>
+
+// Scheduler wakeups and heap upkeep, nothing runs or sleeps.
+class SchedulerBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SchedulerBench(QObject *parent = NULL);
+
+public slots:
+    void tick(); // task receiver, never called by simulate()
+
+private slots:
+    void schedulerHour();
+    void schedulerHourWakeups();
+    void schedulerToggle();
+};
+
+#endif // SCHEDULERBENCH_H
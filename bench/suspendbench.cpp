@@ -0,0 +1,434 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "suspendbench.h"
+#include "alarmqueue.h"
+#include "benchutil.h"
+#include "maintenance.h"
+#include "powerkit.h"
+#include "powermanagement.h"
+#include "rtc.h"
+#include "suspendreport.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QtTest/QtTest>
+
+#define BENCH_RESUME_RUNS 20
+#define BENCH_JOB_WAIT 5000 // ms
+
+SuspendBench::SuspendBench(const QString &root,
+                           FakeUPower *upower,
+                           FakeLogind *logind,
+                           FakePowerKitd *pmd,
+                           QObject *parent)
+    : QObject(parent)
+    , root(root)
+    , upower(upower)
+    , logind(logind)
+    , pmd(pmd)
+{
+}
+
+void SuspendBench::resumePath_data()
+{
+    QTest::addColumn<bool>("complete");
+    QTest::addColumn<bool>("baseline");
+    QTest::newRow("interactive") << false << false;
+    QTest::newRow("complete") << true << false;
+    QTest::newRow("baseline") << true << true;
+}
+
+// resume signal to the tray being usable (the event loop runs
+// again), or to the deferred device updates and delay lock done,
+// average ms. the baseline is the order before resume was split by
+// priority: the delay lock and every device inline before anything
+// else, so it is interactive and complete at the same time
+void SuspendBench::resumePath()
+{
+    if (!upower) { QSKIP("no private system bus", SkipAll); }
+    QFETCH(bool, complete);
+    QFETCH(bool, baseline);
+    PowerKit pk;
+    pk.setLockScreenOnSuspend(false);
+    QElapsedTimer timer;
+    double total = 0;
+    for (int i=0;i<BENCH_RESUME_RUNS;++i) {
+        QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, true));
+        timer.start();
+        if (baseline) {
+            QMetaObject::invokeMethod(&pk, "registerSuspendLock");
+            pk.UpdateDevices();
+            if (pk.OnBattery()) { pk.BatteryEnergy(); }
+            if (pk.hasWakeAlarm()) { pk.CanHibernate(); }
+            pk.clearWakeAlarm();
+        } else {
+            QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, false));
+        }
+        if (complete) { QCoreApplication::processEvents(); }
+        total += (double)timer.nsecsElapsed()/1000000.0;
+        if (!complete) { QCoreApplication::processEvents(); }
+    }
+    QTest::setBenchmarkResult(total/BENCH_RESUME_RUNS, QTest::WalltimeMilliseconds);
+}
+
+// the delay lock is released for each suspend and must be taken
+// again on resume, or the next suspend won't wait for the lock screen
+void SuspendBench::suspendLockCycles()
+{
+    if (!logind) { QSKIP("no private system bus", SkipAll); }
+    PowerKit pk;
+    pk.setLockScreenOnSuspend(false);
+    int inhibits = logind->inhibits();
+    QVERIFY(pk.hasSuspendLock());
+    for (int i=0;i<2;++i) {
+        QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, true));
+        QVERIFY(!pk.hasSuspendLock());
+        QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, false));
+        QCoreApplication::processEvents(); // taken with the deferred devices
+        QVERIFY(pk.hasSuspendLock());
+    }
+    QCOMPARE(logind->inhibits(), inhibits+2);
+}
+
+// two cycles on a test clock: a second awake in the suspend
+// handshake is not sleep, the stages are timed from the resume
+// signal and the kernel counters flag the failed cycle. the saved
+// report reads back the same
+void SuspendBench::suspendReportTiming()
+{
+    QString stats = QString("%1/suspend_stats").arg(root);
+    QVERIFY(QDir().mkpath(stats));
+    QVERIFY(BenchUtil::writeFile(QString("%1/fail").arg(stats), "0"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/total_hw_sleep").arg(stats), "0"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/last_hw_sleep").arg(stats), "0"));
+    QString path = QString("%1/suspend/timing.conf").arg(root);
+    QFile::remove(path);
+
+    TestClock clock(Q_INT64_C(1500000000000));
+    SuspendReport report(path, stats);
+    report.setClock(&clock);
+    report.setSaving(true);
+
+    report.suspending();
+    QVERIFY(report.isSuspended());
+    clock.advance(1000);
+    clock.suspend(3600000);
+    QVERIFY(BenchUtil::writeFile(QString("%1/total_hw_sleep").arg(stats), "3500000000"));
+    QVERIFY(BenchUtil::writeFile(QString("%1/last_hw_sleep").arg(stats), "3500000000"));
+    report.resuming();
+    QVERIFY(!report.isSuspended());
+    clock.advance(150);
+    report.ready(SuspendReport::StageLock);
+    clock.advance(250);
+    report.ready(SuspendReport::StageDevices);
+    clock.advance(600);
+    report.ready(SuspendReport::StageTray);
+    report.ready(SuspendReport::StageLock); // first time only
+    SuspendReport::Cycle cycle = report.last();
+    QCOMPARE(cycle.start, Q_INT64_C(1500000000000));
+    QCOMPARE(cycle.asleep, Q_INT64_C(3600000));
+    QCOMPARE(cycle.hwSleep, Q_INT64_C(3500000));
+    QVERIFY(!cycle.failed);
+    QCOMPARE(cycle.ready[SuspendReport::StageLock], Q_INT64_C(150));
+    QCOMPARE(cycle.ready[SuspendReport::StageDevices], Q_INT64_C(400));
+    QCOMPARE(cycle.ready[SuspendReport::StageTray], Q_INT64_C(1000));
+    QCOMPARE(cycle.latency(), Q_INT64_C(1000));
+
+    // the kernel counted a failure, no hw sleep this time
+    clock.advance(60000);
+    report.suspending();
+    clock.advance(500);
+    clock.suspend(5000);
+    QVERIFY(BenchUtil::writeFile(QString("%1/fail").arg(stats), "1"));
+    report.resuming();
+    cycle = report.last();
+    QCOMPARE(cycle.asleep, Q_INT64_C(5000));
+    QCOMPARE(cycle.hwSleep, Q_INT64_C(-1));
+    QVERIFY(cycle.failed);
+    QCOMPARE(cycle.latency(), Q_INT64_C(-1));
+
+    QVariantMap result = report.report();
+    QCOMPARE(result.value("asleep_msecs").toLongLong(), Q_INT64_C(3605000));
+    QCOMPARE(result.value("resume_msecs_avg").toLongLong(), Q_INT64_C(1000));
+    QCOMPARE(result.value("cycles").toList().size(), 2);
+
+    SuspendReport saved(path, stats);
+    QCOMPARE(saved.cycles().size(), 2);
+    QCOMPARE(saved.cycles().first().asleep, Q_INT64_C(3600000));
+    QCOMPARE(saved.cycles().first().ready[SuspendReport::StageDevices], Q_INT64_C(400));
+    QVERIFY(saved.last().failed);
+    QBENCHMARK { report.report(); }
+}
+
+// one suspend cycle on the test clock: 'asleep' msecs, 'before' Wh
+// at suspend and 'after' Wh reported once resumed, -1 for none
+static void drainCycle(TestClock *clock,
+                       SuspendReport *report,
+                       qint64 asleep,
+                       double before,
+                       double after)
+{
+    clock->advance(60000);
+    report->suspending(before);
+    clock->suspend(asleep);
+    report->resuming();
+    report->resumedEnergy(before); // upower not updated yet
+    if (after>=0) { report->resumedEnergy(after); }
+}
+
+// the drain is weighted by time asleep: 1Wh over 1h and 0.6Wh over
+// 3h is 0.4Wh/h (not the 0.6 average of the two rates). short
+// cycles, cycles on AC and cycles without a fresh energy reading
+// are left out. the automatic wake alarm follows from that drain
+void SuspendBench::suspendDrain()
+{
+    TestClock clock(Q_INT64_C(1500000000000));
+    SuspendReport report(QString("%1/suspend/drain.conf").arg(root),
+                         QString("%1/missing").arg(root));
+    report.setClock(&clock);
+    QCOMPARE(report.drainRate(), -1.0);
+    QCOMPARE(report.minutesToReserve(30, 50, 15), -1);
+
+    drainCycle(&clock, &report, 3600000, 40, 39);
+    QCOMPARE(report.last().energyAfter, 39.0);
+    QVERIFY(qAbs(report.last().drain()-1.0)<0.001);
+    drainCycle(&clock, &report, 3*3600000, 38, 37.4);
+    drainCycle(&clock, &report, 600000, 37.4, 36.9);
+    QCOMPARE(report.last().drain(), -1.0);
+    drainCycle(&clock, &report, 3600000, -1, -1);
+    QCOMPARE(report.last().drain(), -1.0);
+
+    // upower never moves within the wait
+    drainCycle(&clock, &report, 3600000, 36, -1);
+    clock.advance(SUSPEND_ENERGY_WAIT+1);
+    report.resumedEnergy(30);
+    QCOMPARE(report.last().energyAfter, -1.0);
+    QCOMPARE(report.last().drain(), -1.0);
+
+    QVERIFY(qAbs(report.drainRate()-0.4)<0.001);
+    // 22.5Wh above the reserve at 0.4Wh/h with the margin
+    QCOMPARE(report.minutesToReserve(30, 50, 15),
+             (int)(22.5/(report.drainRate()*SUSPEND_DRAIN_MARGIN)*60.0));
+    QCOMPARE(report.minutesToReserve(7.5, 50, 15), SUSPEND_WAKEUP_MIN);
+    QCOMPARE(report.minutesToReserve(500, 500, 15), SUSPEND_WAKEUP_MAX);
+    QCOMPARE(report.minutesToReserve(30, 0, 15), -1);
+    QBENCHMARK { report.minutesToReserve(30, 50, 15); }
+}
+
+// the maintenance alarm goes to powerkitd on suspend, a resume in
+// its window is a maintenance wakeup. an early wake is a normal
+// resume and leaves the alarm queued, turning maintenance off must
+// still cancel it
+void SuspendBench::maintenanceWakeup()
+{
+    if (!upower || !pmd) { QSKIP("no private system bus", SkipAll); }
+    QDateTime window(QDate(2019, 7, 15), QTime(3, 0));
+    TestClock clock(window.addSecs(-5*3600).toMSecsSinceEpoch());
+    PowerKit pk;
+    pk.setClock(&clock);
+    pk.setLockScreenOnSuspend(false);
+    pk.setLockScreenOnResume(false);
+    pk.setMaintenanceTime("03:00");
+    QSignalSpy wakeups(&pk, SIGNAL(MaintenanceWakeup()));
+    QSignalSpy resumes(&pk, SIGNAL(PrepareForResume()));
+
+    // woken early by the user
+    QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, true));
+    QCOMPARE(pmd->alarm(PMD_ALARM_MAINTENANCE), window);
+    clock.suspend(3600000);
+    QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, false));
+    QCoreApplication::processEvents();
+    QCOMPARE(wakeups.count(), 0);
+    QCOMPARE(resumes.count(), 1);
+
+    // by the alarm, the next window is tomorrow
+    QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, true));
+    QCOMPARE(pmd->alarm(PMD_ALARM_MAINTENANCE), window);
+    BenchUtil::moveTestClock(&clock, window.addSecs(20).toMSecsSinceEpoch(), true);
+    QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, false));
+    QCoreApplication::processEvents();
+    QCOMPARE(wakeups.count(), 1);
+    QCOMPARE(resumes.count(), 1);
+    QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, true));
+    QCOMPARE(pmd->alarm(PMD_ALARM_MAINTENANCE), window.addDays(1));
+
+    // early again, then maintenance is turned off
+    clock.suspend(60000);
+    QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, false));
+    QCoreApplication::processEvents();
+    QCOMPARE(resumes.count(), 2);
+    pk.setMaintenanceTime(QString());
+    QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, true));
+    QCoreApplication::processEvents(); // async cancel
+    QVERIFY(!pmd->alarm(PMD_ALARM_MAINTENANCE).isValid());
+    QMetaObject::invokeMethod(&pk, "handlePrepareForSuspend", Q_ARG(bool, false));
+    QCoreApplication::processEvents();
+    QCOMPARE(wakeups.count(), 1);
+}
+
+static bool waitForJob(Maintenance *maintenance)
+{
+    QElapsedTimer timer;
+    timer.start();
+    while (maintenance->isRunning() && timer.elapsed()<BENCH_JOB_WAIT) { QTest::qWait(10); }
+    return !maintenance->isRunning();
+}
+
+// the job runs under an inhibit and suspends again when done, killed
+// at the deadline or skipped on a low battery (the fake is at 55%).
+// input after a quiet period keeps the machine awake
+void SuspendBench::maintenanceJob()
+{
+    if (!upower || !logind) { QSKIP("no private system bus", SkipAll); }
+    PowerKit pk;
+    pk.setLockScreenOnSuspend(false);
+    PowerManagement pm;
+    Maintenance maintenance(&pk, &pm);
+    QSignalSpy active(&maintenance, SIGNAL(userActive()));
+    int suspends = logind->suspends();
+
+    maintenance.setCommand("sleep 0.2");
+    maintenance.run();
+    QVERIFY(maintenance.isRunning());
+    QVERIFY(pm.HasInhibit());
+    QVERIFY(waitForJob(&maintenance));
+    QVERIFY(!pm.HasInhibit());
+    QCOMPARE(logind->suspends(), suspends+1);
+
+    maintenance.setCommand("sleep 30");
+    maintenance.run();
+    QVERIFY(maintenance.isRunning());
+    QMetaObject::invokeMethod(&maintenance, "handleDeadline");
+    QVERIFY(!maintenance.isRunning());
+    QVERIFY(!pm.HasInhibit());
+    QCOMPARE(logind->suspends(), suspends+2);
+
+    maintenance.setMinBattery(60);
+    maintenance.run();
+    QVERIFY(!maintenance.isRunning());
+    QCOMPARE(logind->suspends(), suspends+3);
+    maintenance.setMinBattery(50);
+
+    // the key press that woke the machine is not the user
+    maintenance.setCommand("sleep 0.2");
+    maintenance.run();
+    QMetaObject::invokeMethod(&maintenance, "handleActivity");
+    QCOMPARE(active.count(), 0);
+    QMetaObject::invokeMethod(&maintenance, "handleIdle");
+    QMetaObject::invokeMethod(&maintenance, "handleActivity");
+    QCOMPARE(active.count(), 1);
+    QVERIFY(maintenance.isRunning()); // the job is not stopped
+    QVERIFY(waitForJob(&maintenance));
+    QCOMPARE(logind->suspends(), suspends+3);
+}
+
+// no rtc device, the alarm goes to a fake sysfs node and is read back
+void SuspendBench::rtcSysfsAlarm()
+{
+    QString sysfs = BenchUtil::fakeRtc(root, "rtc0");
+    QVERIFY(!sysfs.isEmpty());
+    RTC rtc(QString("%1/rtc/missing").arg(root), sysfs);
+
+    // a full date, months and years ahead
+    QDateTime date = QDateTime::currentDateTime().addYears(1).addMonths(2);
+    date.setTime(QTime(date.time().hour(), date.time().minute(), date.time().second()));
+    QVERIFY(rtc.setAlarm(date));
+    QCOMPARE(rtc.method(), (int)RTC::MethodSysfs);
+    bool enabled = false;
+    QCOMPARE(rtc.alarm(&enabled), date);
+    QVERIFY(enabled);
+
+    QVERIFY(!rtc.setAlarm(QDateTime::currentDateTime().addSecs(-60)));
+    QVERIFY(rtc.clearAlarm());
+    QVERIFY(!rtc.alarm(&enabled).isValid());
+    QVERIFY(!enabled);
+
+    QBENCHMARK { rtc.setAlarm(date); }
+}
+
+// alarms added out of order come out earliest first,
+// a replaced alarm moves to its new place
+void SuspendBench::alarmQueueOrder()
+{
+    QString sysfs = BenchUtil::fakeRtc(root, "queue0");
+    QVERIFY(!sysfs.isEmpty());
+    RTC rtc(QString("%1/rtc/missing").arg(root), sysfs);
+    AlarmQueue queue(&rtc);
+
+    QDateTime now = QDateTime::fromTime_t(QDateTime::currentDateTime().toTime_t());
+    QMap<uint, QString> expected;
+    for (int i=0;i<20;++i) {
+        QDateTime date = now.addSecs(3600+(i*7919)%20000);
+        QString name = QString("alarm%1").arg(i);
+        QVERIFY(queue.add(name, date));
+        expected[date.toTime_t()] = name;
+    }
+    QDateTime moved = now.addSecs(1800);
+    QVERIFY(queue.add("alarm7", moved));
+    expected.remove(expected.key("alarm7"));
+    expected[moved.toTime_t()] = "alarm7";
+    QCOMPARE(queue.size(), expected.size());
+    QVERIFY(!queue.add("past", now.addSecs(-60)));
+
+    QMapIterator<uint, QString> i(expected);
+    while (i.hasNext()) {
+        i.next();
+        QCOMPARE(queue.next(), i.value());
+        QCOMPARE(rtc.alarm().toTime_t(), i.key());
+        QVERIFY(queue.cancel(i.value()));
+    }
+    QCOMPARE(queue.size(), 0);
+    QVERIFY(queue.next().isEmpty());
+
+    QBENCHMARK {
+        queue.add("bench", now.addSecs(7200));
+        queue.cancel("bench");
+    }
+}
+
+// cancelling the programmed alarm moves the RTC to the next one,
+// cancelling another leaves the RTC alone, the last one clears it
+void SuspendBench::alarmQueueCancel()
+{
+    QString sysfs = BenchUtil::fakeRtc(root, "queue1");
+    QVERIFY(!sysfs.isEmpty());
+    QString wakealarm = QString("%1/%2").arg(sysfs).arg(RTC_WAKEALARM);
+    RTC rtc(QString("%1/rtc/missing").arg(root), sysfs);
+    AlarmQueue queue(&rtc);
+
+    QDateTime now = QDateTime::fromTime_t(QDateTime::currentDateTime().toTime_t());
+    QVERIFY(queue.add("maintenance", now.addSecs(7200)));
+    QVERIFY(queue.add("hibernate", now.addSecs(3600)));
+    QVERIFY(queue.add("user", now.addSecs(10800)));
+    QCOMPARE(queue.next(), QString("hibernate"));
+    bool enabled = false;
+    QCOMPARE(rtc.alarm(&enabled), now.addSecs(3600));
+    QVERIFY(enabled);
+
+    QVERIFY(queue.cancel("hibernate"));
+    QCOMPARE(queue.next(), QString("maintenance"));
+    QCOMPARE(rtc.alarm(), now.addSecs(7200));
+
+    // not the programmed alarm, the RTC is not written
+    QVERIFY(BenchUtil::writeFile(wakealarm, QString::number(now.addSecs(7200).toTime_t())));
+    QFileInfo before(wakealarm);
+    QDateTime modified = before.lastModified();
+    QTest::qWait(1100);
+    QVERIFY(queue.cancel("user"));
+    QVERIFY(!queue.cancel("user"));
+    QCOMPARE(QFileInfo(wakealarm).lastModified(), modified);
+    QCOMPARE(rtc.alarm(), now.addSecs(7200));
+
+    QVERIFY(queue.cancel("maintenance"));
+    QVERIFY(queue.next().isEmpty());
+    QVERIFY(!rtc.alarm(&enabled).isValid());
+    QVERIFY(!enabled);
+}
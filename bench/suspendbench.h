@@ -0,0 +1,52 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SUSPENDBENCH_H
+#define SUSPENDBENCH_H
+
+#include <QObject>
+#include <QString>
+
+#include "fakeupower.h"
+#include "fakelogind.h"
+#include "fakepowerkitd.h"
+
+// suspend and resume handling, the delay lock, maintenance wakeups,
+// the RTC and the powerkitd alarm queue. D-Bus cases need the fakes from main(),
+// they are skipped otherwise.
+class SuspendBench : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit SuspendBench(const QString &root,
+                          FakeUPower *upower,
+                          FakeLogind *logind,
+                          FakePowerKitd *pmd,
+                          QObject *parent = NULL);
+
+private:
+    QString root;
+    FakeUPower *upower; // NULL without a private system bus
+    FakeLogind *logind;
+    FakePowerKitd *pmd;
+
+private slots:
+    void resumePath_data();
+    void resumePath();
+    void suspendLockCycles();
+    void suspendReportTiming();
+    void suspendDrain();
+    void maintenanceWakeup();
+    void maintenanceJob();
+    void rtcSysfsAlarm();
+    void alarmQueueOrder();
+    void alarmQueueCancel();
+};
+
+#endif // SUSPENDBENCH_H
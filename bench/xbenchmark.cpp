@@ -0,0 +1,243 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "xbenchmark.h"
+#include "screensaver.h"
+#include "xstats.h"
+
+#include <QtTest/QtTest>
+
+// Xlib macros clash with Qt, keep last
+#include "idle.h"
+#include "screens.h"
+#include <X11/extensions/XTest.h>
+#include "hotplug.h" // undefines Bool
+
+XBenchmark::XBenchmark(QObject *parent)
+    : QObject(parent)
+    , dpy(NULL)
+    , hasXTest(false)
+    , originalMode(0)
+    , benchMode(0)
+    , statusCount(0)
+    , statusLatency(0)
+{
+}
+
+void XBenchmark::initTestCase()
+{
+    dpy = XOpenDisplay(NULL);
+    if (dpy == NULL) { QSKIP("no X11 display (run on Xvfb)", SkipAll); }
+    int event, error, major, minor;
+    hasXTest = XTestQueryExtension(dpy, &event, &error, &major, &minor);
+
+    // a second mode on the first output to switch between
+    Window root = DefaultRootWindow(dpy);
+    XRRScreenResources *sr = XRRGetScreenResources(dpy, root);
+    if (sr == NULL || sr->noutput<1) {
+        if (sr) { XRRFreeScreenResources(sr); }
+        return;
+    }
+    XRROutputInfo *info = XRRGetOutputInfo(dpy, sr, sr->outputs[0]);
+    if (info && info->crtc) {
+        XRRCrtcInfo *crtc = XRRGetCrtcInfo(dpy, sr, info->crtc);
+        if (crtc) {
+            originalMode = crtc->mode;
+            XRRFreeCrtcInfo(crtc);
+            QByteArray name("pkbench");
+            XRRModeInfo *mode = XRRAllocModeInfo(name.data(), name.size());
+            mode->width = 640;
+            mode->height = 480;
+            mode->dotClock = 25175000;
+            mode->hSyncStart = 656;
+            mode->hSyncEnd = 752;
+            mode->hTotal = 800;
+            mode->vSyncStart = 490;
+            mode->vSyncEnd = 492;
+            mode->vTotal = 525;
+            benchMode = XRRCreateMode(dpy, root, mode);
+            XRRFreeModeInfo(mode);
+            if (benchMode) { XRRAddOutputMode(dpy, sr->outputs[0], benchMode); }
+        }
+    }
+    if (info) { XRRFreeOutputInfo(info); }
+    XRRFreeScreenResources(sr);
+    XSync(dpy, False);
+}
+
+void XBenchmark::cleanupTestCase()
+{
+    if (dpy == NULL) { return; }
+    if (benchMode) {
+        XRRScreenResources *sr = XRRGetScreenResources(dpy, DefaultRootWindow(dpy));
+        if (sr) {
+            XRROutputInfo *info = XRRGetOutputInfo(dpy, sr, sr->outputs[0]);
+            if (info && info->crtc) {
+                XRRCrtcInfo *crtc = XRRGetCrtcInfo(dpy, sr, info->crtc);
+                if (crtc && crtc->mode == benchMode) { switchMode(); }
+                if (crtc) { XRRFreeCrtcInfo(crtc); }
+            }
+            if (info) { XRRFreeOutputInfo(info); }
+            XRRDeleteOutputMode(dpy, sr->outputs[0], benchMode);
+            XRRFreeScreenResources(sr);
+        }
+        XRRDestroyMode(dpy, benchMode);
+    }
+    XCloseDisplay(dpy);
+    dpy = NULL;
+}
+
+bool XBenchmark::switchMode()
+{
+    bool result = false;
+    XRRScreenResources *sr = XRRGetScreenResources(dpy, DefaultRootWindow(dpy));
+    if (sr == NULL) { return result; }
+    RROutput output = sr->outputs[0];
+    XRROutputInfo *info = XRRGetOutputInfo(dpy, sr, output);
+    if (info && info->crtc) {
+        XRRCrtcInfo *crtc = XRRGetCrtcInfo(dpy, sr, info->crtc);
+        if (crtc) {
+            RRMode mode = crtc->mode == benchMode?originalMode:benchMode;
+            result = XRRSetCrtcConfig(dpy, sr, info->crtc, CurrentTime,
+                                      crtc->x, crtc->y, mode, crtc->rotation,
+                                      &output, 1) == RRSetConfigSuccess;
+            XRRFreeCrtcInfo(crtc);
+        }
+    }
+    if (info) { XRRFreeOutputInfo(info); }
+    XRRFreeScreenResources(sr);
+    XSync(dpy, False);
+    return result;
+}
+
+// XStats counts of one call
+qlonglong XBenchmark::runOperation(const QString &operation,
+                                   const QString &counter)
+{
+    XStats::reset();
+    if (operation == "outputs") { Screens::outputsDpy(dpy); }
+    else if (operation == "internal") { Screens::internalDpy(dpy); }
+    else if (operation == "idle") { Idle::msecsDpy(dpy); }
+    QVariantMap stats = XStats::stats().value(operation).toMap();
+    return stats.value(counter).toLongLong();
+}
+
+void XBenchmark::hotplugStatus(const QString &display, bool connected)
+{
+    Q_UNUSED(display)
+    Q_UNUSED(connected)
+    if (statusCount++ == 0) { statusLatency = (double)signalTimer.nsecsElapsed()/1000000.0; }
+}
+
+void XBenchmark::outputs()
+{
+    QBENCHMARK { Screens::outputsDpy(dpy); }
+}
+
+void XBenchmark::internal()
+{
+    QBENCHMARK { Screens::internalDpy(dpy); }
+}
+
+void XBenchmark::idle()
+{
+    QVERIFY(Idle::msecsDpy(dpy)>=0);
+    QBENCHMARK { Idle::msecsDpy(dpy); }
+}
+
+void XBenchmark::requests_data()
+{
+    QTest::addColumn<QString>("operation");
+    QTest::newRow("outputs") << QString("outputs");
+    QTest::newRow("internal") << QString("internal");
+    QTest::newRow("idle") << QString("idle");
+}
+
+// X requests per operation
+void XBenchmark::requests()
+{
+    QFETCH(QString, operation);
+    QTest::setBenchmarkResult(runOperation(operation, "requests"), QTest::Events);
+}
+
+void XBenchmark::roundTrips_data()
+{
+    requests_data();
+}
+
+// X round trips per operation
+void XBenchmark::roundTrips()
+{
+    QFETCH(QString, operation);
+    QTest::setBenchmarkResult(runOperation(operation, "round_trips"), QTest::Events);
+}
+
+// mode switch to the status() signal in this thread, average ms
+void XBenchmark::hotplugLatency()
+{
+    if (!benchMode) { QSKIP("no RandR mode to switch to", SkipSingle); }
+    HotPlug hotplug;
+    connect(&hotplug, SIGNAL(status(QString,bool)),
+            this, SLOT(hotplugStatus(QString,bool)));
+    hotplug.requestScan();
+    QTest::qWait(XBENCH_HOTPLUG_START);
+
+    double total = 0;
+    for (int i=0;i<XBENCH_HOTPLUG_RUNS;++i) {
+        statusCount = 0;
+        signalTimer.start();
+        QVERIFY(switchMode());
+        while (statusCount == 0 && signalTimer.elapsed()<XBENCH_TIMEOUT) { QTest::qWait(1); }
+        QVERIFY(statusCount>0);
+        total += statusLatency;
+        QTest::qWait(50); // let the rest of the notifications arrive
+    }
+    hotplug.requestSetScan(false);
+    QTest::setBenchmarkResult(total/XBENCH_HOTPLUG_RUNS, QTest::WalltimeMilliseconds);
+}
+
+// stop request to the scan thread gone, ms. the thread blocks
+// without a timeout, only the wake pipe ends the wait
+void XBenchmark::hotplugStop()
+{
+    double total = 0;
+    for (int i=0;i<XBENCH_HOTPLUG_RUNS;++i) {
+        HotPlug *hotplug = new HotPlug();
+        hotplug->requestScan();
+        QTest::qWait(XBENCH_HOTPLUG_START/5);
+        QElapsedTimer timer;
+        timer.start();
+        delete hotplug;
+        total += (double)timer.nsecsElapsed()/1000000.0;
+    }
+    QVERIFY(total/XBENCH_HOTPLUG_RUNS<XBENCH_TIMEOUT);
+    QTest::setBenchmarkResult(total/XBENCH_HOTPLUG_RUNS, QTest::WalltimeMilliseconds);
+}
+
+// difference between the reported idle time and the time since
+// the last (synthetic) input, ms
+void XBenchmark::idleAccuracy()
+{
+    if (!hasXTest) { QSKIP("no XTEST extension", SkipSingle); }
+    XTestFakeRelativeMotionEvent(dpy, 1, 1, CurrentTime);
+    XSync(dpy, False);
+    QElapsedTimer timer;
+    timer.start();
+    QTest::qSleep(XBENCH_IDLE_WAIT);
+    qint64 idle = Idle::msecsDpy(dpy);
+    qint64 elapsed = timer.elapsed();
+    QVERIFY(idle>=0);
+    QTest::setBenchmarkResult(qAbs(idle-elapsed), QTest::WalltimeMilliseconds);
+}
+
+// xscreensaver-command, as run on every inhibit
+void XBenchmark::screensaverActivity()
+{
+    ScreenSaver ss;
+    QBENCHMARK { ss.SimulateUserActivity(); }
+}
@@ -0,0 +1,65 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef XBENCHMARK_H
+#define XBENCHMARK_H
+
+#include <QObject>
+#include <QString>
+#include <QElapsedTimer>
+
+typedef struct _XDisplay Display;
+
+#define XBENCH_HOTPLUG_RUNS 10
+#define XBENCH_IDLE_WAIT 2000 // ms without input before reading idle
+#define XBENCH_TIMEOUT 5000 // ms to wait for a hotplug signal
+#define XBENCH_HOTPLUG_START 500 // ms for the scan thread to select input
+
+// X11 idle, RandR and screensaver paths, run on Xvfb (see xvfb-bench.sh).
+// Xvfb can't plug outputs, a hotplug is a mode switch on the first
+// output, that sends the same RROutputChangeNotify.
+class XBenchmark : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit XBenchmark(QObject *parent = NULL);
+
+private:
+    Display *dpy;
+    bool hasXTest;
+    unsigned long originalMode;
+    unsigned long benchMode;
+    QElapsedTimer signalTimer;
+    int statusCount;
+    double statusLatency; // ms
+
+    bool switchMode();
+    qlonglong runOperation(const QString &operation,
+                           const QString &counter);
+
+public slots:
+    void hotplugStatus(const QString &display, bool connected);
+
+private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void outputs();
+    void internal();
+    void idle();
+    void requests_data();
+    void requests();
+    void roundTrips_data();
+    void roundTrips();
+    void hotplugLatency();
+    void hotplugStop();
+    void idleAccuracy();
+    void screensaverActivity();
+};
+
+#endif // XBENCHMARK_H
@@ -0,0 +1,38 @@
+#!/bin/sh
+#
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+#
+# Run the benchmarks on a private Xvfb (RANDR, MIT-SCREEN-SAVER,
+# SYNC, XTEST) and a private D-Bus used as the system bus.
+#
+#   xvfb-bench.sh ./powerkit-bench [--json file] [QtTest options]
+#
+
+DISPLAY_NUM=${DISPLAY_NUM:-97}
+if [ $# -lt 1 ]; then
+    echo "usage: $0 powerkit-bench [options]" >&2
+    exit 1
+fi
+
+Xvfb :$DISPLAY_NUM -screen 0 1280x800x24 -nolisten tcp \
+    +extension RANDR +extension MIT-SCREEN-SAVER \
+    +extension SYNC +extension XTEST >/dev/null 2>&1 &
+XVFB=$!
+trap 'kill $XVFB 2>/dev/null' EXIT INT TERM
+
+i=0
+while [ ! -S /tmp/.X11-unix/X$DISPLAY_NUM ]; do
+    i=$((i+1))
+    if [ $i -gt 50 ] || ! kill -0 $XVFB 2>/dev/null; then
+        echo "Xvfb did not start on :$DISPLAY_NUM" >&2
+        exit 1
+    fi
+    sleep 0.1
+done
+
+DISPLAY=:$DISPLAY_NUM dbus-run-session -- sh -c \
+    'DBUS_SYSTEM_BUS_ADDRESS=$DBUS_SESSION_BUS_ADDRESS exec "$@"' sh "$@"
@@ -0,0 +1,140 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "alarmqueue.h"
+#include "clock.h"
+
+#include <QDebug>
+#include <algorithm>
+
+#define ALARM_FORMAT "yyyy-MM-dd HH:mm:ss"
+
+// std heaps are max-heaps, later is "less"
+static bool alarmLater(const WakeAlarm &a, const WakeAlarm &b)
+{
+    return a.time>b.time;
+}
+
+AlarmQueue::AlarmQueue(RTC *rtc, QObject *parent)
+    : QObject(parent)
+    , rtc(rtc)
+    , programmedTime(0)
+{
+    timer.setSingleShot(true);
+    connect(&timer, SIGNAL(timeout()),
+            this, SLOT(expire()));
+}
+
+// replaces an alarm with the same name
+bool AlarmQueue::add(const QString &name, const QDateTime &date)
+{
+    if (name.isEmpty() || !date.isValid()) { return false; }
+    if (date<=Clock::system()->currentDateTime()) { return false; }
+    int index = find(name);
+    if (index<0 && heap.size()>=ALARM_MAX) { return false; }
+    WakeAlarm alarm;
+    alarm.name = name;
+    alarm.time = date.toTime_t();
+    if (index<0) {
+        heap.append(alarm);
+        std::push_heap(heap.begin(), heap.end(), alarmLater);
+    } else {
+        heap[index] = alarm;
+        std::make_heap(heap.begin(), heap.end(), alarmLater);
+    }
+    reprogram();
+    return programmed == name?programmedTime == alarm.time:true;
+}
+
+bool AlarmQueue::cancel(const QString &name)
+{
+    int index = find(name);
+    if (index<0) { return false; }
+    heap.remove(index);
+    std::make_heap(heap.begin(), heap.end(), alarmLater);
+    reprogram();
+    return true;
+}
+
+void AlarmQueue::clear()
+{
+    heap.clear();
+    reprogram();
+}
+
+QVariantMap AlarmQueue::list()
+{
+    QVariantMap result;
+    for (int i=0;i<heap.size();++i) {
+        result[heap.at(i).name] = QDateTime::fromTime_t(heap.at(i).time)
+                                  .toString(ALARM_FORMAT);
+    }
+    return result;
+}
+
+QString AlarmQueue::next()
+{
+    return programmed;
+}
+
+int AlarmQueue::size()
+{
+    return heap.size();
+}
+
+int AlarmQueue::find(const QString &name)
+{
+    for (int i=0;i<heap.size();++i) {
+        if (heap.at(i).name == name) { return i; }
+    }
+    return -1;
+}
+
+// program the earliest alarm, only touch the RTC if it changed
+void AlarmQueue::reprogram()
+{
+    timer.stop();
+    if (heap.isEmpty()) {
+        if (!programmed.isEmpty()) { rtc->clearAlarm(); }
+        programmed.clear();
+        programmedTime = 0;
+        return;
+    }
+    const WakeAlarm &first = heap.first();
+    if (first.time != programmedTime) {
+        if (rtc->setAlarm(QDateTime::fromTime_t(first.time))) {
+            programmedTime = first.time;
+        } else {
+            qWarning() << "failed to program wake alarm" << first.name;
+            programmedTime = 0;
+        }
+    }
+    programmed = first.name;
+    qint64 msecs = ((qint64)first.time-Clock::system()->currentTime_t())*1000;
+    timer.start((int)qBound((qint64)0, msecs, (qint64)ALARM_CHECK));
+}
+
+// drop the alarms that have passed
+void AlarmQueue::expire()
+{
+    uint now = Clock::system()->currentTime_t();
+    bool changed = false;
+    while (!heap.isEmpty() && heap.first().time<=now) {
+        std::pop_heap(heap.begin(), heap.end(), alarmLater);
+        QString name = heap.last().name;
+        heap.removeLast();
+        changed = true;
+        qDebug() << "wake alarm passed" << name;
+        emit fired(name);
+    }
+    if (changed) {
+        programmedTime = 0; // the RTC alarm is spent
+        programmed.clear();
+    }
+    reprogram();
+}
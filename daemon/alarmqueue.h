@@ -0,0 +1,64 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef ALARMQUEUE_H
+#define ALARMQUEUE_H
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QTimer>
+#include <QVariantMap>
+
+#include "rtc.h"
+
+#define ALARM_CHECK 60000 // max ms between checks, timers stop in suspend
+#define ALARM_MAX 64
+
+struct WakeAlarm
+{
+    QString name;
+    uint time; // seconds since epoch
+};
+
+// Named wake alarms, the earliest is programmed into the RTC.
+//
+// A min-heap on time; adding, cancelling or an alarm passing
+// (it fired, or we were awake anyway) reprograms the RTC.
+class AlarmQueue : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit AlarmQueue(RTC *rtc, QObject *parent = NULL);
+
+    bool add(const QString &name, const QDateTime &date);
+    bool cancel(const QString &name);
+    void clear();
+    QVariantMap list(); // name -> yyyy-MM-dd HH:mm:ss
+    QString next(); // name of the programmed alarm
+    int size();
+
+signals:
+    void fired(const QString &name);
+
+private:
+    RTC *rtc;
+    QVector<WakeAlarm> heap;
+    QTimer timer;
+    QString programmed;
+    uint programmedTime;
+
+    int find(const QString &name);
+    void reprogram();
+
+private slots:
+    void expire();
+};
+
+#endif // ALARMQUEUE_H
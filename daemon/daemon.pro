@@ -12,8 +12,8 @@ QT -= gui
 CONFIG += console
 CONFIG -= app_bundle
 TEMPLATE = app
-SOURCES += main.cpp manager.cpp
-HEADERS += manager.h
+SOURCES += main.cpp manager.cpp alarmqueue.cpp
+HEADERS += manager.h alarmqueue.h
 OTHER_FILES += $${TARGET}.conf.in
 
 LIBS += -L../lib -lPowerKit
@@ -7,21 +7,69 @@
 */
 
 #include "manager.h"
-#include "rtc.h"
 #include "common.h"
 
 #include <QDebug>
 
 Manager::Manager(QObject *parent) : QObject(parent)
+  , alarms(&rtc)
 {
 }
 
+// leave the devices as we found them
+Manager::~Manager()
+{
+    runtime.restore();
+}
+
 bool Manager::setWakeAlarm(const QString &alarm)
 {
-    qDebug() << "Try to set RTC wake alarm" << alarm;
+    return addWakeAlarm(ALARM_DEFAULT, alarm);
+}
+
+bool Manager::clearWakeAlarm()
+{
+    qDebug() << "Try to clear RTC wake alarms";
+    alarms.clear();
+    return true;
+}
+
+// enabled, alarm (yyyy-MM-dd HH:mm:ss, local), the method used,
+// the queued alarm in the RTC and the number of queued alarms
+QVariantMap Manager::wakeAlarmState()
+{
+    QVariantMap result;
+    bool enabled = false;
+    QDateTime date = rtc.alarm(&enabled);
+    result["enabled"] = enabled;
+    result["alarm"] = enabled?date.toString("yyyy-MM-dd HH:mm:ss"):QString();
+    result["method"] = RTC::methodName(rtc.method());
+    result["next"] = alarms.next();
+    result["alarms"] = alarms.size();
+    return result;
+}
+
+// add or move a named alarm
+bool Manager::addWakeAlarm(const QString &name, const QString &alarm)
+{
+    qDebug() << "Try to add RTC wake alarm" << name << alarm;
     QDateTime date = QDateTime::fromString(alarm, "yyyy-MM-dd HH:mm:ss");
     if (date.isNull() || !date.isValid()) { return false; }
-    return RTC::setAlarm(date);
+    bool result = alarms.add(name, date);
+    qDebug() << "RTC wake alarm set?" << result << RTC::methodName(rtc.method());
+    return result;
+}
+
+bool Manager::cancelWakeAlarm(const QString &name)
+{
+    qDebug() << "Try to cancel RTC wake alarm" << name;
+    return alarms.cancel(name);
+}
+
+// name -> yyyy-MM-dd HH:mm:ss
+QVariantMap Manager::listWakeAlarms()
+{
+    return alarms.list();
 }
 
 bool Manager::setDisplayBacklight(const QString &device, int value)
@@ -34,3 +82,36 @@ bool Manager::setDisplayBacklight(const QString &device, int value)
     return Common::adjustBacklight(device, light);
 }
 
+// every key in one call, rolled back if a write fails
+bool Manager::setCpuProfile(const QVariantMap &profile)
+{
+    qDebug() << "Try to set CPU profile" << profile;
+    bool result = cpu.apply(profile);
+    if (!result) { qWarning() << "CPU profile not set:" << cpu.error(); }
+    return result;
+}
+
+QVariantMap Manager::cpuProfileState()
+{
+    return cpu.state();
+}
+
+// enable on battery, disable restores the values from before
+bool Manager::setRuntimePM(bool enabled,
+                           const QStringList &allow,
+                           const QStringList &deny,
+                           int delay)
+{
+    qDebug() << "Try to set runtime PM" << enabled << allow << deny << delay;
+    bool result = enabled?runtime.enable(allow, deny, delay):runtime.restore();
+    if (!result) { qWarning() << "Runtime PM not set:" << runtime.error(); }
+    else if (enabled) { qDebug() << "Runtime PM enabled for" << runtime.managed(); }
+    return result;
+}
+
+// enabled, managed devices and the devices runtime suspended now
+QVariantMap Manager::runtimePMState()
+{
+    return runtime.state();
+}
+
@@ -11,6 +11,14 @@
 
 #include <QObject>
 #include <QString>
+#include <QVariantMap>
+
+#include "rtc.h"
+#include "cpuprofile.h"
+#include "runtimepm.h"
+#include "alarmqueue.h"
+
+#define ALARM_DEFAULT "default" // setWakeAlarm()
 
 class Manager : public QObject
 {
@@ -18,10 +26,29 @@ class Manager : public QObject
 
 public:
     explicit Manager(QObject *parent = NULL);
+    ~Manager();
+
+private:
+    RTC rtc;
+    AlarmQueue alarms;
+    CpuProfile cpu;
+    RuntimePM runtime;
 
 public slots:
     bool setWakeAlarm(const QString &alarm);
+    bool clearWakeAlarm();
+    QVariantMap wakeAlarmState();
+    bool addWakeAlarm(const QString &name, const QString &alarm);
+    bool cancelWakeAlarm(const QString &name);
+    QVariantMap listWakeAlarms();
     bool setDisplayBacklight(const QString &device, int value);
+    bool setCpuProfile(const QVariantMap &profile);
+    QVariantMap cpuProfileState();
+    bool setRuntimePM(bool enabled,
+                      const QStringList &allow,
+                      const QStringList &deny,
+                      int delay);
+    QVariantMap runtimePMState();
 };
 
 #endif // MANAGER_H
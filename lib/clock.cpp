@@ -0,0 +1,108 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "clock.h"
+
+#include <QElapsedTimer>
+
+#ifdef Q_OS_LINUX
+#include <time.h>
+#endif
+
+QDateTime Clock::currentDateTime()
+{
+    return QDateTime::fromMSecsSinceEpoch(wallMsecs());
+}
+
+uint Clock::currentTime_t()
+{
+    return (uint)(wallMsecs()/1000);
+}
+
+Clock *Clock::system()
+{
+    static SystemClock clock;
+    return &clock;
+}
+
+#ifdef Q_OS_LINUX
+static qint64 clockMsecs(clockid_t id)
+{
+    struct timespec ts;
+    if (clock_gettime(id, &ts) != 0) { return -1; }
+    return (qint64)ts.tv_sec*1000+ts.tv_nsec/1000000;
+}
+#endif
+
+qint64 SystemClock::monotonicMsecs()
+{
+#ifdef Q_OS_LINUX
+    qint64 result = clockMsecs(CLOCK_MONOTONIC);
+    if (result>=0) { return result; }
+#endif
+    QElapsedTimer elapsed;
+    elapsed.start();
+    return elapsed.msecsSinceReference();
+}
+
+qint64 SystemClock::boottimeMsecs()
+{
+#if defined(Q_OS_LINUX) && defined(CLOCK_BOOTTIME)
+    qint64 result = clockMsecs(CLOCK_BOOTTIME);
+    if (result>=0) { return result; }
+#endif
+    return monotonicMsecs();
+}
+
+qint64 SystemClock::wallMsecs()
+{
+    return QDateTime::currentMSecsSinceEpoch();
+}
+
+TestClock::TestClock(qint64 wall)
+    : monotonic(0)
+    , boottime(0)
+    , wall(wall)
+{
+}
+
+qint64 TestClock::monotonicMsecs()
+{
+    return monotonic;
+}
+
+qint64 TestClock::boottimeMsecs()
+{
+    return boottime;
+}
+
+qint64 TestClock::wallMsecs()
+{
+    return wall;
+}
+
+void TestClock::advance(qint64 msecs)
+{
+    if (msecs<0) { return; }
+    monotonic += msecs;
+    boottime += msecs;
+    wall += msecs;
+}
+
+void TestClock::suspend(qint64 msecs)
+{
+    if (msecs<0) { return; }
+    boottime += msecs;
+    wall += msecs;
+}
+
+// wall clock jumps (ntp, user), the other clocks are not affected
+void TestClock::setWallMsecs(qint64 msecs)
+{
+    wall = msecs;
+}
@@ -0,0 +1,66 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef CLOCK_H
+#define CLOCK_H
+
+#include <QtGlobal>
+#include <QDateTime>
+
+// Time source for the time based logic (inhibit expiry, idle timeouts,
+// wake alarm window, battery estimates). Components take a Clock
+// pointer and default to Clock::system(), benchmarks and replays pass
+// a TestClock to run faster than real time.
+//
+// monotonic: stops during suspend, for timeouts.
+// boottime: includes suspend, for measuring sleep.
+// wall: the calendar time, may jump.
+class Clock
+{
+public:
+    virtual ~Clock() {}
+    virtual qint64 monotonicMsecs() = 0;
+    virtual qint64 boottimeMsecs() = 0;
+    virtual qint64 wallMsecs() = 0;
+
+    QDateTime currentDateTime();
+    uint currentTime_t();
+
+    static Clock *system();
+};
+
+class SystemClock : public Clock
+{
+public:
+    qint64 monotonicMsecs();
+    qint64 boottimeMsecs();
+    qint64 wallMsecs();
+};
+
+// Manually driven clock, starts at 'wall' (msecs since epoch).
+// advance() moves all clocks, suspend() skips the monotonic clock
+// like a real suspend does.
+class TestClock : public Clock
+{
+public:
+    explicit TestClock(qint64 wall = 0);
+    qint64 monotonicMsecs();
+    qint64 boottimeMsecs();
+    qint64 wallMsecs();
+
+    void advance(qint64 msecs);
+    void suspend(qint64 msecs);
+    void setWallMsecs(qint64 msecs);
+
+private:
+    qint64 monotonic;
+    qint64 boottime;
+    qint64 wall;
+};
+
+#endif // CLOCK_H
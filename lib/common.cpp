@@ -18,6 +18,7 @@
 #include <QTextStream>
 
 #include "def.h"
+#include "log.h"
 
 #define PK "powerkit"
 
@@ -102,7 +103,7 @@ void Common::saveDefaultSettings()
         !iconsPath.contains(iconsHome)) { iconsPath.prepend(iconsHome); }
     iconsPath << QString("%1/../share/icons").arg(qApp->applicationDirPath());
     QIcon::setThemeSearchPaths(iconsPath);
-    qDebug() << "using icon theme search path" << QIcon::themeSearchPaths();
+    qCDebug(PK_TRAY) << "using icon theme search path" << QIcon::themeSearchPaths();
 
     QString theme = QIcon::themeName();
     if (theme.isEmpty() || theme == "hicolor") { // try to load saved theme
@@ -121,13 +122,13 @@ void Common::saveDefaultSettings()
         if(theme.isNull()) { theme = DEFAULT_THEME; }
         if (!theme.isEmpty()) { savePowerSettings(CONF_ICON_THEME, theme); }
     }
-    qDebug() << "Using icon theme" << theme;
+    qCDebug(PK_TRAY) << "Using icon theme" << theme;
     QIcon::setThemeName(theme);
 #ifdef BUNDLE_ICONS
     if (theme != DEFAULT_THEME) { // validate theme
         QIcon testTheme = QIcon::fromTheme(DEFAULT_AC_ICON);
         if (testTheme.isNull()) {
-            qDebug() << "icon theme is broken, use failsafe!";
+            qCDebug(PK_TRAY) << "icon theme is broken, use failsafe!";
             QIcon::setThemeName(DEFAULT_THEME);
             savePowerSettings(CONF_ICON_THEME, DEFAULT_THEME);
         }
@@ -0,0 +1,181 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "cpuprofile.h"
+#include "sysfstransaction.h"
+
+#include <QDir>
+#include <QFile>
+
+CpuProfile::CpuProfile(const QString &root)
+    : root(root)
+{
+}
+
+QStringList CpuProfile::profiles()
+{
+    return QStringList() << CPU_PROFILE_PERFORMANCE
+                         << CPU_PROFILE_BALANCED
+                         << CPU_PROFILE_POWERSAVE;
+}
+
+// acpi-cpufreq has no EPP and its powersave governor pins the
+// lowest frequency, schedutil is preferred where it exists
+QVariantMap CpuProfile::profile(const QString &name)
+{
+    QVariantMap result;
+    if (name == CPU_PROFILE_PERFORMANCE) {
+        result[CPU_GOVERNOR] = "performance";
+        result[CPU_EPP] = "performance";
+        result[CPU_PLATFORM] = "performance";
+        result[CPU_BOOST] = true;
+    } else if (name == CPU_PROFILE_BALANCED) {
+        result[CPU_GOVERNOR] = "schedutil,powersave";
+        result[CPU_EPP] = "balance_performance";
+        result[CPU_PLATFORM] = "balanced";
+        result[CPU_BOOST] = true;
+    } else if (name == CPU_PROFILE_POWERSAVE) {
+        result[CPU_GOVERNOR] = "schedutil,powersave";
+        result[CPU_EPP] = "power,balance_power";
+        result[CPU_PLATFORM] = "low-power,quiet";
+        result[CPU_BOOST] = false;
+    }
+    return result;
+}
+
+bool CpuProfile::validProfile(const QVariantMap &profile)
+{
+    if (profile.isEmpty()) { return false; }
+    QStringList keys;
+    keys << CPU_GOVERNOR << CPU_EPP << CPU_PLATFORM << CPU_BOOST << CPU_MAX_FREQ;
+    QMapIterator<QString, QVariant> i(profile);
+    while (i.hasNext()) {
+        i.next();
+        if (!keys.contains(i.key())) { return false; }
+    }
+    if (profile.contains(CPU_MAX_FREQ)) {
+        int percent = profile.value(CPU_MAX_FREQ).toInt();
+        if (percent<1 || percent>100) { return false; }
+    }
+    return true;
+}
+
+QStringList CpuProfile::policies()
+{
+    QStringList result;
+    QDir dir(QString("%1%2/cpufreq").arg(root).arg(CPU_SYSFS));
+    foreach (QString policy, dir.entryList(QStringList() << "policy*",
+                                           QDir::Dirs|QDir::NoDotAndDotDot,
+                                           QDir::Name)) {
+        result << dir.absoluteFilePath(policy);
+    }
+    return result;
+}
+
+// no_turbo is inverted
+QString CpuProfile::boostPath(bool *inverted)
+{
+    QString path = QString("%1%2/intel_pstate/no_turbo").arg(root).arg(CPU_SYSFS);
+    *inverted = true;
+    if (QFile::exists(path)) { return path; }
+    path = QString("%1%2/cpufreq/boost").arg(root).arg(CPU_SYSFS);
+    *inverted = false;
+    if (QFile::exists(path)) { return path; }
+    return QString();
+}
+
+// first wanted value in the space separated choices
+QString CpuProfile::pick(const QString &wanted, const QString &choices)
+{
+    QStringList available = choices.split(" ", QString::SkipEmptyParts);
+    foreach (QString value, wanted.split(",", QString::SkipEmptyParts)) {
+        if (available.contains(value.trimmed())) { return value.trimmed(); }
+    }
+    return QString();
+}
+
+// all or nothing, the governor is set before the EPP of a policy
+bool CpuProfile::apply(const QVariantMap &profile)
+{
+    lastError.clear();
+    if (!validProfile(profile)) {
+        lastError = "invalid profile";
+        return false;
+    }
+    SysfsTransaction transaction;
+    foreach (QString policy, policies()) {
+        if (profile.contains(CPU_GOVERNOR)) {
+            QString value = pick(profile.value(CPU_GOVERNOR).toString(),
+                                 SysfsTransaction::read(QString("%1/scaling_available_governors").arg(policy)));
+            if (!value.isEmpty()) {
+                transaction.add(QString("%1/scaling_governor").arg(policy), value);
+            }
+        }
+        if (profile.contains(CPU_EPP)) {
+            QString value = pick(profile.value(CPU_EPP).toString(),
+                                 SysfsTransaction::read(QString("%1/energy_performance_available_preferences").arg(policy)));
+            if (!value.isEmpty()) {
+                transaction.add(QString("%1/energy_performance_preference").arg(policy), value);
+            }
+        }
+        if (profile.contains(CPU_MAX_FREQ)) {
+            qlonglong max = SysfsTransaction::read(QString("%1/cpuinfo_max_freq").arg(policy)).toLongLong();
+            qlonglong min = SysfsTransaction::read(QString("%1/cpuinfo_min_freq").arg(policy)).toLongLong();
+            if (max>0) {
+                qlonglong value = qMax(min, max*profile.value(CPU_MAX_FREQ).toInt()/100);
+                transaction.add(QString("%1/scaling_max_freq").arg(policy), QString::number(value));
+            }
+        }
+    }
+    if (profile.contains(CPU_PLATFORM)) {
+        QString path = QString("%1%2").arg(root).arg(CPU_PLATFORM_PROFILE);
+        QString value = pick(profile.value(CPU_PLATFORM).toString(),
+                             SysfsTransaction::read(QString("%1_choices").arg(path)));
+        if (!value.isEmpty()) { transaction.add(path, value); }
+    }
+    if (profile.contains(CPU_BOOST)) {
+        bool inverted;
+        QString path = boostPath(&inverted);
+        bool boost = profile.value(CPU_BOOST).toBool();
+        if (!path.isEmpty()) { transaction.add(path, (boost != inverted)?"1":"0"); }
+    }
+    if (!transaction.commit()) {
+        lastError = transaction.error();
+        return false;
+    }
+    return true;
+}
+
+// current values, the first policy for the per policy keys
+QVariantMap CpuProfile::state()
+{
+    QVariantMap result;
+    QStringList list = policies();
+    if (!list.isEmpty()) {
+        result[CPU_GOVERNOR] = SysfsTransaction::read(QString("%1/scaling_governor").arg(list.first()));
+        result[CPU_EPP] = SysfsTransaction::read(QString("%1/energy_performance_preference").arg(list.first()));
+        qlonglong max = SysfsTransaction::read(QString("%1/cpuinfo_max_freq").arg(list.first())).toLongLong();
+        if (max>0) {
+            qlonglong freq = SysfsTransaction::read(QString("%1/scaling_max_freq").arg(list.first())).toLongLong();
+            result[CPU_MAX_FREQ] = (int)qRound(freq*100.0/max);
+        }
+    }
+    result[CPU_PLATFORM] = SysfsTransaction::read(QString("%1%2").arg(root).arg(CPU_PLATFORM_PROFILE));
+    bool inverted;
+    QString path = boostPath(&inverted);
+    if (!path.isEmpty()) {
+        result[CPU_BOOST] = (SysfsTransaction::read(path) == "1") != inverted;
+    }
+    result["policies"] = list.size();
+    return result;
+}
+
+QString CpuProfile::error()
+{
+    return lastError;
+}
@@ -0,0 +1,60 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef CPUPROFILE_H
+#define CPUPROFILE_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+#define CPU_SYSFS "/sys/devices/system/cpu"
+#define CPU_PLATFORM_PROFILE "/sys/firmware/acpi/platform_profile"
+
+// profile keys, string values may list alternatives ("schedutil,powersave"),
+// the first one the hardware offers is used
+#define CPU_GOVERNOR "governor"
+#define CPU_EPP "energy_performance_preference"
+#define CPU_PLATFORM "platform_profile"
+#define CPU_BOOST "boost"
+#define CPU_MAX_FREQ "max_freq" // % of cpuinfo_max_freq
+
+#define CPU_PROFILE_PERFORMANCE "performance"
+#define CPU_PROFILE_BALANCED "balanced"
+#define CPU_PROFILE_POWERSAVE "powersave"
+
+// CPU power profiles: the cpufreq governor, energy performance
+// preference and frequency cap of every policy, the ACPI platform
+// profile and turbo (intel_pstate no_turbo or cpufreq boost).
+//
+// Only values listed by the kernel are written, a key the hardware
+// doesn't have is skipped. All writes go in one SysfsTransaction.
+// The root is prepended to every path, a fake sysfs tree for tests.
+class CpuProfile
+{
+public:
+    explicit CpuProfile(const QString &root = QString());
+
+    static QStringList profiles();
+    static QVariantMap profile(const QString &name);
+    static bool validProfile(const QVariantMap &profile);
+
+    bool apply(const QVariantMap &profile);
+    QVariantMap state();
+    QString error();
+
+private:
+    QString root;
+    QString lastError;
+
+    QStringList policies();
+    QString boostPath(bool *inverted);
+    static QString pick(const QString &wanted, const QString &choices);
+};
+
+#endif // CPUPROFILE_H
@@ -58,6 +58,10 @@ enum criticalAction
 #define BACKLIGHT_MOVE_VALUE 10
 #define LOW_BATTERY 5 // % over critical
 #define CRITICAL_BATTERY 10
+#define CRITICAL_HIBERNATE_LEAD 60 // seconds needed to finish hibernate
+#define CRITICAL_SHUTDOWN_LEAD 30 // seconds needed to finish poweroff
+#define CRITICAL_RECHECK_MARGIN 15 // re-check this long before acting
+#define BATTERY_SAVER_HYSTERESIS 3 // % over a band before its cap is lifted
 #define AUTO_SLEEP_BATTERY 15
 #define DEFAULT_THEME "Adwaita"
 #define DEFAULT_AC_ICON "ac-adapter"
@@ -93,6 +97,8 @@ enum criticalAction
 #define PMD_SERVICE "org.freedesktop.powerkitd"
 #define PMD_PATH "/org/freedesktop/powerkitd"
 #define PMD_MANAGER "org.freedesktop.powerkitd.Manager"
+#define PMD_ALARM_HIBERNATE "hibernate" // suspend-then-hibernate wake alarm
+#define PMD_ALARM_MAINTENANCE "maintenance"
 
 #define PM_SERVICE "org.freedesktop.PowerManagement"
 #define PM_PATH "/PowerManagement"
@@ -107,6 +113,8 @@ enum criticalAction
 #define SS_MAX_INHIBIT 18000
 #define SS_SIMULATE "SimulateUserActivity"
 
+#define IDLE_TIMEOUT 60000
+
 #define XSCREENSAVER "xscreensaver-command -deactivate"
 #define XSCREENSAVER_LOCK "xscreensaver-command -lock"
 
@@ -117,6 +125,19 @@ enum criticalAction
 #define CONF_SUSPEND_AC_ACTION "suspend_ac_action"
 #define CONF_SUSPEND_WAKEUP_HIBERNATE_BATTERY "suspend_wakeup_hibernate_battery"
 #define CONF_SUSPEND_WAKEUP_HIBERNATE_AC "suspend_wakeup_hibernate_ac"
+#define CONF_SUSPEND_WAKEUP_HIBERNATE_AUTO "suspend_wakeup_hibernate_auto"
+#define CONF_SUSPEND_WAKEUP_HIBERNATE_RESERVE "suspend_wakeup_hibernate_reserve"
+#define CONF_MAINTENANCE_TIME "maintenance_time"
+#define CONF_MAINTENANCE_COMMAND "maintenance_command"
+#define CONF_MAINTENANCE_TIMEOUT "maintenance_timeout"
+#define CONF_MAINTENANCE_MIN_BATTERY "maintenance_min_battery"
+#define CONF_CPU_PROFILE_AC "cpu_profile_ac"
+#define CONF_CPU_PROFILE_BATTERY "cpu_profile_battery"
+#define CONF_BATTERY_SAVER "battery_saver"
+#define CONF_RUNTIME_PM "runtime_pm"
+#define CONF_RUNTIME_PM_DELAY "runtime_pm_delay"
+#define CONF_RUNTIME_PM_ALLOW "runtime_pm_allow"
+#define CONF_RUNTIME_PM_DENY "runtime_pm_deny"
 #define CONF_CRITICAL_BATTERY_TIMEOUT "critical_battery_timeout"
 #define CONF_CRITICAL_BATTERY_ACTION "critical_battery_action"
 #define CONF_LID_BATTERY_ACTION "lid_battery_action"
@@ -143,5 +164,8 @@ enum criticalAction
 #define CONF_RESUME_LOCK_SCREEN "lock_screen_on_resume"
 #define CONF_ICON_THEME "icon_theme"
 #define CONF_KERNEL_BYPASS "kernel_cmd_bypass"
+#define CONF_PROMETHEUS_FILE "prometheus_file"
+#define CONF_PROMETHEUS_INTERVAL "prometheus_interval"
+#define CONF_TRACE_FILE "trace_file"
 
 #endif // DEF_H
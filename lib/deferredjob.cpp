@@ -0,0 +1,69 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "deferredjob.h"
+
+#include <QStringList>
+
+DeferredJob::DeferredJob()
+    : onAC(false)
+    , idle(0)
+    , batteryMin(0)
+    , running(false)
+{
+}
+
+DeferredJob::DeferredJob(const QString &owner,
+                         const QString &name,
+                         const QVariantMap &conditions)
+    : owner(owner)
+    , name(name)
+    , onAC(conditions.value(JOB_ON_AC, false).toBool())
+    , idle((qint64)conditions.value(JOB_IDLE_MINUTES, 0).toInt()*60000)
+    , batteryMin(conditions.value(JOB_BATTERY_MIN, 0).toDouble())
+    , running(false)
+{
+}
+
+// unknown keys are refused, a typo should not become a job
+// that runs on battery
+bool DeferredJob::validConditions(const QVariantMap &conditions)
+{
+    QStringList keys;
+    keys << JOB_ON_AC << JOB_IDLE_MINUTES << JOB_BATTERY_MIN;
+    QMapIterator<QString, QVariant> i(conditions);
+    while (i.hasNext()) {
+        i.next();
+        if (!keys.contains(i.key())) { return false; }
+    }
+    return conditions.value(JOB_IDLE_MINUTES, 0).toInt()>=0 &&
+           conditions.value(JOB_BATTERY_MIN, 0).toDouble()>=0;
+}
+
+// battery is -1 without a battery, then the level always holds
+bool DeferredJob::allowed(bool onBattery,
+                          double battery,
+                          qint64 idleMsecs) const
+{
+    if (onAC && onBattery) { return false; }
+    if (idle>0 && idleMsecs<idle) { return false; }
+    if (batteryMin>0 && battery>=0 && battery<batteryMin) { return false; }
+    return true;
+}
+
+QVariantMap DeferredJob::toMap() const
+{
+    QVariantMap result;
+    result["owner"] = owner;
+    result["name"] = name;
+    result[JOB_ON_AC] = onAC;
+    result[JOB_IDLE_MINUTES] = (int)(idle/60000);
+    result[JOB_BATTERY_MIN] = batteryMin;
+    result["running"] = running;
+    return result;
+}
@@ -0,0 +1,44 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef DEFERREDJOB_H
+#define DEFERREDJOB_H
+
+#include <QString>
+#include <QVariantMap>
+
+#define JOB_ON_AC "on_ac"
+#define JOB_IDLE_MINUTES "idle_minutes"
+#define JOB_BATTERY_MIN "battery_min"
+#define JOB_MAX 256 // registrations in total
+
+// A background job registered with PowerKit::RegisterDeferredJob,
+// it may run while all of its conditions hold.
+class DeferredJob
+{
+public:
+    DeferredJob();
+    DeferredJob(const QString &owner,
+                const QString &name,
+                const QVariantMap &conditions);
+
+    QString owner; // unique bus name of the client
+    QString name;
+    bool onAC;
+    qint64 idle; // msecs, 0 for any
+    double batteryMin; // %, 0 for any
+    bool running;
+
+    static bool validConditions(const QVariantMap &conditions);
+    bool allowed(bool onBattery,
+                 double battery,
+                 qint64 idleMsecs) const;
+    QVariantMap toMap() const;
+};
+
+#endif // DEFERREDJOB_H
@@ -10,6 +10,7 @@
 
 #include <QDBusConnection>
 #include <QStringList>
+#include <QElapsedTimer>
 
 #define PROP_CHANGED "PropertiesChanged"
 #define PROP_DEV_MODEL "Model"
@@ -21,6 +22,7 @@
 #define PROP_DEV_ENERGY_FULL "EnergyFull"
 #define PROP_DEV_ENERGY_EMPTY "EnergyEmpty"
 #define PROP_DEV_ENERGY "Energy"
+#define PROP_DEV_ENERGY_RATE "EnergyRate"
 #define PROP_DEV_ONLINE "Online"
 #define PROP_DEV_POWER_SUPPLY "PowerSupply"
 #define PROP_DEV_TIME_TO_EMPTY "TimeToEmpty"
@@ -44,6 +46,9 @@ Device::Device(const QString block, QObject *parent)
     , energyFullDesign(0)
     , energyFull(0)
     , energyEmpty(0)
+    , energyRate(0)
+    , propertyReads(0)
+    , propertyReadTime(0)
     , dbus(0)
     , dbusp(0)
 {
@@ -79,20 +84,21 @@ void Device::updateDeviceProperties()
 {
     if (!dbus->isValid()) { return; }
 
-    model = dbus->property(PROP_DEV_MODEL).toString();
-    capacity =  dbus->property(PROP_DEV_CAPACITY).toDouble();
-    isRechargable =  dbus->property(PROP_DEV_IS_RECHARGE).toBool();
-    isPresent =  dbus->property(PROP_DEV_PRESENT).toBool();
-    percentage =  dbus->property(PROP_DEV_PERCENT).toDouble();
-    energyFullDesign = dbus->property(PROP_DEV_ENERGY_FULL_DESIGN).toDouble();
-    energyFull = dbus->property(PROP_DEV_ENERGY_FULL).toDouble();
-    energyEmpty = dbus->property(PROP_DEV_ENERGY_EMPTY).toDouble();
-    energy = dbus->property(PROP_DEV_ENERGY).toDouble();
-    online = dbus->property(PROP_DEV_ONLINE).toBool();
-    hasPowerSupply = dbus->property(PROP_DEV_POWER_SUPPLY).toBool();
-    timeToEmpty = dbus->property(PROP_DEV_TIME_TO_EMPTY).toLongLong();
-    timeToFull = dbus->property(PROP_DEV_TIME_TO_FULL).toLongLong();
-    type = (DeviceType)dbus->property(PROP_DEV_TYPE).toUInt();
+    model = read(PROP_DEV_MODEL).toString();
+    capacity =  read(PROP_DEV_CAPACITY).toDouble();
+    isRechargable =  read(PROP_DEV_IS_RECHARGE).toBool();
+    isPresent =  read(PROP_DEV_PRESENT).toBool();
+    percentage =  read(PROP_DEV_PERCENT).toDouble();
+    energyFullDesign = read(PROP_DEV_ENERGY_FULL_DESIGN).toDouble();
+    energyFull = read(PROP_DEV_ENERGY_FULL).toDouble();
+    energyEmpty = read(PROP_DEV_ENERGY_EMPTY).toDouble();
+    energy = read(PROP_DEV_ENERGY).toDouble();
+    energyRate = read(PROP_DEV_ENERGY_RATE).toDouble();
+    online = read(PROP_DEV_ONLINE).toBool();
+    hasPowerSupply = read(PROP_DEV_POWER_SUPPLY).toBool();
+    timeToEmpty = read(PROP_DEV_TIME_TO_EMPTY).toLongLong();
+    timeToFull = read(PROP_DEV_TIME_TO_FULL).toLongLong();
+    type = (DeviceType)read(PROP_DEV_TYPE).toUInt();
 
     if (type == DeviceBattery) { isBattery = true; }
     else {
@@ -101,12 +107,22 @@ void Device::updateDeviceProperties()
         else { isAC = false; }
     }
 
-    vendor = dbus->property(PROP_DEV_VENDOR).toString();
-    nativePath = dbus->property(PROP_DEV_NATIVEPATH).toString();
+    vendor = read(PROP_DEV_VENDOR).toString();
+    nativePath = read(PROP_DEV_NATIVEPATH).toString();
 
     emit deviceChanged(path);
 }
 
+QVariant Device::read(const char *name)
+{
+    QElapsedTimer timer;
+    timer.start();
+    QVariant result = dbus->property(name);
+    propertyReads++;
+    propertyReadTime += timer.nsecsElapsed()/1000;
+    return result;
+}
+
 void Device::update()
 {
     updateDeviceProperties();
@@ -114,7 +130,9 @@ void Device::update()
 
 void Device::updateBattery()
 {
-    percentage =  dbus->property(PROP_DEV_PERCENT).toDouble();
-    timeToEmpty = dbus->property(PROP_DEV_TIME_TO_EMPTY).toLongLong();
-    timeToFull = dbus->property(PROP_DEV_TIME_TO_FULL).toLongLong();
+    percentage =  read(PROP_DEV_PERCENT).toDouble();
+    energy = read(PROP_DEV_ENERGY).toDouble();
+    energyRate = read(PROP_DEV_ENERGY_RATE).toDouble();
+    timeToEmpty = read(PROP_DEV_TIME_TO_EMPTY).toLongLong();
+    timeToFull = read(PROP_DEV_TIME_TO_FULL).toLongLong();
 }
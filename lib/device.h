@@ -53,13 +53,18 @@ public:
     double energyFullDesign;
     double energyFull;
     double energyEmpty;
+    double energyRate;
     qlonglong timeToEmpty;
     qlonglong timeToFull;
+    qlonglong propertyReads;
+    qlonglong propertyReadTime; // usec
 
 private:
     QDBusInterface *dbus;
     QDBusInterface *dbusp;
 
+    QVariant read(const char *name);
+
 signals:
     void deviceChanged(const QString &devicePath);
 
@@ -0,0 +1,194 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "estimator.h"
+
+#include <qmath.h>
+
+DischargeEstimator::DischargeEstimator()
+{
+    reset();
+}
+
+void DischargeEstimator::reset()
+{
+    mean = 0;
+    variance = 0;
+    samples = 0;
+    rejects = 0;
+    rejectsInRow = 0;
+    hasLast = false;
+    lastSample = 0;
+    lastTime = 0;
+    lastEnergy = 0;
+}
+
+// returns false if the sample was ignored or rejected
+bool DischargeEstimator::addSample(qint64 timestamp, double energy, double rate)
+{
+    if (!hasLast) {
+        hasLast = true;
+        lastSample = timestamp;
+        lastTime = timestamp;
+        lastEnergy = energy;
+        if (rate>0) {
+            mean = rate;
+            samples = 1;
+        }
+        return true;
+    }
+    qint64 dt = timestamp-lastSample;
+    if (dt<ESTIMATOR_MIN_DT) { return false; }
+    lastSample = timestamp;
+
+    // energy delta is immune to short load bursts, the
+    // reported rate is used when energy was not updated.
+    // the delta is taken from the last change, a stale
+    // reading must not move the reference point
+    double observed = rate;
+    if (energy<lastEnergy) {
+        observed = (lastEnergy-energy)*3600.0/(double)(timestamp-lastTime);
+    }
+    if (energy != lastEnergy) {
+        lastTime = timestamp;
+        lastEnergy = energy;
+    }
+    if (observed<=0) { return false; }
+
+    if (samples == 0) {
+        mean = observed;
+        samples = 1;
+        return true;
+    }
+
+    double diff = observed-mean;
+    double band = ESTIMATOR_OUTLIER*qSqrt(variance);
+    if (band<ESTIMATOR_OUTLIER_FLOOR) { band = ESTIMATOR_OUTLIER_FLOOR; }
+    if (samples>=ESTIMATOR_WARMUP &&
+        qAbs(diff)>band &&
+        rejectsInRow<ESTIMATOR_MAX_REJECT) {
+        rejects++;
+        rejectsInRow++;
+        return false;
+    }
+    rejectsInRow = 0;
+
+    double alpha = 1.0-qExp(-(double)dt/(double)ESTIMATOR_TAU);
+    mean += alpha*diff;
+    variance = (1.0-alpha)*(variance+alpha*diff*diff);
+    samples++;
+    return true;
+}
+
+bool DischargeEstimator::isValid()
+{
+    return samples>=ESTIMATOR_WARMUP && mean>0;
+}
+
+double DischargeEstimator::power()
+{
+    return mean;
+}
+
+double DischargeEstimator::deviation()
+{
+    return qSqrt(variance);
+}
+
+int DischargeEstimator::rejected()
+{
+    return rejects;
+}
+
+qlonglong DischargeEstimator::timeToEmpty(double energy)
+{
+    return secondsFor(energy, mean);
+}
+
+// pessimistic bound, draw is higher than estimated
+qlonglong DischargeEstimator::timeToEmptyLow(double energy)
+{
+    return secondsFor(energy, mean+ESTIMATOR_BOUNDS*deviation());
+}
+
+// optimistic bound, draw is lower than estimated
+qlonglong DischargeEstimator::timeToEmptyHigh(double energy)
+{
+    double power = mean-ESTIMATOR_BOUNDS*deviation();
+    if (power<mean/4) { power = mean/4; }
+    return secondsFor(energy, power);
+}
+
+qlonglong DischargeEstimator::secondsUntil(double energy, double target)
+{
+    if (energy<=target) { return 0; }
+    return secondsFor(energy-target, mean);
+}
+
+// energy left at 'timestamp' if the draw continues since the last sample,
+// covers the case where upower is slow to report new values
+double DischargeEstimator::projectedEnergy(qint64 timestamp)
+{
+    if (!hasLast) { return 0; }
+    qint64 dt = timestamp-lastTime;
+    if (dt<0) { dt = 0; }
+    double result = lastEnergy-mean*(double)dt/3600.0;
+    return result>0?result:0;
+}
+
+qlonglong DischargeEstimator::secondsUntilAt(qint64 timestamp, double target)
+{
+    if (!isValid()) { return -1; }
+    return secondsUntil(projectedEnergy(timestamp), target);
+}
+
+// replay a recorded discharge trace and compare the predicted time
+// to reach the last sample of each discharge run with the actual time.
+// with 'upowerRate' the raw reported rate is used instead (baseline).
+double DischargeEstimator::meanAbsoluteError(const QList<HistorySample> &trace,
+                                             bool upowerRate)
+{
+    double error = 0;
+    int count = 0;
+    int start = 0;
+    while (start<trace.size()) {
+        // find the discharge run [start, end]
+        if (trace.at(start).source != HistorySample::SourceBattery) {
+            start++;
+            continue;
+        }
+        int end = start;
+        while (end+1<trace.size() &&
+               trace.at(end+1).source == HistorySample::SourceBattery) { end++; }
+
+        DischargeEstimator estimator;
+        const HistorySample &last = trace.at(end);
+        for (int i=start;i<end;++i) {
+            const HistorySample &sample = trace.at(i);
+            estimator.addSample(sample.timestamp, sample.energy, sample.rate);
+            qlonglong predicted = -1;
+            if (upowerRate) {
+                predicted = secondsFor(sample.energy-last.energy, sample.rate);
+            } else if (estimator.isValid()) {
+                predicted = estimator.secondsUntil(sample.energy, last.energy);
+            }
+            if (predicted<0) { continue; }
+            error += qAbs((double)(predicted-(last.timestamp-sample.timestamp)));
+            count++;
+        }
+        start = end+1;
+    }
+    if (count == 0) { return -1; }
+    return error/count;
+}
+
+qlonglong DischargeEstimator::secondsFor(double energy, double power)
+{
+    if (power<=0 || energy<=0) { return -1; }
+    return (qlonglong)(energy*3600.0/power);
+}
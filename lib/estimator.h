@@ -0,0 +1,64 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef ESTIMATOR_H
+#define ESTIMATOR_H
+
+#include <QList>
+
+#include "history.h"
+
+#define ESTIMATOR_TAU 300 // smoothing time constant (seconds)
+#define ESTIMATOR_MIN_DT 10 // ignore samples closer than this (seconds)
+#define ESTIMATOR_WARMUP 3 // samples before the estimate is trusted
+#define ESTIMATOR_OUTLIER 3.0 // reject samples this many deviations away
+#define ESTIMATOR_OUTLIER_FLOOR 0.5 // W, minimum rejection band
+#define ESTIMATOR_MAX_REJECT 3 // accept after this many rejects in a row (load changed)
+#define ESTIMATOR_BOUNDS 2.0 // deviations used for confidence bounds
+
+// Discharge power estimator.
+//
+// Feed it the total energy and rate of all batteries, the power draw is
+// taken from the energy delta between samples (falls back to the reported
+// rate), smoothed with a time based EWMA and outliers are rejected using
+// the running variance. Feed totals for parallel batteries, not per battery.
+class DischargeEstimator
+{
+public:
+    DischargeEstimator();
+    void reset();
+    bool addSample(qint64 timestamp, double energy, double rate);
+    bool isValid();
+    double power();
+    double deviation();
+    int rejected();
+    qlonglong timeToEmpty(double energy);
+    qlonglong timeToEmptyLow(double energy);
+    qlonglong timeToEmptyHigh(double energy);
+    qlonglong secondsUntil(double energy, double target);
+    double projectedEnergy(qint64 timestamp);
+    qlonglong secondsUntilAt(qint64 timestamp, double target);
+
+    static double meanAbsoluteError(const QList<HistorySample> &trace,
+                                    bool upowerRate = false);
+
+private:
+    double mean;
+    double variance;
+    int samples;
+    int rejects;
+    int rejectsInRow;
+    bool hasLast;
+    qint64 lastSample; // last sample seen
+    qint64 lastTime; // last energy change
+    double lastEnergy;
+
+    static qlonglong secondsFor(double energy, double power);
+};
+
+#endif // ESTIMATOR_H
@@ -0,0 +1,218 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "health.h"
+#include "common.h"
+
+#include <QSettings>
+#include <QStringList>
+#include <QRegExp>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+
+#define EPOCH QDate(1970, 1, 1)
+
+HealthTracker::HealthTracker(const QString &path)
+    : file(path)
+    , clock(Clock::system())
+{
+    if (file.isEmpty()) {
+        file = QString("%1/%2/%3")
+               .arg(Common::confDir())
+               .arg(HEALTH_DIR)
+               .arg(HEALTH_FILE);
+        // saves in the config dir made the tray reload its settings
+        QString old = QString("%1/%2").arg(Common::confDir()).arg(HEALTH_FILE);
+        if (QFile::exists(old) && !QFile::exists(file)) {
+            QDir().mkpath(QFileInfo(file).absolutePath());
+            QFile::rename(old, file);
+        }
+    }
+    QDir().mkpath(QFileInfo(file).absolutePath());
+    reload();
+}
+
+void HealthTracker::setClock(Clock *clock)
+{
+    this->clock = clock?clock:Clock::system();
+}
+
+// vendor/model are part of the key so a swapped battery starts over
+QString HealthTracker::keyForDevice(Device *device)
+{
+    if (!device) { return QString(); }
+    QString key = QString("%1_%2_%3")
+                  .arg(device->vendor)
+                  .arg(device->model)
+                  .arg(device->name);
+    key.replace(QRegExp("[^A-Za-z0-9_\\-]"), "_");
+    return key;
+}
+
+void HealthTracker::update(Device *device)
+{
+    if (!device ||
+        !device->isBattery ||
+        !device->isPresent ||
+        device->energyFullDesign<=0) { return; }
+    QString key = keyForDevice(device);
+    Record &record = records[key];
+    bool changed = false;
+
+    record.design = device->energyFullDesign;
+    record.full = device->energyFull;
+
+    // integrate discharged energy
+    if (record.energy>=0 && device->energy<record.energy) {
+        record.throughput += record.energy-device->energy;
+    }
+    record.energy = device->energy;
+    if (record.throughput-record.saved>=HEALTH_SAVE_STEP) { changed = true; }
+
+    // one capacity sample per day
+    int day = today();
+    if (device->energyFull>0 &&
+        (record.capacity.isEmpty() || record.capacity.last().first != day)) {
+        record.capacity << qMakePair(day, device->energyFull);
+        while (record.capacity.size()>HEALTH_MAX_SAMPLES) {
+            record.capacity.removeFirst();
+        }
+        changed = true;
+    }
+
+    if (changed) { save(key); }
+}
+
+void HealthTracker::reload()
+{
+    records.clear();
+    QSettings settings(file, QSettings::IniFormat);
+    foreach (QString key, settings.childGroups()) {
+        settings.beginGroup(key);
+        Record record;
+        record.design = settings.value("design").toDouble();
+        record.full = settings.value("full").toDouble();
+        record.throughput = settings.value("throughput").toDouble();
+        record.saved = record.throughput;
+        foreach (QString sample, settings.value("capacity").toString()
+                                 .split(",", QString::SkipEmptyParts)) {
+            QStringList values = sample.split(":");
+            if (values.size() != 2) { continue; }
+            record.capacity << qMakePair(values.at(0).toInt(),
+                                         values.at(1).toDouble());
+        }
+        settings.endGroup();
+        records[key] = record;
+    }
+}
+
+bool HealthTracker::contains(const QString &key)
+{
+    return records.contains(key);
+}
+
+// current full capacity in % of design
+double HealthTracker::health(const QString &key)
+{
+    if (!records.contains(key) || records[key].design<=0) { return -1; }
+    return records[key].full/records[key].design*100.0;
+}
+
+double HealthTracker::cycles(const QString &key)
+{
+    if (!records.contains(key) || records[key].design<=0) { return -1; }
+    return records[key].throughput/records[key].design;
+}
+
+// lost capacity in % of design per year, -1 if unknown
+double HealthTracker::fadePerYear(const QString &key)
+{
+    if (!records.contains(key)) { return -1; }
+    double slope, intercept;
+    if (!fit(records[key], &slope, &intercept)) { return -1; }
+    return -slope*365.0*100.0;
+}
+
+// projected date where capacity reaches HEALTH_EOL_RATIO
+QDate HealthTracker::endOfLife(const QString &key)
+{
+    if (!records.contains(key)) { return QDate(); }
+    double slope, intercept;
+    if (!fit(records[key], &slope, &intercept) || slope>=0) { return QDate(); }
+    double day = (HEALTH_EOL_RATIO-intercept)/slope;
+    if (day<today()) { return EPOCH.addDays(today()); }
+    if (day>today()+365*50) { return QDate(); }
+    return EPOCH.addDays((qint64)day);
+}
+
+QVariantMap HealthTracker::report(const QString &key)
+{
+    QVariantMap result;
+    if (!records.contains(key)) { return result; }
+    const Record &record = records[key];
+    result["design_capacity"] = record.design;
+    result["full_capacity"] = record.full;
+    result["health"] = health(key);
+    result["throughput"] = record.throughput;
+    result["cycles"] = cycles(key);
+    result["fade_per_year"] = fadePerYear(key);
+    QDate eol = endOfLife(key);
+    result["end_of_life"] = eol.isValid()?eol.toString(Qt::ISODate):QString();
+    result["samples"] = record.capacity.size();
+    return result;
+}
+
+void HealthTracker::save(const QString &key)
+{
+    Record &record = records[key];
+    QStringList capacity;
+    for (int i=0;i<record.capacity.size();++i) {
+        capacity << QString("%1:%2")
+                    .arg(record.capacity.at(i).first)
+                    .arg(record.capacity.at(i).second, 0, 'f', 2);
+    }
+    QSettings settings(file, QSettings::IniFormat);
+    settings.beginGroup(key);
+    settings.setValue("design", record.design);
+    settings.setValue("full", record.full);
+    settings.setValue("throughput", record.throughput);
+    settings.setValue("capacity", capacity.join(","));
+    settings.endGroup();
+    settings.sync();
+    record.saved = record.throughput;
+}
+
+// least squares fit of full/design ratio vs day
+bool HealthTracker::fit(const Record &record, double *slope, double *intercept)
+{
+    int n = record.capacity.size();
+    if (n<HEALTH_MIN_SAMPLES || record.design<=0) { return false; }
+    if (record.capacity.last().first-record.capacity.first().first<HEALTH_MIN_DAYS) {
+        return false;
+    }
+    double sx = 0, sy = 0, sxx = 0, sxy = 0;
+    for (int i=0;i<n;++i) {
+        double x = record.capacity.at(i).first;
+        double y = record.capacity.at(i).second/record.design;
+        sx += x;
+        sy += y;
+        sxx += x*x;
+        sxy += x*y;
+    }
+    double d = n*sxx-sx*sx;
+    if (d == 0) { return false; }
+    *slope = (n*sxy-sx*sy)/d;
+    *intercept = (sy-*slope*sx)/n;
+    return true;
+}
+
+int HealthTracker::today()
+{
+    return (int)EPOCH.daysTo(clock->currentDateTime().date());
+}
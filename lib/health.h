@@ -0,0 +1,73 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef HEALTH_H
+#define HEALTH_H
+
+#include <QString>
+#include <QMap>
+#include <QList>
+#include <QPair>
+#include <QDate>
+#include <QVariantMap>
+
+#include "device.h"
+#include "clock.h"
+
+#define HEALTH_DIR "health" // not in the watched config dir
+#define HEALTH_FILE "health.conf"
+#define HEALTH_EOL_RATIO 0.8 // battery is worn out at 80% of design capacity
+#define HEALTH_MIN_SAMPLES 7 // daily samples needed for a projection
+#define HEALTH_MIN_DAYS 30 // days covered needed for a projection
+#define HEALTH_MAX_SAMPLES 3650
+#define HEALTH_SAVE_STEP 1.0 // Wh of throughput between saves
+
+// Per battery health tracking.
+//
+// Keeps one full capacity sample per day and the integrated discharge
+// energy, from that we get capacity fade, estimated charge cycles
+// (discharged energy / design energy) and a projected end of life
+// (linear fit of capacity vs time). Stored in a small ini file.
+class HealthTracker
+{
+public:
+    explicit HealthTracker(const QString &path = QString());
+    void setClock(Clock *clock);
+
+    static QString keyForDevice(Device *device);
+
+    void update(Device *device);
+    void reload();
+    bool contains(const QString &key);
+    double health(const QString &key);
+    double cycles(const QString &key);
+    double fadePerYear(const QString &key);
+    QDate endOfLife(const QString &key);
+    QVariantMap report(const QString &key);
+
+private:
+    struct Record
+    {
+        Record() : design(0), full(0), throughput(0), energy(-1), saved(0) {}
+        double design;
+        double full;
+        double throughput;
+        double energy;
+        double saved;
+        QList<QPair<int, double> > capacity; // day since epoch, Wh
+    };
+    QString file;
+    Clock *clock;
+    QMap<QString, Record> records;
+
+    void save(const QString &key);
+    bool fit(const Record &record, double *slope, double *intercept);
+    int today();
+};
+
+#endif // HEALTH_H
@@ -0,0 +1,326 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "history.h"
+#include "common.h"
+#include "varint.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QMap>
+#include <QRegExp>
+#include <qmath.h>
+#include <string.h>
+
+#ifdef Q_OS_UNIX
+#include <sys/mman.h>
+#endif
+
+// make sure the record is stored before it is committed
+#if defined(__GNUC__)
+#define HISTORY_BARRIER() __sync_synchronize()
+#else
+#define HISTORY_BARRIER()
+#endif
+
+BatteryHistory::BatteryHistory(const QString &path, int blocks)
+    : file(path)
+    , map(0)
+    , blockCount(blocks>1?(quint32)blocks:2)
+    , head(0)
+    , sequence(0)
+{
+    memset(&state, 0, sizeof(state));
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    if (!file.open(QIODevice::ReadWrite)) { return; }
+
+    qint64 size = (qint64)HISTORY_BLOCK_SIZE*(blockCount+1);
+    bool fresh = file.size() != size;
+    if (fresh && !file.resize(size)) {
+        file.close();
+        return;
+    }
+    map = file.map(0, size);
+    if (!map) {
+        file.close();
+        return;
+    }
+
+    Header *h = header();
+    if (fresh ||
+        memcmp(h->magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC)) != 0 ||
+        h->version != HISTORY_VERSION ||
+        h->blockSize != HISTORY_BLOCK_SIZE ||
+        h->blockCount != blockCount) { init(); }
+    recover();
+}
+
+BatteryHistory::~BatteryHistory()
+{
+    if (map) { file.unmap(map); }
+    file.close();
+}
+
+QString BatteryHistory::pathForDevice(const QString &name)
+{
+    QString safe = name;
+    safe.replace(QRegExp("[^A-Za-z0-9_\\-]"), "_");
+    return QString("%1/%2/%3.%4")
+           .arg(Common::confDir())
+           .arg(HISTORY_DIR)
+           .arg(safe)
+           .arg(HISTORY_SUFFIX);
+}
+
+bool BatteryHistory::isOpen()
+{
+    return map != NULL;
+}
+
+QString BatteryHistory::fileName()
+{
+    return file.fileName();
+}
+
+// O(1), writes at most one record and maybe recycles the oldest block
+bool BatteryHistory::append(const HistorySample &sample)
+{
+    if (!map) { return false; }
+    State next = toState(sample);
+    if (next.timestamp<state.timestamp) { return false; } // append only
+
+    Block *b = block(head);
+    State zero;
+    memset(&zero, 0, sizeof(zero));
+    uchar record[HISTORY_MAX_RECORD];
+    int len = encode(record, b->used>0?state:zero, next);
+    if (b->used+len>HISTORY_BLOCK_SIZE-sizeof(Block)) {
+        startBlock();
+        b = block(head);
+        len = encode(record, zero, next);
+    }
+
+    memcpy(payload(head)+b->used, record, len);
+    if (b->used == 0) { b->first = next.timestamp; }
+    b->last = next.timestamp;
+    HISTORY_BARRIER();
+    b->used += len; // commit
+    state = next;
+    return true;
+}
+
+HistorySample BatteryHistory::last()
+{
+    return toSample(state);
+}
+
+QList<HistorySample> BatteryHistory::query(qint64 from, qint64 to)
+{
+    QList<HistorySample> result;
+    if (!map) { return result; }
+    QList<quint32> blocks = orderedBlocks();
+    for (int i=0;i<blocks.size();++i) {
+        Block *b = block(blocks.at(i));
+        if (b->last<from || b->first>to) { continue; }
+        decodeBlock(blocks.at(i), from, to, &result, NULL);
+    }
+    return result;
+}
+
+// average samples into equally sized time buckets,
+// only one block is decoded at a time
+QList<HistorySample> BatteryHistory::downsample(qint64 from, qint64 to, int buckets)
+{
+    QList<HistorySample> result;
+    if (!map || to<from) { return result; }
+    if (buckets<1) { return query(from, to); }
+    qint64 width = (to-from)/buckets+1;
+
+    QMap<qint64, HistorySample> sums;
+    QMap<qint64, int> counts;
+    QList<quint32> blocks = orderedBlocks();
+    for (int i=0;i<blocks.size();++i) {
+        Block *b = block(blocks.at(i));
+        if (b->last<from || b->first>to) { continue; }
+        QList<HistorySample> samples;
+        decodeBlock(blocks.at(i), from, to, &samples, NULL);
+        for (int x=0;x<samples.size();++x) {
+            const HistorySample &sample = samples.at(x);
+            qint64 bucket = (sample.timestamp-from)/width;
+            HistorySample &sum = sums[bucket];
+            sum.timestamp += sample.timestamp;
+            sum.energy += sample.energy;
+            sum.rate += sample.rate;
+            sum.percentage += sample.percentage;
+            sum.source = sample.source;
+            counts[bucket]++;
+        }
+    }
+
+    QMapIterator<qint64, HistorySample> i(sums);
+    while (i.hasNext()) {
+        i.next();
+        int count = counts.value(i.key());
+        HistorySample sample = i.value();
+        sample.timestamp /= count;
+        sample.energy /= count;
+        sample.rate /= count;
+        sample.percentage /= count;
+        result << sample;
+    }
+    return result;
+}
+
+qint64 BatteryHistory::capacity()
+{
+    return (qint64)blockCount*(HISTORY_BLOCK_SIZE-sizeof(Block));
+}
+
+BatteryHistory::Header *BatteryHistory::header()
+{
+    return reinterpret_cast<Header*>(map);
+}
+
+BatteryHistory::Block *BatteryHistory::block(quint32 index)
+{
+    return reinterpret_cast<Block*>(map+(qint64)HISTORY_BLOCK_SIZE*(index+1));
+}
+
+uchar *BatteryHistory::payload(quint32 index)
+{
+    return reinterpret_cast<uchar*>(block(index))+sizeof(Block);
+}
+
+bool BatteryHistory::init()
+{
+    memset(map, 0, (size_t)HISTORY_BLOCK_SIZE*(blockCount+1));
+    Header *h = header();
+    memcpy(h->magic, HISTORY_MAGIC, sizeof(HISTORY_MAGIC));
+    h->version = HISTORY_VERSION;
+    h->blockSize = HISTORY_BLOCK_SIZE;
+    h->blockCount = blockCount;
+    h->head = 0;
+    return true;
+}
+
+// the newest block wins, the header is only a hint
+void BatteryHistory::recover()
+{
+    head = 0;
+    sequence = 0;
+    for (quint32 i=0;i<blockCount;++i) {
+        Block *b = block(i);
+        if (b->used>HISTORY_BLOCK_SIZE-sizeof(Block)) { b->used = 0; }
+        if (b->sequence>sequence) {
+            sequence = b->sequence;
+            head = i;
+        }
+    }
+    if (sequence == 0) {
+        startBlock();
+        return;
+    }
+    header()->head = head;
+
+    memset(&state, 0, sizeof(state));
+    quint32 last = block(head)->used>0?head:(head+blockCount-1)%blockCount;
+    if (block(last)->sequence>0) {
+        decodeBlock(last, 0, 0, NULL, &state);
+    }
+}
+
+void BatteryHistory::startBlock()
+{
+    quint32 next = sequence == 0?head:(head+1)%blockCount;
+    Block *b = block(next);
+    b->used = 0;
+    b->first = 0;
+    b->last = 0;
+    HISTORY_BARRIER();
+    b->sequence = ++sequence;
+    head = next;
+    header()->head = head;
+#ifdef Q_OS_UNIX
+    msync(map, (size_t)HISTORY_BLOCK_SIZE*(blockCount+1), MS_ASYNC);
+#endif
+}
+
+QList<quint32> BatteryHistory::orderedBlocks()
+{
+    QMap<quint32, quint32> order;
+    for (quint32 i=0;i<blockCount;++i) {
+        Block *b = block(i);
+        if (b->sequence == 0 || b->used == 0) { continue; }
+        order[b->sequence] = i;
+    }
+    return order.values();
+}
+
+void BatteryHistory::decodeBlock(quint32 index,
+                                 qint64 from,
+                                 qint64 to,
+                                 QList<HistorySample> *result,
+                                 State *last)
+{
+    Block *b = block(index);
+    const uchar *data = payload(index);
+    quint32 size = b->used;
+    quint32 pos = 0;
+    State s;
+    memset(&s, 0, sizeof(s));
+    while (pos<size) {
+        quint64 dt, de, dr, dp;
+        if (!Varint::get(data, size, &pos, &dt) ||
+            !Varint::get(data, size, &pos, &de) ||
+            !Varint::get(data, size, &pos, &dr) ||
+            !Varint::get(data, size, &pos, &dp) ||
+            pos>=size) { break; }
+        s.timestamp += (qint64)dt;
+        s.energy += Varint::unzigzag(de);
+        s.rate += Varint::unzigzag(dr);
+        s.percentage += Varint::unzigzag(dp);
+        s.source = data[pos++];
+        if (result && s.timestamp>=from && s.timestamp<=to) {
+            result->append(toSample(s));
+        }
+    }
+    if (last) { *last = s; }
+}
+
+int BatteryHistory::encode(uchar *out, const State &base, const State &next)
+{
+    int len = 0;
+    len += Varint::put(out+len, (quint64)(next.timestamp-base.timestamp));
+    len += Varint::put(out+len, Varint::zigzag(next.energy-base.energy));
+    len += Varint::put(out+len, Varint::zigzag(next.rate-base.rate));
+    len += Varint::put(out+len, Varint::zigzag(next.percentage-base.percentage));
+    out[len++] = (uchar)next.source;
+    return len;
+}
+
+BatteryHistory::State BatteryHistory::toState(const HistorySample &sample)
+{
+    State result;
+    result.timestamp = sample.timestamp;
+    result.energy = qRound64(sample.energy*1000);
+    result.rate = qRound64(sample.rate*1000);
+    result.percentage = qRound64(sample.percentage*100);
+    result.source = sample.source;
+    return result;
+}
+
+HistorySample BatteryHistory::toSample(const State &state)
+{
+    HistorySample result;
+    result.timestamp = state.timestamp;
+    result.energy = (double)state.energy/1000;
+    result.rate = (double)state.rate/1000;
+    result.percentage = (double)state.percentage/100;
+    result.source = state.source;
+    return result;
+}
@@ -0,0 +1,114 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#include <QFile>
+#include <QList>
+#include <QString>
+
+#define HISTORY_MAGIC "PKHIST1"
+#define HISTORY_VERSION 1
+#define HISTORY_BLOCK_SIZE 4096
+#define HISTORY_BLOCKS 256 // ~1MB, ~3 months at one sample per minute
+#define HISTORY_DIR "history"
+#define HISTORY_SUFFIX "ring"
+#define HISTORY_MAX_RECORD 41 // 4 varints + source
+
+struct HistorySample
+{
+    enum Source {
+        SourceUnknown,
+        SourceBattery,
+        SourceAC
+    };
+    HistorySample()
+        : timestamp(0), energy(0), rate(0), percentage(0), source(SourceUnknown) {}
+    qint64 timestamp; // seconds since epoch
+    double energy; // Wh
+    double rate; // W
+    double percentage;
+    int source;
+};
+
+// Append-only battery history stored in a fixed size memory mapped ring.
+//
+// The file is split in blocks, each block starts from a zero state and
+// stores records as varint/zigzag deltas from the previous record.
+// A block is only made visible by bumping its 'used' counter after the
+// record is written, so a crash can at most lose the record in flight.
+// When the ring is full the oldest block is recycled.
+class BatteryHistory
+{
+public:
+    explicit BatteryHistory(const QString &path,
+                            int blocks = HISTORY_BLOCKS);
+    ~BatteryHistory();
+
+    static QString pathForDevice(const QString &name);
+
+    bool isOpen();
+    QString fileName();
+    bool append(const HistorySample &sample);
+    HistorySample last();
+    QList<HistorySample> query(qint64 from, qint64 to);
+    QList<HistorySample> downsample(qint64 from, qint64 to, int buckets);
+    qint64 capacity();
+
+private:
+    struct Header
+    {
+        char magic[8];
+        quint32 version;
+        quint32 blockSize;
+        quint32 blockCount;
+        quint32 head;
+    };
+    struct Block
+    {
+        quint32 sequence; // 0 == empty
+        quint32 used; // committed payload bytes
+        qint64 first;
+        qint64 last;
+    };
+    struct State
+    {
+        qint64 timestamp;
+        qint64 energy; // mWh
+        qint64 rate; // mW
+        qint64 percentage; // 1/100 %
+        int source;
+    };
+
+    QFile file;
+    uchar *map;
+    quint32 blockCount;
+    quint32 head;
+    quint32 sequence;
+    State state; // last record written
+
+    Header *header();
+    Block *block(quint32 index);
+    uchar *payload(quint32 index);
+    bool init();
+    void recover();
+    void startBlock();
+    QList<quint32> orderedBlocks();
+    void decodeBlock(quint32 index,
+                     qint64 from,
+                     qint64 to,
+                     QList<HistorySample> *result,
+                     State *last);
+
+    static int encode(uchar *out, const State &base, const State &next);
+    static State toState(const HistorySample &sample);
+    static HistorySample toSample(const State &state);
+};
+
+#endif // HISTORY_H
@@ -7,20 +7,36 @@
 */
 
 #include "hotplug.h"
+#include "xstats.h"
+
+#include <sys/select.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 HotPlug::HotPlug(QObject *parent) :
     QObject(parent)
-  , _scanning(false)
+  , _scanning(0)
 {
+    wake[0] = wake[1] = -1;
+    if (pipe(wake) == 0) {
+        for (int i=0;i<2;++i) {
+            fcntl(wake[i], F_SETFL, fcntl(wake[i], F_GETFL)|O_NONBLOCK);
+            fcntl(wake[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
     moveToThread(&t);
     t.start();
 }
 
 HotPlug::~HotPlug()
 {
-    _scanning = false;
-    t.wait();
+    _scanning.fetchAndStoreOrdered(0);
+    wakeUp();
     t.quit();
+    t.wait();
+    for (int i=0;i<2;++i) {
+        if (wake[i] != -1) { close(wake[i]); }
+    }
 }
 
 void HotPlug::requestScan()
@@ -30,11 +46,14 @@ void HotPlug::requestScan()
 
 void HotPlug::scan()
 {
-    if (_scanning) { return; }
-    _scanning = true;
+    if (_scanning.fetchAndStoreOrdered(1)) { return; }
 
+    // without the pipe a stop request could never wake us up
     Display *dpy;
-    if ((dpy = XOpenDisplay(NULL)) == NULL) { return; }
+    if (wake[0] == -1 || (dpy = XOpenDisplay(NULL)) == NULL) {
+        _scanning.fetchAndStoreOrdered(0);
+        return;
+    }
 
     XRRScreenResources *sr;
     XRROutputInfo *info;
@@ -44,8 +63,25 @@ void HotPlug::scan()
 
     XRRSelectInput(dpy, DefaultRootWindow(dpy), RROutputChangeNotifyMask);
     XSync(dpy, 0);
-    while(_scanning) {
+    // block on the connection and the wake pipe, a stop request
+    // clears _scanning before it writes to the pipe
+    int fd = ConnectionNumber(dpy);
+    char drain[16];
+    while (read(wake[0], drain, sizeof(drain))>0) {}
+    while(_scanning.fetchAndAddOrdered(0)) {
+        if (!XPending(dpy)) {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(fd, &fds);
+            FD_SET(wake[0], &fds);
+            select(qMax(fd, wake[0])+1, &fds, NULL, NULL, NULL);
+            if (FD_ISSET(wake[0], &fds)) {
+                while (read(wake[0], drain, sizeof(drain))>0) {}
+            }
+            continue;
+        }
         if (!XNextEvent(dpy, &ev)) {
+            XStats::Scope stats(dpy, "hotplug");
             sr = XRRGetScreenResources(OCNE(&ev)->display, OCNE(&ev)->window);
             if (sr == NULL) { continue; }
             info = XRRGetOutputInfo(OCNE(&ev)->display, sr, OCNE(&ev)->output);
@@ -64,9 +100,23 @@ void HotPlug::scan()
     XCloseDisplay(dpy);
 }
 
+// stopping can't be queued, scan() keeps the thread busy
 void HotPlug::requestSetScan(bool scanning)
 {
-    QMetaObject::invokeMethod(this, "setScan", Q_ARG(bool, scanning));
+    if (scanning) { requestScan(); }
+    else {
+        _scanning.fetchAndStoreOrdered(0);
+        wakeUp();
+    }
+}
+
+// async-signal and thread safe, a full pipe already wakes scan()
+void HotPlug::wakeUp()
+{
+    if (wake[1] == -1) { return; }
+    char byte = 0;
+    ssize_t ignored = write(wake[1], &byte, 1);
+    Q_UNUSED(ignored)
 }
 
 void HotPlug::getScreens(Display *dpy)
@@ -75,8 +125,3 @@ void HotPlug::getScreens(Display *dpy)
     QMap<QString,bool> result = Screens::outputsDpy(dpy);
     emit found(result);
 }
-
-void HotPlug::setScan(bool scanning)
-{
-    _scanning = scanning;
-}
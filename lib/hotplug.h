@@ -12,6 +12,7 @@
 #include <QObject>
 #include <QThread>
 #include <QMap>
+#include <QAtomicInt>
 
 #include "screens.h"
 #include <X11/extensions/Xrandr.h>
@@ -29,7 +30,10 @@ public:
 
 private:
     QThread t;
-    bool _scanning;
+    QAtomicInt _scanning;
+    int wake[2]; // self-pipe, wakes scan() on a stop request
+
+    void wakeUp();
 
 signals:
     void status(QString display, bool connected);
@@ -41,7 +45,6 @@ public slots:
 private slots:
     void scan();
     void getScreens(Display *dpy);
-    void setScan(bool scanning);
 };
 
 #endif // HOTPLUG_H
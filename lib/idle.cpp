@@ -0,0 +1,44 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "idle.h"
+#include "xstats.h"
+
+#include <X11/extensions/scrnsaver.h>
+
+qint64 Idle::msecsDpy(Display *dpy)
+{
+    if (dpy == NULL) { return -1; }
+    XStats::Scope stats(dpy, "idle");
+    qint64 result = -1;
+    XScreenSaverInfo *info = XScreenSaverAllocInfo();
+    if (info == NULL) { return result; }
+    if (XScreenSaverQueryInfo(dpy, DefaultRootWindow(dpy), info)) {
+        result = (qint64)info->idle;
+    }
+    XFree(info);
+    return result;
+}
+
+qint64 Idle::msecs()
+{
+    Display *dpy;
+    if ((dpy = XOpenDisplay(NULL)) == NULL) { return -1; }
+    qint64 result = msecsDpy(dpy);
+    XCloseDisplay(dpy);
+    return result;
+}
+
+// idle minutes as used by the auto suspend, the first
+// minute does not count
+int Idle::minutes()
+{
+    qint64 idle = msecs();
+    if (idle<0) { idle = 0; }
+    return (int)((idle-(1000*60))/(1000*60));
+}
@@ -0,0 +1,25 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef IDLE_H
+#define IDLE_H
+
+#include <QtGlobal>
+
+#include <X11/Xlib.h>
+
+// user idle time from the MIT-SCREEN-SAVER extension
+class Idle
+{
+public:
+    static qint64 msecsDpy(Display *dpy); // -1 if unknown
+    static qint64 msecs();
+    static int minutes();
+};
+
+#endif // IDLE_H
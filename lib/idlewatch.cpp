@@ -0,0 +1,220 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "idlewatch.h"
+
+#include <QMap>
+#include <QMutexLocker>
+
+#include <sys/select.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <string.h>
+
+// Xlib macros clash with Qt, keep last
+#include <X11/Xlib.h>
+#include <X11/extensions/sync.h>
+
+static XSyncCounter idleCounter(Display *dpy)
+{
+    XSyncCounter result = None;
+    int count = 0;
+    XSyncSystemCounter *counters = XSyncListSystemCounters(dpy, &count);
+    if (counters == NULL) { return result; }
+    for (int i=0;i<count;++i) {
+        if (strcmp(counters[i].name, IDLEWATCH_COUNTER) == 0) {
+            result = counters[i].counter;
+            break;
+        }
+    }
+    XSyncFreeSystemCounterList(counters);
+    return result;
+}
+
+static XSyncAlarm createAlarm(Display *dpy,
+                              XSyncCounter counter,
+                              XSyncTestType test,
+                              qint64 msecs)
+{
+    XSyncAlarmAttributes attr;
+    attr.trigger.counter = counter;
+    attr.trigger.value_type = XSyncAbsolute;
+    attr.trigger.test_type = test;
+    XSyncIntsToValue(&attr.trigger.wait_value,
+                     (unsigned int)(msecs&0xffffffff),
+                     (int)(msecs>>32));
+    XSyncIntToValue(&attr.delta, 0);
+    attr.events = True;
+    return XSyncCreateAlarm(dpy,
+                            XSyncCACounter|XSyncCAValueType|XSyncCATestType|
+                            XSyncCAValue|XSyncCADelta|XSyncCAEvents,
+                            &attr);
+}
+
+IdleWatch::IdleWatch(QObject *parent) :
+    QObject(parent)
+  , _watching(0)
+  , _running(0)
+  , _changed(0)
+{
+    wake[0] = wake[1] = -1;
+    if (pipe(wake) == 0) {
+        for (int i=0;i<2;++i) {
+            fcntl(wake[i], F_SETFL, fcntl(wake[i], F_GETFL)|O_NONBLOCK);
+            fcntl(wake[i], F_SETFD, FD_CLOEXEC);
+        }
+    }
+    moveToThread(&t);
+    t.start();
+}
+
+IdleWatch::~IdleWatch()
+{
+    _watching.fetchAndStoreOrdered(0);
+    wakeUp();
+    t.quit();
+    t.wait();
+    for (int i=0;i<2;++i) {
+        if (wake[i] != -1) { close(wake[i]); }
+    }
+}
+
+// thread safe, wakes watch() to rebuild the alarms
+void IdleWatch::setThresholds(const QList<qint64> &msecs)
+{
+    QMutexLocker lock(&mutex);
+    thresholds = msecs;
+    _changed.fetchAndStoreOrdered(1);
+    wakeUp();
+}
+
+void IdleWatch::requestWatch()
+{
+    _watching.fetchAndStoreOrdered(1);
+    QMetaObject::invokeMethod(this, "watch");
+}
+
+// stopping can't be queued, watch() keeps the thread busy,
+// a stop before the queued watch() runs is kept in _watching
+void IdleWatch::requestStop()
+{
+    _watching.fetchAndStoreOrdered(0);
+    wakeUp();
+}
+
+// async-signal and thread safe, a full pipe already wakes watch()
+void IdleWatch::wakeUp()
+{
+    if (wake[1] == -1) { return; }
+    char byte = 0;
+    ssize_t ignored = write(wake[1], &byte, 1);
+    Q_UNUSED(ignored)
+}
+
+void IdleWatch::watch()
+{
+    if (_running.fetchAndStoreOrdered(1)) { return; }
+    if (!_watching.fetchAndAddOrdered(0)) {
+        _running.fetchAndStoreOrdered(0);
+        return;
+    }
+
+    // without the pipe a stop request could never wake us up
+    Display *dpy;
+    if (wake[0] == -1 || (dpy = XOpenDisplay(NULL)) == NULL) {
+        _watching.fetchAndStoreOrdered(0);
+        _running.fetchAndStoreOrdered(0);
+        emit unavailable();
+        return;
+    }
+    int event, error, major, minor;
+    XSyncCounter counter = None;
+    if (XSyncQueryExtension(dpy, &event, &error) &&
+        XSyncInitialize(dpy, &major, &minor)) { counter = idleCounter(dpy); }
+    if (counter == None) {
+        XCloseDisplay(dpy);
+        _watching.fetchAndStoreOrdered(0);
+        _running.fetchAndStoreOrdered(0);
+        emit unavailable();
+        return;
+    }
+
+    QMap<XSyncAlarm, qint64> alarms;
+    XSyncAlarm reset = None;
+    // block on the connection and the wake pipe, requestStop() and
+    // setThresholds() update their flag before they write to the pipe
+    int fd = ConnectionNumber(dpy);
+    char drain[16];
+    while (read(wake[0], drain, sizeof(drain))>0) {}
+    _changed.fetchAndStoreOrdered(1);
+    XEvent ev;
+    while(_watching.fetchAndAddOrdered(0)) {
+        if (_changed.fetchAndStoreOrdered(0)) {
+            QList<qint64> wanted;
+            {
+                QMutexLocker lock(&mutex);
+                wanted = thresholds;
+            }
+            QMapIterator<XSyncAlarm, qint64> i(alarms);
+            while (i.hasNext()) { XSyncDestroyAlarm(dpy, i.next().key()); }
+            alarms.clear();
+            if (reset != None) { XSyncDestroyAlarm(dpy, reset); }
+            reset = None;
+
+            // a transition alarm won't fire for a threshold already
+            // passed, report those now
+            XSyncValue value;
+            qint64 current = 0;
+            if (XSyncQueryCounter(dpy, counter, &value)) {
+                current = ((qint64)XSyncValueHigh32(value)<<32)|XSyncValueLow32(value);
+            }
+            qint64 passed = 0;
+            foreach (qint64 msecs, wanted) {
+                if (msecs<=0 || alarms.values().contains(msecs)) { continue; }
+                alarms[createAlarm(dpy, counter, XSyncPositiveTransition, msecs)] = msecs;
+                if (current>=msecs) {
+                    emit idle(msecs);
+                    if (passed == 0 || msecs<passed) { passed = msecs; }
+                }
+            }
+            if (passed>0) {
+                reset = createAlarm(dpy, counter, XSyncNegativeTransition, passed-1);
+            } else { emit active(); }
+            XSync(dpy, False);
+        }
+        if (!XPending(dpy)) {
+            fd_set fds;
+            FD_ZERO(&fds);
+            FD_SET(fd, &fds);
+            FD_SET(wake[0], &fds);
+            select(qMax(fd, wake[0])+1, &fds, NULL, NULL, NULL);
+            if (FD_ISSET(wake[0], &fds)) {
+                while (read(wake[0], drain, sizeof(drain))>0) {}
+            }
+            continue;
+        }
+        XNextEvent(dpy, &ev);
+        if (ev.type != event+XSyncAlarmNotify) { continue; }
+        XSyncAlarm alarm = ((XSyncAlarmNotifyEvent*)&ev)->alarm;
+        if (alarm != None && alarm == reset) {
+            XSyncDestroyAlarm(dpy, reset);
+            reset = None;
+            emit active();
+        } else if (alarms.contains(alarm)) {
+            qint64 msecs = alarms.value(alarm);
+            emit idle(msecs);
+            // one reset alarm, at the lowest passed threshold
+            if (reset == None) {
+                reset = createAlarm(dpy, counter, XSyncNegativeTransition, msecs-1);
+                XSync(dpy, False);
+            }
+        }
+    }
+    XCloseDisplay(dpy);
+    _running.fetchAndStoreOrdered(0);
+}
@@ -0,0 +1,57 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef IDLEWATCH_H
+#define IDLEWATCH_H
+
+#include <QObject>
+#include <QThread>
+#include <QMutex>
+#include <QList>
+#include <QAtomicInt>
+
+#define IDLEWATCH_COUNTER "IDLETIME"
+
+// Idle thresholds from the XSync IDLETIME counter, the server sends
+// an alarm when a threshold is passed and when input comes after one,
+// nothing is polled. Runs in its own thread and display connection,
+// like HotPlug.
+class IdleWatch : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit IdleWatch(QObject *parent = 0);
+    ~IdleWatch();
+    void setThresholds(const QList<qint64> &msecs);
+
+private:
+    QThread t;
+    QAtomicInt _watching; // wanted, cleared by requestStop()
+    QAtomicInt _running; // watch() is in its loop
+    QAtomicInt _changed;
+    QMutex mutex;
+    QList<qint64> thresholds;
+    int wake[2]; // self-pipe, wakes watch() on a stop or new thresholds
+
+    void wakeUp();
+
+signals:
+    void idle(qint64 msecs); // idle for at least msecs
+    void active(); // input after a threshold was passed
+    void unavailable(); // no display or no IDLETIME counter
+
+public slots:
+    void requestWatch();
+    void requestStop();
+
+private slots:
+    void watch();
+};
+
+#endif // IDLEWATCH_H
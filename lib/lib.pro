@@ -19,7 +19,29 @@ SOURCES += \
     screens.cpp \
     powerkit.cpp \
     rtc.cpp \
-    common.cpp
+    common.cpp \
+    scheduler.cpp \
+    history.cpp \
+    estimator.cpp \
+    health.cpp \
+    prometheus.cpp \
+    varint.cpp \
+    policy.cpp \
+    trace.cpp \
+    clock.cpp \
+    simulator.cpp \
+    idle.cpp \
+    hotplug.cpp \
+    xstats.cpp \
+    log.cpp \
+    suspendreport.cpp \
+    maintenance.cpp \
+    idlewatch.cpp \
+    deferredjob.cpp \
+    sysfstransaction.cpp \
+    cpuprofile.cpp \
+    runtimepm.cpp \
+    probes.cpp
 HEADERS += \
     powermanagement.h \
     screensaver.h \
@@ -28,7 +50,29 @@ HEADERS += \
     screens.h \
     powerkit.h \
     rtc.h \
-    common.h
+    common.h \
+    scheduler.h \
+    history.h \
+    estimator.h \
+    health.h \
+    prometheus.h \
+    varint.h \
+    policy.h \
+    trace.h \
+    clock.h \
+    simulator.h \
+    idle.h \
+    hotplug.h \
+    xstats.h \
+    probes.h \
+    log.h \
+    suspendreport.h \
+    maintenance.h \
+    idlewatch.h \
+    deferredjob.h \
+    sysfstransaction.h \
+    cpuprofile.h \
+    runtimepm.h
 
 include(../powerkit.pri)
 CONFIG(install_lib) {
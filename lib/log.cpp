@@ -0,0 +1,124 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "log.h"
+#include "clock.h"
+
+#include <QAtomicInt>
+#include <QDateTime>
+#include <QSocketNotifier>
+
+#include <signal.h>
+#include <stdio.h>
+#include <unistd.h>
+#include <fcntl.h>
+
+#if QT_VERSION >= 0x050200
+Q_LOGGING_CATEGORY(PK_CORE, "powerkit.core")
+Q_LOGGING_CATEGORY(PK_DEVICE, "powerkit.device")
+Q_LOGGING_CATEGORY(PK_POWER, "powerkit.power")
+Q_LOGGING_CATEGORY(PK_INHIBIT, "powerkit.inhibit")
+Q_LOGGING_CATEGORY(PK_TRAY, "powerkit.tray")
+Q_LOGGING_CATEGORY(PK_SCREEN, "powerkit.screen")
+#endif
+
+struct FlightEvent
+{
+    qint64 time; // wall msecs
+    const char *name;
+    qint64 a;
+    qint64 b;
+};
+
+// a slot is valid when its stamp is the event sequence + 1,
+// 0 while it's being written
+static FlightEvent flightEvents[FLIGHT_EVENTS];
+static QAtomicInt flightStamps[FLIGHT_EVENTS];
+static QAtomicInt flightNext(0);
+static int flightPipe[2] = { -1, -1 };
+
+static void flightSignal(int)
+{
+    char c = 1;
+    ssize_t ignored = write(flightPipe[1], &c, 1);
+    Q_UNUSED(ignored)
+}
+
+void FlightRecorder::record(const char *name, qint64 a, qint64 b)
+{
+    int seq = flightNext.fetchAndAddOrdered(1);
+    int slot = seq & (FLIGHT_EVENTS-1);
+    flightStamps[slot].fetchAndStoreOrdered(0);
+    FlightEvent &event = flightEvents[slot];
+    event.time = Clock::system()->wallMsecs();
+    event.name = name;
+    event.a = a;
+    event.b = b;
+    flightStamps[slot].fetchAndStoreOrdered(seq+1);
+}
+
+// oldest first, slots overwritten while reading are skipped
+QStringList FlightRecorder::dump()
+{
+    QStringList result;
+    int next = flightNext.fetchAndAddOrdered(0);
+    int first = next>FLIGHT_EVENTS?next-FLIGHT_EVENTS:0;
+    for (int seq=first;seq<next;++seq) {
+        int slot = seq & (FLIGHT_EVENTS-1);
+        if (flightStamps[slot].fetchAndAddOrdered(0) != seq+1) { continue; }
+        FlightEvent event = flightEvents[slot];
+        if (flightStamps[slot].fetchAndAddOrdered(0) != seq+1) { continue; }
+        result << QString("%1 %2 %3 %4")
+                  .arg(QDateTime::fromMSecsSinceEpoch(event.time)
+                       .toString("yyyy-MM-ddTHH:mm:ss.zzz"))
+                  .arg(event.name)
+                  .arg(event.a)
+                  .arg(event.b);
+    }
+    return result;
+}
+
+bool FlightRecorder::watchSignal(QObject *parent)
+{
+    if (flightPipe[0] != -1) { return true; }
+    if (pipe(flightPipe) != 0) { return false; }
+    fcntl(flightPipe[0], F_SETFD, FD_CLOEXEC);
+    fcntl(flightPipe[1], F_SETFD, FD_CLOEXEC);
+    fcntl(flightPipe[1], F_SETFL, O_NONBLOCK);
+
+    struct sigaction action;
+    action.sa_handler = flightSignal;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    if (sigaction(FLIGHT_SIGNAL, &action, NULL) != 0) { return false; }
+    new FlightRecorder(flightPipe[0], parent);
+    return true;
+}
+
+FlightRecorder::FlightRecorder(int fd, QObject *parent)
+    : QObject(parent)
+    , fd(fd)
+    , notifier(0)
+{
+    notifier = new QSocketNotifier(fd, QSocketNotifier::Read, this);
+    connect(notifier, SIGNAL(activated(int)),
+            this, SLOT(handleSignal()));
+}
+
+void FlightRecorder::handleSignal()
+{
+    char c;
+    ssize_t ignored = read(fd, &c, 1);
+    Q_UNUSED(ignored)
+    QStringList events = dump();
+    fprintf(stderr, "powerkit flight recorder, %d events\n", events.size());
+    foreach (QString event, events) {
+        fprintf(stderr, "%s\n", event.toLocal8Bit().constData());
+    }
+    fflush(stderr);
+}
@@ -0,0 +1,63 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef LOG_H
+#define LOG_H
+
+#include <QObject>
+#include <QStringList>
+#include <QtGlobal>
+#include <QDebug>
+
+class QSocketNotifier;
+
+// Log categories, filter with QT_LOGGING_RULES, e.g.
+// "powerkit.tray.debug=false". Release builds compile out the debug
+// messages (QT_NO_DEBUG_OUTPUT), the disabled path is a bool check.
+#if QT_VERSION >= 0x050200
+#include <QLoggingCategory>
+Q_DECLARE_LOGGING_CATEGORY(PK_CORE)
+Q_DECLARE_LOGGING_CATEGORY(PK_DEVICE)
+Q_DECLARE_LOGGING_CATEGORY(PK_POWER)
+Q_DECLARE_LOGGING_CATEGORY(PK_INHIBIT)
+Q_DECLARE_LOGGING_CATEGORY(PK_TRAY)
+Q_DECLARE_LOGGING_CATEGORY(PK_SCREEN)
+#else
+// no categories in Qt4
+#define qCDebug(category) qDebug()
+#define qCWarning(category) qWarning()
+#endif
+
+#define FLIGHT_EVENTS 1024 // power of two
+#define FLIGHT_SIGNAL SIGUSR1
+
+// Ring buffer of the recent events, kept in release builds for
+// post-mortem context. record() is lock-free (one atomic add and two
+// stores), the name must be a string literal. Dumped over D-Bus
+// (PowerKit.FlightLog) or to stderr on SIGUSR1.
+class FlightRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    static void record(const char *name, qint64 a = 0, qint64 b = 0);
+    static QStringList dump();
+
+    // dump to stderr on FLIGHT_SIGNAL, once per process
+    static bool watchSignal(QObject *parent);
+
+private:
+    FlightRecorder(int fd, QObject *parent);
+    int fd;
+    QSocketNotifier *notifier;
+
+private slots:
+    void handleSignal();
+};
+
+#endif // LOG_H
@@ -0,0 +1,176 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "maintenance.h"
+#include "log.h"
+
+#include <QStringList>
+
+// Xlib macros clash with Qt, keep last
+#include "idle.h"
+
+Maintenance::Maintenance(PowerKit *man,
+                         PowerManagement *pm,
+                         QObject *parent)
+    : QObject(parent)
+    , man(man)
+    , pm(pm)
+    , timeout(MAINTENANCE_TIMEOUT)
+    , minBattery(MAINTENANCE_MIN_BATTERY)
+    , cookie(0)
+    , running(false)
+    , session(false)
+    , stayAwake(false)
+    , wasIdle(false)
+    , watched(false)
+    , activity(0)
+{
+    deadline.setSingleShot(true);
+    connect(&deadline, SIGNAL(timeout()),
+            this, SLOT(handleDeadline()));
+    connect(&proc, SIGNAL(finished(int)),
+            this, SLOT(handleFinished(int)));
+}
+
+Maintenance::~Maintenance()
+{
+    delete activity;
+}
+
+void Maintenance::setCommand(const QString &command)
+{
+    this->command = command;
+}
+
+void Maintenance::setTimeout(int minutes)
+{
+    timeout = minutes>0?minutes:MAINTENANCE_TIMEOUT;
+}
+
+void Maintenance::setMinBattery(int percent)
+{
+    minBattery = qBound(0, percent, 100);
+}
+
+bool Maintenance::isRunning()
+{
+    return running;
+}
+
+void Maintenance::run()
+{
+    if (running) { return; }
+    awake.start();
+    session = true;
+    stayAwake = false;
+    wasIdle = false;
+    watched = false;
+    QProcess::startDetached(MAINTENANCE_DISPLAY_OFF);
+    if (command.isEmpty()) {
+        done();
+        return;
+    }
+    if (man->OnBattery() && man->BatteryLeft()<minBattery) {
+        qCDebug(PK_POWER) << "skip maintenance, battery below" << minBattery;
+        FlightRecorder::record("maintenance_skipped", (qint64)man->BatteryLeft());
+        done();
+        return;
+    }
+    qCDebug(PK_POWER) << "run maintenance" << command << "deadline" << timeout << "min";
+    FlightRecorder::record("maintenance_start");
+    if (activity == NULL) {
+        activity = new IdleWatch();
+        connect(activity, SIGNAL(idle(qint64)),
+                this, SLOT(handleIdle()));
+        connect(activity, SIGNAL(active()),
+                this, SLOT(handleActivity()));
+        connect(activity, SIGNAL(unavailable()),
+                this, SLOT(handleUnavailable()));
+        activity->setThresholds(QList<qint64>() << MAINTENANCE_ACTIVITY);
+    }
+    watched = true;
+    activity->requestWatch();
+    running = true;
+    cookie = pm->Inhibit("powerkit", "maintenance");
+    deadline.start(timeout*60000);
+    proc.start("/bin/sh", QStringList() << "-c" << command);
+    if (!proc.waitForStarted()) {
+        qCWarning(PK_POWER) << "failed to start maintenance" << command;
+        handleFinished(-1);
+    }
+}
+
+void Maintenance::handleFinished(int exitCode)
+{
+    if (!running) { return; }
+    qCDebug(PK_POWER) << "maintenance done" << exitCode;
+    FlightRecorder::record("maintenance_done", exitCode);
+    running = false;
+    deadline.stop();
+    pm->UnInhibit(cookie);
+    done();
+}
+
+void Maintenance::handleDeadline()
+{
+    if (!running) { return; }
+    qCWarning(PK_POWER) << "maintenance deadline reached, stopping" << command;
+    proc.terminate();
+    if (!proc.waitForFinished(MAINTENANCE_KILL_WAIT)) {
+        proc.kill();
+        proc.waitForFinished(MAINTENANCE_KILL_WAIT);
+    }
+    // finished() may not have been delivered
+    handleFinished(-1);
+}
+
+// back to sleep, unless someone started using the machine.
+// without IDLETIME we can only check for input since the wakeup
+void Maintenance::done()
+{
+    if (!session) { return; }
+    session = false;
+    if (activity) { activity->requestStop(); }
+    if (!watched) {
+        qint64 idle = Idle::msecs();
+        if (idle>=0 && idle<awake.elapsed()) { setUserActive(); }
+    }
+    if (stayAwake) {
+        qCDebug(PK_POWER) << "user activity during maintenance, stay awake";
+        return;
+    }
+    man->Suspend();
+}
+
+// the job keeps running under its inhibit, only the suspend is dropped
+void Maintenance::setUserActive()
+{
+    if (stayAwake) { return; }
+    stayAwake = true;
+    FlightRecorder::record("maintenance_user_active");
+    emit userActive();
+}
+
+void Maintenance::handleUnavailable()
+{
+    watched = false;
+}
+
+void Maintenance::handleIdle()
+{
+    wasIdle = true;
+}
+
+// the lid or a key press that woke the machine is not the user
+// using it, wait for input after MAINTENANCE_ACTIVITY of quiet
+void Maintenance::handleActivity()
+{
+    if (!session || !wasIdle) { return; }
+    qCDebug(PK_POWER) << "user activity during maintenance";
+    setUserActive();
+}
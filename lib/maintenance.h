@@ -0,0 +1,83 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef MAINTENANCE_H
+#define MAINTENANCE_H
+
+#include <QObject>
+#include <QProcess>
+#include <QString>
+#include <QTimer>
+#include <QElapsedTimer>
+
+#include "powerkit.h"
+#include "powermanagement.h"
+#include "idlewatch.h"
+
+#define MAINTENANCE_TIMEOUT 30 // minutes
+#define MAINTENANCE_MIN_BATTERY 30 // %
+#define MAINTENANCE_KILL_WAIT 5000 // ms after terminate
+#define MAINTENANCE_DISPLAY_OFF "xset dpms force off"
+#define MAINTENANCE_ACTIVITY 1000 // ms idle, input after that is the user
+
+// Runs the maintenance job after a scheduled wake (see
+// PowerKit::MaintenanceWakeup), then suspends again.
+//
+// The job runs under a PowerManagement inhibit with the display off
+// and is killed at the deadline. Skipped below the battery threshold.
+// Input during the job (seen through IdleWatch) cancels the suspend,
+// userActive() is emitted so the normal resume handling can run.
+class Maintenance : public QObject
+{
+    Q_OBJECT
+
+public:
+    Maintenance(PowerKit *man,
+                PowerManagement *pm,
+                QObject *parent = NULL);
+    ~Maintenance();
+    void setCommand(const QString &command);
+    void setTimeout(int minutes);
+    void setMinBattery(int percent);
+    bool isRunning();
+
+signals:
+    void userActive();
+
+private:
+    PowerKit *man;
+    PowerManagement *pm;
+    QProcess proc;
+    QTimer deadline;
+    QElapsedTimer awake;
+    QString command;
+    int timeout;
+    int minBattery;
+    quint32 cookie;
+    bool running;
+    bool session; // between run() and done()
+    bool stayAwake;
+    bool wasIdle; // input only counts after a quiet period
+    bool watched; // IdleWatch running with IDLETIME, see done()
+    IdleWatch *activity;
+
+    void done();
+    void setUserActive();
+
+public slots:
+    void run();
+
+private slots:
+    void handleFinished(int exitCode);
+    void handleDeadline();
+    void handleIdle();
+    void handleActivity();
+    void handleUnavailable();
+};
+
+#endif // MAINTENANCE_H
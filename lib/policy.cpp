@@ -0,0 +1,380 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "policy.h"
+#include "common.h"
+#include "def.h"
+
+#include <QStringList>
+#include <QMapIterator>
+
+PowerSettings::PowerSettings()
+    : autoSuspendBattery(AUTO_SLEEP_BATTERY)
+    , autoSuspendAC(0)
+    , autoSuspendBatteryAction(DEFAULT_SUSPEND_BATTERY_ACTION)
+    , autoSuspendACAction(DEFAULT_SUSPEND_AC_ACTION)
+    , lowBattery(LOW_BATTERY)
+    , criticalBattery(CRITICAL_BATTERY)
+    , criticalAction(CRITICAL_DEFAULT)
+    , lidActionBattery(LID_BATTERY_DEFAULT)
+    , lidActionAC(LID_AC_DEFAULT)
+    , disableLidOnExternalMonitors(false)
+    , warnOnLowBattery(true)
+    , warnOnVeryLowBattery(true)
+    , notifyOnBattery(true)
+    , notifyOnAC(true)
+    , backlightOnBattery(false)
+    , backlightOnAC(false)
+    , backlightBatteryValue(0)
+    , backlightACValue(0)
+    , backlightBatteryDisableIfLower(false)
+    , backlightACDisableIfHigher(false)
+{
+}
+
+PowerSettings PowerSettings::load()
+{
+    PowerSettings result;
+    QVariantMap map;
+    QStringList keys = result.toMap().keys();
+    foreach (QString key, keys) {
+        if (Common::validPowerSettings(key)) {
+            map[key] = Common::loadPowerSettings(key);
+        }
+    }
+    return fromMap(map);
+}
+
+QVariantMap PowerSettings::toMap() const
+{
+    QVariantMap result;
+    result[CONF_SUSPEND_BATTERY_TIMEOUT] = autoSuspendBattery;
+    result[CONF_SUSPEND_AC_TIMEOUT] = autoSuspendAC;
+    result[CONF_SUSPEND_BATTERY_ACTION] = autoSuspendBatteryAction;
+    result[CONF_SUSPEND_AC_ACTION] = autoSuspendACAction;
+    result[CONF_CRITICAL_BATTERY_TIMEOUT] = criticalBattery;
+    result[CONF_CRITICAL_BATTERY_ACTION] = criticalAction;
+    result[CONF_LID_BATTERY_ACTION] = lidActionBattery;
+    result[CONF_LID_AC_ACTION] = lidActionAC;
+    result[CONF_LID_DISABLE_IF_EXTERNAL] = disableLidOnExternalMonitors;
+    result[CONF_WARN_ON_LOW_BATTERY] = warnOnLowBattery;
+    result[CONF_WARN_ON_VERYLOW_BATTERY] = warnOnVeryLowBattery;
+    result[CONF_NOTIFY_ON_BATTERY] = notifyOnBattery;
+    result[CONF_NOTIFY_ON_AC] = notifyOnAC;
+    result[CONF_BACKLIGHT_BATTERY_ENABLE] = backlightOnBattery;
+    result[CONF_BACKLIGHT_AC_ENABLE] = backlightOnAC;
+    result[CONF_BACKLIGHT_BATTERY] = backlightBatteryValue;
+    result[CONF_BACKLIGHT_AC] = backlightACValue;
+    result[CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER] = backlightBatteryDisableIfLower;
+    result[CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER] = backlightACDisableIfHigher;
+    result[CONF_BATTERY_SAVER] = batterySaver;
+    return result;
+}
+
+// missing keys keep the default value
+PowerSettings PowerSettings::fromMap(const QVariantMap &map)
+{
+    PowerSettings result;
+    QVariantMap values = result.toMap();
+    QMapIterator<QString, QVariant> i(map);
+    while (i.hasNext()) {
+        i.next();
+        values[i.key()] = i.value();
+    }
+    result.autoSuspendBattery = values.value(CONF_SUSPEND_BATTERY_TIMEOUT).toInt();
+    result.autoSuspendAC = values.value(CONF_SUSPEND_AC_TIMEOUT).toInt();
+    result.autoSuspendBatteryAction = values.value(CONF_SUSPEND_BATTERY_ACTION).toInt();
+    result.autoSuspendACAction = values.value(CONF_SUSPEND_AC_ACTION).toInt();
+    result.criticalBattery = values.value(CONF_CRITICAL_BATTERY_TIMEOUT).toInt();
+    result.criticalAction = values.value(CONF_CRITICAL_BATTERY_ACTION).toInt();
+    result.lidActionBattery = values.value(CONF_LID_BATTERY_ACTION).toInt();
+    result.lidActionAC = values.value(CONF_LID_AC_ACTION).toInt();
+    result.disableLidOnExternalMonitors = values.value(CONF_LID_DISABLE_IF_EXTERNAL).toBool();
+    result.warnOnLowBattery = values.value(CONF_WARN_ON_LOW_BATTERY).toBool();
+    result.warnOnVeryLowBattery = values.value(CONF_WARN_ON_VERYLOW_BATTERY).toBool();
+    result.notifyOnBattery = values.value(CONF_NOTIFY_ON_BATTERY).toBool();
+    result.notifyOnAC = values.value(CONF_NOTIFY_ON_AC).toBool();
+    result.backlightOnBattery = values.value(CONF_BACKLIGHT_BATTERY_ENABLE).toBool();
+    result.backlightOnAC = values.value(CONF_BACKLIGHT_AC_ENABLE).toBool();
+    result.backlightBatteryValue = values.value(CONF_BACKLIGHT_BATTERY).toInt();
+    result.backlightACValue = values.value(CONF_BACKLIGHT_AC).toInt();
+    result.backlightBatteryDisableIfLower = values.value(CONF_BACKLIGHT_BATTERY_DISABLE_IF_LOWER).toBool();
+    result.backlightACDisableIfHigher = values.value(CONF_BACKLIGHT_AC_DISABLE_IF_HIGHER).toBool();
+    result.batterySaver = values.value(CONF_BATTERY_SAVER).toString();
+    return result;
+}
+
+Policy::Policy(const PowerSettings &settings, Clock *clock)
+    : config(settings)
+    , clock(clock?clock:Clock::system())
+    , idleSince(0)
+    , lidWasClosed(false)
+    , wasLowBattery(false)
+    , wasVeryLowBattery(false)
+    , saverLimit(100)
+{
+    idleSince = this->clock->monotonicMsecs();
+}
+
+void Policy::setSettings(const PowerSettings &settings)
+{
+    config = settings;
+}
+
+const PowerSettings &Policy::settings() const
+{
+    return config;
+}
+
+void Policy::setClock(Clock *clock)
+{
+    this->clock = clock?clock:Clock::system();
+    resetIdle();
+}
+
+Policy::Actions Policy::lidClosed(bool onBattery, bool externalMonitor)
+{
+    Actions result;
+    lidWasClosed = true;
+
+    if (config.disableLidOnExternalMonitors && externalMonitor) {
+        result << Action(ActionMonitorOff);
+        return result;
+    }
+
+    switch(onBattery?config.lidActionBattery:config.lidActionAC) {
+    case lidLock:
+        result << Action(ActionLock);
+        break;
+    case lidSleep:
+        result << Action(ActionSuspend);
+        break;
+    case lidHibernate:
+        result << Action(ActionHibernate);
+        break;
+    case lidShutdown:
+        result << Action(ActionPowerOff);
+        break;
+    case lidHybridSleep:
+        result << Action(ActionHybridSleep);
+        break;
+    default: ;
+    }
+    return result;
+}
+
+Policy::Actions Policy::lidOpened()
+{
+    Actions result;
+    lidWasClosed = false;
+    if (config.disableLidOnExternalMonitors) {
+        result << Action(ActionMonitorOn);
+    }
+    return result;
+}
+
+// 'backlight' is the current brightness, -1 if not adjustable
+Policy::Actions Policy::switchedToBattery(int backlight)
+{
+    Actions result;
+    if (config.notifyOnBattery) { result << Action(ActionNotifyBattery); }
+    if (backlight>=0 &&
+        config.backlightOnBattery &&
+        config.backlightBatteryValue>0) {
+        if (config.backlightBatteryDisableIfLower &&
+            config.backlightBatteryValue>backlight) { return result; }
+        result << Action(ActionBacklight, config.backlightBatteryValue);
+    }
+    return result;
+}
+
+Policy::Actions Policy::switchedToAC(int backlight)
+{
+    Actions result;
+    if (config.notifyOnAC) { result << Action(ActionNotifyAC); }
+    wasLowBattery = false;
+    wasVeryLowBattery = false;
+    if (backlight>=0 &&
+        config.backlightOnAC &&
+        config.backlightACValue>0) {
+        if (config.backlightACDisableIfHigher &&
+            config.backlightACValue<backlight) { return result; }
+        result << Action(ActionBacklight, config.backlightACValue);
+    }
+    return result;
+}
+
+// called once every IDLE_TIMEOUT, time since the last reset
+// and idle must be >= user value and no inhibitors before suspend
+Policy::Actions Policy::idle(int idleMinutes, bool onBattery, bool inhibited)
+{
+    Actions result;
+    int autoSuspend = onBattery?config.autoSuspendBattery:config.autoSuspendAC;
+    int autoSuspendAction = onBattery?config.autoSuspendBatteryAction:config.autoSuspendACAction;
+
+    if (autoSuspend<=0 ||
+        timeouts()<autoSuspend ||
+        idleMinutes<autoSuspend ||
+        inhibited) { return result; }
+    resetIdle();
+    switch (autoSuspendAction) {
+    case suspendSleep:
+        result << Action(ActionSuspend);
+        break;
+    case suspendHibernate:
+        result << Action(ActionHibernate);
+        break;
+    case suspendShutdown:
+        result << Action(ActionPowerOff);
+        break;
+    case suspendHybrid:
+        result << Action(ActionHybridSleep);
+        break;
+    default: break;
+    }
+    return result;
+}
+
+// low/very low warnings and the critical action.
+// the critical action is queued early enough to finish before the
+// predicted critical level, a re-check is requested just before that
+// moment in case upower is slow to update. the time to empty is
+// recorded in traces but doesn't trigger anything on its own.
+Policy::Actions Policy::battery(double left,
+                                bool onBattery,
+                                qlonglong timeToEmpty,
+                                qlonglong timeToCritical)
+{
+    Q_UNUSED(timeToEmpty)
+    Actions result;
+    int limit = batterySaverLimit(left, onBattery);
+    if (limit != saverLimit) {
+        saverLimit = limit;
+        result << Action(ActionCpuLimit, limit);
+    }
+    if (!onBattery) {
+        result << Action(ActionCancelRecheck);
+        return result;
+    }
+
+    if (config.warnOnLowBattery &&
+        !wasLowBattery &&
+        left<=(double)(config.lowBattery+config.criticalBattery)) {
+        result << Action(ActionWarnLow, left);
+        wasLowBattery = true;
+    }
+    if (config.warnOnVeryLowBattery &&
+        !wasVeryLowBattery &&
+        left<=(double)(config.criticalBattery+1)) {
+        result << Action(ActionWarnVeryLow, left);
+        wasVeryLowBattery = true;
+    }
+
+    if (left<=0) {
+        result << Action(ActionCancelRecheck);
+        return result;
+    }
+    int lead = criticalActionLead();
+    bool predicted = timeToCritical>=0 && timeToCritical<=lead;
+    if (left>(double)config.criticalBattery && !predicted) {
+        if (timeToCritical>0) {
+            qlonglong wait = timeToCritical-lead-CRITICAL_RECHECK_MARGIN;
+            if (wait<CRITICAL_RECHECK_MARGIN) { wait = CRITICAL_RECHECK_MARGIN; }
+            if (wait>86400) { wait = 86400; }
+            result << Action(ActionRecheck, wait);
+        }
+        return result;
+    }
+    result << Action(ActionCancelRecheck);
+    switch(config.criticalAction) {
+    case criticalHibernate:
+        result << Action(ActionHibernate);
+        break;
+    case criticalShutdown:
+        result << Action(ActionPowerOff);
+        break;
+    default: ;
+    }
+    return result;
+}
+
+// the lowest cap of the bands the battery is in. a band is entered
+// at its level and left BATTERY_SAVER_HYSTERESIS over it, so a
+// battery going up and down around a band doesn't switch each time
+int Policy::batterySaverLimit(double left, bool onBattery) const
+{
+    int result = 100;
+    if (!onBattery || config.batterySaver.isEmpty()) { return result; }
+    foreach (QString band, config.batterySaver.split(",", QString::SkipEmptyParts)) {
+        QStringList values = band.split(":");
+        if (values.size() != 2) { continue; }
+        int level = values.at(0).trimmed().toInt();
+        int cap = qBound(1, values.at(1).trimmed().toInt(), 100);
+        if (level<=0) { continue; }
+        if (saverLimit<=cap) { level += BATTERY_SAVER_HYSTERESIS; }
+        if (left<=(double)level && cap<result) { result = cap; }
+    }
+    return result;
+}
+
+int Policy::cpuLimit() const
+{
+    return saverLimit;
+}
+
+void Policy::resetIdle()
+{
+    idleSince = clock->monotonicMsecs();
+}
+
+// idle timeouts (minutes) since the last reset
+int Policy::timeouts() const
+{
+    return (int)((clock->monotonicMsecs()-idleSince)/IDLE_TIMEOUT);
+}
+
+bool Policy::isLidClosed() const
+{
+    return lidWasClosed;
+}
+
+// seconds the critical action needs to complete
+int Policy::criticalActionLead() const
+{
+    switch(config.criticalAction) {
+    case criticalHibernate:
+        return CRITICAL_HIBERNATE_LEAD;
+    case criticalShutdown:
+        return CRITICAL_SHUTDOWN_LEAD;
+    default:;
+    }
+    return 0;
+}
+
+QString Policy::actionName(int type)
+{
+    switch(type) {
+    case ActionLock: return "lock";
+    case ActionSuspend: return "suspend";
+    case ActionHibernate: return "hibernate";
+    case ActionPowerOff: return "poweroff";
+    case ActionHybridSleep: return "hybridsleep";
+    case ActionWarnLow: return "warn_low";
+    case ActionWarnVeryLow: return "warn_very_low";
+    case ActionNotifyBattery: return "notify_battery";
+    case ActionNotifyAC: return "notify_ac";
+    case ActionBacklight: return "backlight";
+    case ActionMonitorOn: return "monitor_on";
+    case ActionMonitorOff: return "monitor_off";
+    case ActionRecheck: return "recheck";
+    case ActionCancelRecheck: return "cancel_recheck";
+    case ActionCpuLimit: return "cpu_limit";
+    default:;
+    }
+    return "none";
+}
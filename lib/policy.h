@@ -0,0 +1,122 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef POLICY_H
+#define POLICY_H
+
+#include <QList>
+#include <QString>
+#include <QVariantMap>
+
+#include "clock.h"
+
+// the settings the power policy depends on
+struct PowerSettings
+{
+    PowerSettings();
+    static PowerSettings load();
+    QVariantMap toMap() const;
+    static PowerSettings fromMap(const QVariantMap &map);
+
+    int autoSuspendBattery; // minutes
+    int autoSuspendAC;
+    int autoSuspendBatteryAction;
+    int autoSuspendACAction;
+    int lowBattery; // % over critical
+    int criticalBattery;
+    int criticalAction;
+    int lidActionBattery;
+    int lidActionAC;
+    bool disableLidOnExternalMonitors;
+    bool warnOnLowBattery;
+    bool warnOnVeryLowBattery;
+    bool notifyOnBattery;
+    bool notifyOnAC;
+    bool backlightOnBattery;
+    bool backlightOnAC;
+    int backlightBatteryValue;
+    int backlightACValue;
+    bool backlightBatteryDisableIfLower;
+    bool backlightACDisableIfHigher;
+    QString batterySaver; // "30:70,15:50", below battery % cap cpu frequency %
+};
+
+// Power policy.
+//
+// The decisions the tray makes on power events (lid, AC, idle, battery
+// level), without any side effects: each event returns the actions to
+// take and the caller executes them. The tray, trace replay and tests
+// all run the same code.
+class Policy
+{
+public:
+    enum ActionType {
+        ActionNone,
+        ActionLock,
+        ActionSuspend,
+        ActionHibernate,
+        ActionPowerOff,
+        ActionHybridSleep,
+        ActionWarnLow,
+        ActionWarnVeryLow,
+        ActionNotifyBattery,
+        ActionNotifyAC,
+        ActionBacklight,
+        ActionMonitorOn,
+        ActionMonitorOff,
+        ActionRecheck, // evaluate battery again in 'value' seconds
+        ActionCancelRecheck,
+        ActionCpuLimit // max cpu frequency %, 100 lifts the cap
+    };
+
+    struct Action
+    {
+        Action(int type = ActionNone, double value = 0) : type(type), value(value) {}
+        int type;
+        double value;
+    };
+    typedef QList<Action> Actions;
+
+    explicit Policy(const PowerSettings &settings = PowerSettings(),
+                    Clock *clock = NULL);
+
+    void setSettings(const PowerSettings &settings);
+    const PowerSettings &settings() const;
+    void setClock(Clock *clock);
+
+    Actions lidClosed(bool onBattery, bool externalMonitor);
+    Actions lidOpened();
+    Actions switchedToBattery(int backlight);
+    Actions switchedToAC(int backlight);
+    Actions idle(int idleMinutes, bool onBattery, bool inhibited);
+    Actions battery(double left,
+                    bool onBattery,
+                    qlonglong timeToEmpty,
+                    qlonglong timeToCritical);
+    void resetIdle();
+
+    int timeouts() const;
+    bool isLidClosed() const;
+    int criticalActionLead() const;
+    int cpuLimit() const;
+
+    static QString actionName(int type);
+
+private:
+    PowerSettings config;
+    Clock *clock;
+    qint64 idleSince; // monotonic msecs
+    bool lidWasClosed;
+    bool wasLowBattery;
+    bool wasVeryLowBattery;
+    int saverLimit;
+
+    int batterySaverLimit(double left, bool onBattery) const;
+};
+
+#endif // POLICY_H
@@ -8,6 +8,12 @@
 
 #include "powerkit.h"
 #include "def.h"
+#include "scheduler.h"
+#include "xstats.h"
+#include "probes.h"
+#include "log.h"
+#include "cpuprofile.h"
+#include "runtimepm.h"
 
 #include <QDBusInterface>
 #include <QDBusMessage>
@@ -17,32 +23,86 @@
 #include <QMapIterator>
 #include <QDebug>
 #include <QDBusReply>
+#include <QElapsedTimer>
+
+// counts and times a blocking d-bus call for the stats
+class CallTimer
+{
+public:
+    CallTimer(QMap<QString, qlonglong> *count,
+              QMap<QString, qlonglong> *time,
+              const QString &method)
+        : count(count)
+        , time(time)
+        , method(method)
+    {
+        timer.start();
+    }
+    ~CallTimer()
+    {
+        (*count)[method]++;
+        (*time)[method] += timer.nsecsElapsed()/1000;
+    }
+private:
+    QMap<QString, qlonglong> *count;
+    QMap<QString, qlonglong> *time;
+    QString method;
+    QElapsedTimer timer;
+};
 
 PowerKit::PowerKit(QObject *parent) : QObject(parent)
   , upower(0)
   , logind(0)
   , ckit(0)
   , pmd(0)
+  , watcher(0)
+  , reconnectTask(-1)
+  , recording(false)
+  , clock(Clock::system())
   , wasDocked(false)
   , wasLidClosed(false)
   , wasOnBattery(false)
   , wakeAlarm(false)
+  , suspends(0)
+  , resumes(0)
+  , suspendSeconds(0)
+  , lastSuspendSeconds(0)
+  , deviceReads(0)
+  , deviceReadTime(0)
   , suspendWakeupBattery(0)
   , suspendWakeupAC(0)
+  , suspendWakeupAuto(false)
+  , suspendWakeupReserve(SUSPEND_WAKEUP_RESERVE)
   , lockScreenOnSuspend(true)
   , lockScreenOnResume(false)
+  , cpuLimit(100)
+  , runtimePM(false)
+  , jobWatcher(0)
+  , idleWatch(0)
+  , idleMsecs(0)
 {
+    // only poll while the system bus is gone, service
+    // changes are picked up by the watcher in setup()
+    reconnectTask = Scheduler::global()->addTask(this,
+                                                 "check",
+                                                 TIMEOUT_RECONNECT,
+                                                 false);
     setup();
-    timer.setInterval(TIMEOUT_CHECK);
-    connect(&timer, SIGNAL(timeout()),
-            this, SLOT(check()));
-    timer.start();
+    if (!QDBusConnection::systemBus().isConnected()) {
+        Scheduler::global()->setTaskActive(reconnectTask, true);
+    }
+    // the cached power source is used by the snapshot and deferred jobs
+    if (upower && upower->isValid()) { wasOnBattery = OnBattery(); }
+    connect(this, SIGNAL(UpdatedDevices()),
+            this, SLOT(updateJobs()));
 }
 
 PowerKit::~PowerKit()
 {
     clearDevices();
     releaseSuspendLock();
+    qDeleteAll(history);
+    delete idleWatch;
 }
 
 QMap<QString, Device *> PowerKit::getDevices()
@@ -50,10 +110,42 @@ QMap<QString, Device *> PowerKit::getDevices()
     return devices;
 }
 
+BatteryHistory *PowerKit::getHistory(const QString &device)
+{
+    if (!history.contains(device)) { return NULL; }
+    return history[device];
+}
+
+// only one process (the session) should write history and health
+void PowerKit::setRecording(bool enabled)
+{
+    recording = enabled;
+    suspendReport.setSaving(enabled);
+}
+
+void PowerKit::setClock(Clock *clock)
+{
+    this->clock = clock?clock:Clock::system();
+    suspendReport.setClock(this->clock);
+    health.setClock(this->clock);
+}
+
+bool PowerKit::hasSuspendLock()
+{
+    return !suspendLock.isNull();
+}
+
+// resume stages outside the library (tray drawn)
+void PowerKit::resumeReady(SuspendReport::Stage stage)
+{
+    suspendReport.ready(stage);
+}
+
 bool PowerKit::availableService(const QString &service,
                           const QString &path,
                           const QString &interface)
 {
+    CallTimer call(&callCount, &callTime, "Introspect");
     QDBusInterface iface(service,
                          path,
                          interface,
@@ -110,6 +202,7 @@ bool PowerKit::availableAction(const PowerKit::PKMethod &method,
     default:
         return false;
     }
+    CallTimer call(&callCount, &callTime, cmd);
     QDBusInterface iface(service, path, interface,
                          QDBusConnection::systemBus());
     if (!iface.isValid()) { return false; }
@@ -162,27 +255,40 @@ QString PowerKit::executeAction(const PowerKit::PKAction &action,
     default:
         return QObject::tr(PK_NO_ACTION);
     }
+    PK_PROBE2(action_dispatch, (int)action, (int)backend);
+    CallTimer call(&callCount, &callTime, cmd);
     QDBusInterface iface(service, path, interface,
                          QDBusConnection::systemBus());
-    if (!iface.isValid()) { return QObject::tr(DBUS_FAILED_CONN); }
+    if (!iface.isValid()) {
+        PK_PROBE3(action_reply, (int)action, (int)backend, DBUS_FAILED_CONN);
+        FlightRecorder::record("action_failed", action, backend);
+        return QObject::tr(DBUS_FAILED_CONN);
+    }
 
     QDBusMessage reply;
     if (backend == PKUPower) { reply = iface.call(cmd); }
     else { reply = iface.call(cmd, true); }
 
+    if (PK_PROBE_ENABLED(action_reply)) {
+        PK_PROBE3(action_reply, (int)action, (int)backend,
+                  reply.errorMessage().toUtf8().constData());
+    }
+    FlightRecorder::record(reply.errorMessage().isEmpty()?"action":"action_failed",
+                           action, backend);
     return reply.errorMessage();
 }
 
 QStringList PowerKit::find()
 {
     QStringList result;
+    CallTimer timer(&callCount, &callTime, "Introspect");
     QDBusMessage call = QDBusMessage::createMethodCall(UPOWER_SERVICE,
                                                        QString("%1/devices").arg(UPOWER_PATH),
                                                        DBUS_INTROSPECTABLE,
                                                        "Introspect");
     QDBusPendingReply<QString> reply = QDBusConnection::systemBus().call(call);
     if (reply.isError()) {
-        qWarning() << "powerkit find devices failed, check the upower service!!!";
+        qCWarning(PK_DEVICE) << "powerkit find devices failed, check the upower service!!!";
         return result;
     }
     QList<QDBusObjectPath> objects;
@@ -294,6 +400,26 @@ void PowerKit::setup()
                                      system,
                                      this);
         }
+        if (watcher == NULL) {
+            watcher = new QDBusServiceWatcher(this);
+            watcher->setConnection(system);
+            watcher->setWatchMode(QDBusServiceWatcher::WatchForRegistration|
+                                  QDBusServiceWatcher::WatchForUnregistration);
+            watcher->addWatchedService(UPOWER_SERVICE);
+            watcher->addWatchedService(LOGIND_SERVICE);
+            watcher->addWatchedService(CONSOLEKIT_SERVICE);
+            watcher->addWatchedService(PMD_SERVICE);
+            connect(watcher, SIGNAL(serviceRegistered(QString)),
+                    this, SLOT(handleServiceRegistered(QString)));
+            connect(watcher, SIGNAL(serviceUnregistered(QString)),
+                    this, SLOT(handleServiceUnregistered(QString)));
+            system.connect(QString(),
+                           DBUS_LOCAL_PATH,
+                           DBUS_LOCAL_INTERFACE,
+                           DBUS_LOCAL_DISCONNECTED,
+                           this,
+                           SLOT(handleDisconnected()));
+        }
         if (!suspendLock) { registerSuspendLock(); }
         scan();
     }
@@ -305,10 +431,40 @@ void PowerKit::check()
         setup();
         return;
     }
+    Scheduler::global()->setTaskActive(reconnectTask, false);
     if (!suspendLock) { registerSuspendLock(); }
     if (!upower->isValid()) { scan(); }
 }
 
+void PowerKit::handleServiceRegistered(const QString &service)
+{
+    qCDebug(PK_CORE) << "service registered" << service;
+    if (service == UPOWER_SERVICE) { scan(); }
+    else if (service == LOGIND_SERVICE ||
+             service == CONSOLEKIT_SERVICE) {
+        if (!suspendLock) { registerSuspendLock(); }
+    }
+}
+
+void PowerKit::handleServiceUnregistered(const QString &service)
+{
+    qCDebug(PK_CORE) << "service unregistered" << service;
+    if (service == UPOWER_SERVICE) {
+        clearDevices();
+        emit UpdatedDevices();
+    } else if (service == LOGIND_SERVICE ||
+               service == CONSOLEKIT_SERVICE) {
+        releaseSuspendLock(); // lock is useless without the service
+    }
+}
+
+void PowerKit::handleDisconnected()
+{
+    qCWarning(PK_CORE) << "lost connection to the system bus";
+    releaseSuspendLock();
+    Scheduler::global()->setTaskActive(reconnectTask, true);
+}
+
 void PowerKit::scan()
 {
     QStringList foundDevices = find();
@@ -351,7 +507,10 @@ void PowerKit::deviceRemoved(const QString &path)
     if (path.startsWith(QString(DBUS_JOBS).arg(UPOWER_PATH))) { return; }
     if (deviceExists) {
         if (find().contains(path)) { return; }
-        delete devices.take(path);
+        Device *device = devices.take(path);
+        deviceReads += device->propertyReads;
+        deviceReadTime += device->propertyReadTime;
+        delete device;
         emit DeviceWasRemoved(path);
     }
     scan();
@@ -361,8 +520,12 @@ void PowerKit::deviceChanged()
 {
     if (wasLidClosed != LidIsClosed()) {
         if (!wasLidClosed && LidIsClosed()) {
+            PK_PROBE(lid_closed);
+            FlightRecorder::record("lid_closed");
             emit LidClosed();
         } else if (wasLidClosed && !LidIsClosed()) {
+            PK_PROBE(lid_opened);
+            FlightRecorder::record("lid_opened");
             emit LidOpened();
         }
     }
@@ -370,8 +533,10 @@ void PowerKit::deviceChanged()
 
     if (wasOnBattery != OnBattery()) {
         if (!wasOnBattery && OnBattery()) {
+            FlightRecorder::record("on_battery");
             emit SwitchedToBattery();
         } else if (wasOnBattery && !OnBattery()) {
+            FlightRecorder::record("on_ac");
             emit SwitchedToAC();
         }
     }
@@ -384,62 +549,183 @@ void PowerKit::handleDeviceChanged(const QString &device)
 {
     if (device.isEmpty()) { return; }
     deviceChanged();
+    if (devices.contains(device)) {
+        recordHistory(devices[device]);
+        if (devices[device]->isBattery) {
+            updateEstimator();
+            // the drain sample, if upower was stale at resume
+            suspendReport.resumedEnergy(wasOnBattery?BatteryEnergy():-1);
+        }
+    }
 }
 
 void PowerKit::handleResume()
 {
     if (HasLogind() || HasConsoleKit()) { return; }
-    qDebug() << "handle resume from upower";
+    qCDebug(PK_POWER) << "handle resume from upower";
     handlePrepareForSuspend(false);
 }
 
 void PowerKit::handleSuspend()
 {
     if (HasLogind() || HasConsoleKit()) { return; }
-    qDebug() << "handle suspend from upower";
+    qCDebug(PK_POWER) << "handle suspend from upower";
     if (lockScreenOnSuspend) { LockScreen(); }
+    suspendStarted();
     emit PrepareForSuspend();
 }
 
 void PowerKit::handlePrepareForSuspend(bool prepare)
 {
-    qDebug() << "handle prepare for suspend/resume from consolekit/logind" << prepare;
+    qCDebug(PK_POWER) << "handle prepare for suspend/resume from consolekit/logind" << prepare;
+    PK_PROBE1(prepare_for_suspend, (int)prepare);
+    FlightRecorder::record("prepare_for_suspend", prepare);
     if (prepare) {
+        suspendStarted();
         if (lockScreenOnSuspend) { LockScreen(); }
         emit PrepareForSuspend();
         releaseSuspendLock(); // we are ready for suspend
     }
     else { // resume
-        UpdateDevices();
-        if (lockScreenOnResume) { LockScreen(); }
-        if (hasWakeAlarm() &&
-             wakeAlarmDate.isValid() &&
-             CanHibernate())
-        {
-            qDebug() << "we may have a wake alarm" << wakeAlarmDate;
-            QDateTime currentDate = QDateTime::currentDateTime();
+        // by priority: the wake alarm hibernate and the lock first,
+        // then the battery. other devices and the delay lock after the
+        // event loop has run (resumeDevices).
+        // the alarm is only set if we could hibernate, no need to ask again
+        resumed();
+        if (hasWakeAlarm() && wakeAlarmDate.isValid()) {
+            qCDebug(PK_POWER) << "we may have a wake alarm" << wakeAlarmDate;
+            QDateTime currentDate = clock->currentDateTime();
             if (currentDate>=wakeAlarmDate && wakeAlarmDate.secsTo(currentDate)<300) {
-                qDebug() << "wake alarm is active, that means we should hibernate";
+                qCDebug(PK_POWER) << "wake alarm is active, that means we should hibernate";
                 clearWakeAlarm();
+                resumeBattery(); // drain sample for the automatic wake alarm
+                registerSuspendLock(); // the lock before hibernate
                 Hibernate();
                 return;
             }
         }
-        clearWakeAlarm();
-        emit PrepareForResume();
+        // scheduled maintenance, the hibernate alarm is kept and
+        // replaced on the next suspend. an early wake leaves the
+        // maintenance alarm queued, it may still need a cancel
+        bool maintenance = false;
+        if (maintenanceDate.isValid()) {
+            QDateTime currentDate = clock->currentDateTime();
+            maintenance = currentDate>=maintenanceDate &&
+                          maintenanceDate.secsTo(currentDate)<300;
+            if (currentDate>=maintenanceDate) { maintenanceDate = QDateTime(); }
+        }
+        if (!maintenance) { clearWakeAlarm(); }
+        if (lockScreenOnResume) {
+            LockScreen();
+            suspendReport.ready(SuspendReport::StageLock);
+        }
+        resumeBattery();
+        if (maintenance) {
+            qCDebug(PK_POWER) << "maintenance wake";
+            FlightRecorder::record("maintenance_wake");
+            emit MaintenanceWakeup();
+        } else { emit PrepareForResume(); }
+        QTimer::singleShot(0, this, SLOT(resumeDevices()));
     }
 }
 
+// a stale energy is ignored, the drain is then sampled on the
+// first battery update that moved (handleDeviceChanged)
+void PowerKit::resumeBattery()
+{
+    UpdateBattery();
+    suspendReport.resumedEnergy(OnBattery()?BatteryEnergy():-1);
+}
+
+// peripherals and the rest of the device properties. the delay
+// lock was released before the suspend, the next one needs it too
+void PowerKit::resumeDevices()
+{
+    UpdateDevices();
+    registerSuspendLock();
+    suspendReport.ready(SuspendReport::StageDevices);
+}
+
 void PowerKit::clearDevices()
 {
     QMapIterator<QString, Device*> device(devices);
     while (device.hasNext()) {
         device.next();
+        deviceReads += device.value()->propertyReads;
+        deviceReadTime += device.value()->propertyReadTime;
         delete device.value();
     }
     devices.clear();
 }
 
+void PowerKit::suspendStarted()
+{
+    suspends++;
+    setMaintenanceAlarm();
+    suspendReport.suspending(OnBattery()?BatteryEnergy():-1);
+}
+
+void PowerKit::resumed()
+{
+    resumes++;
+    if (!suspendReport.isSuspended()) { return; }
+    suspendReport.resuming();
+    lastSuspendSeconds = suspendReport.last().asleep/1000;
+    suspendSeconds += lastSuspendSeconds;
+}
+
+// keep battery samples, at most one every HISTORY_MIN_INTERVAL
+// unless the power source changed
+void PowerKit::recordHistory(Device *device)
+{
+    if (!recording ||
+        !device ||
+        !device->isBattery ||
+        !device->isPresent ||
+        device->nativePath.isEmpty()) { return; }
+    health.update(device);
+    if (!history.contains(device->path)) {
+        history[device->path] = new BatteryHistory(BatteryHistory::pathForDevice(device->name));
+    }
+    BatteryHistory *store = history[device->path];
+    if (!store->isOpen()) { return; }
+
+    HistorySample sample;
+    sample.timestamp = clock->currentTime_t();
+    sample.energy = device->energy;
+    sample.rate = device->energyRate;
+    sample.percentage = device->percentage;
+    sample.source = wasOnBattery?HistorySample::SourceBattery:HistorySample::SourceAC;
+
+    HistorySample last = store->last();
+    if (last.source == sample.source &&
+        sample.timestamp-last.timestamp<HISTORY_MIN_INTERVAL) { return; }
+    store->append(sample);
+}
+
+// feed the discharge estimator with the totals of all batteries
+void PowerKit::updateEstimator()
+{
+    if (!wasOnBattery) {
+        estimator.reset();
+        return;
+    }
+    double energy = 0;
+    double rate = 0;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        if (device.value()->isBattery &&
+            device.value()->isPresent &&
+            !device.value()->nativePath.isEmpty())
+        {
+            energy += device.value()->energy;
+            rate += device.value()->energyRate;
+        }
+    }
+    estimator.addSample(clock->currentTime_t(), energy, rate);
+}
+
 void PowerKit::handleNewInhibitScreenSaver(const QString &application, const QString &reason, quint32 cookie)
 {
     Q_UNUSED(reason)
@@ -473,14 +759,15 @@ void PowerKit::handleDelInhibitPowerManagement(quint32 cookie)
 bool PowerKit::registerSuspendLock()
 {
     if (suspendLock) { return false; }
-    qDebug() << "register suspend lock";
+    qCDebug(PK_POWER) << "register suspend lock";
     QDBusReply<QDBusUnixFileDescriptor> reply;
+    CallTimer call(&callCount, &callTime, "Inhibit");
     if (HasLogind() && logind->isValid()) {
-        reply = ckit->call("Inhibit",
-                           "sleep",
-                           "powerkit",
-                           "Lock screen etc",
-                           "delay");
+        reply = logind->call("Inhibit",
+                             "sleep",
+                             "powerkit",
+                             "Lock screen etc",
+                             "delay");
     } else if (HasConsoleKit() && ckit->isValid()) {
         reply = ckit->call("Inhibit",
                            "sleep",
@@ -492,7 +779,7 @@ bool PowerKit::registerSuspendLock()
         suspendLock.reset(new QDBusUnixFileDescriptor(reply.value()));
         return true;
     } else {
-        qDebug() << reply.error();
+        qCDebug(PK_POWER) << reply.error();
     }
     return false;
 }
@@ -501,13 +788,68 @@ void PowerKit::setWakeAlarmFromSettings()
 {
     if (!CanHibernate()) { return; }
     int wmin = OnBattery()?suspendWakeupBattery:suspendWakeupAC;
+    if (OnBattery() && suspendWakeupAuto) {
+        int measured = autoWakeAlarmMinutes();
+        if (measured>0) { wmin = measured; }
+    }
     if (wmin>0) {
-        qDebug() << "we need to set a wake alarm" << wmin << "min from now";
-        QDateTime date = QDateTime::currentDateTime().addSecs(wmin*60);
+        qCDebug(PK_POWER) << "we need to set a wake alarm" << wmin << "min from now";
+        QDateTime date = clock->currentDateTime().addSecs(wmin*60);
         setWakeAlarm(date);
     }
 }
 
+// next maintenance window into the powerkitd alarm queue
+void PowerKit::setMaintenanceAlarm()
+{
+    if (!pmd || !pmd->isValid()) { return; }
+    if (!maintenanceTime.isValid()) {
+        if (maintenanceDate.isValid()) {
+            pmd->asyncCall("cancelWakeAlarm", PMD_ALARM_MAINTENANCE);
+            maintenanceDate = QDateTime();
+        }
+        return;
+    }
+    QDateTime now = clock->currentDateTime();
+    QDateTime date(now.date(), maintenanceTime);
+    if (date<=now.addSecs(60)) { date = date.addDays(1); }
+    CallTimer call(&callCount, &callTime, "addWakeAlarm");
+    QDBusMessage reply = pmd->call("addWakeAlarm",
+                                   PMD_ALARM_MAINTENANCE,
+                                   date.toString("yyyy-MM-dd HH:mm:ss"));
+    if (reply.errorMessage().isEmpty() &&
+        !reply.arguments().isEmpty() &&
+        reply.arguments().first().toBool()) {
+        qCDebug(PK_POWER) << "maintenance wake alarm set to" << date;
+        maintenanceDate = date;
+    } else { maintenanceDate = QDateTime(); }
+}
+
+// minutes until the battery is down to the reserve at the measured
+// suspend drain, -1 until a suspend on battery has been measured
+int PowerKit::autoWakeAlarmMinutes()
+{
+    int minutes = suspendReport.minutesToReserve(BatteryEnergy(),
+                                                 batteryEnergyFull(),
+                                                 suspendWakeupReserve);
+    qCDebug(PK_POWER) << "suspend drain" << suspendReport.drainRate() << "Wh/h, reserve reached in" << minutes << "min";
+    return minutes;
+}
+
+double PowerKit::batteryEnergyFull()
+{
+    double result = 0;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        if (device.value()->isBattery &&
+            device.value()->isPresent &&
+            !device.value()->nativePath.isEmpty())
+        { result += device.value()->energyFull; }
+    }
+    return result;
+}
+
 bool PowerKit::HasConsoleKit()
 {
     return availableService(CONSOLEKIT_SERVICE,
@@ -597,7 +939,7 @@ bool PowerKit::CanHybridSleep()
 
 QString PowerKit::Restart()
 {
-    qDebug() << "try to restart";
+    qCDebug(PK_POWER) << "try to restart";
     if (HasLogind()) {
         return executeAction(PKRestartAction, PKLogind);
     } else if (HasConsoleKit()) {
@@ -608,7 +950,7 @@ QString PowerKit::Restart()
 
 QString PowerKit::PowerOff()
 {
-    qDebug() << "try to poweroff";
+    qCDebug(PK_POWER) << "try to poweroff";
     if (HasLogind()) {
         return executeAction(PKPowerOffAction, PKLogind);
     } else if (HasConsoleKit()) {
@@ -619,7 +961,7 @@ QString PowerKit::PowerOff()
 
 QString PowerKit::Suspend()
 {
-    qDebug() << "try to suspend";
+    qCDebug(PK_POWER) << "try to suspend";
     if (lockScreenOnSuspend) { LockScreen(); }
     if (HasLogind()) {
         setWakeAlarmFromSettings();
@@ -635,7 +977,7 @@ QString PowerKit::Suspend()
 
 QString PowerKit::Hibernate()
 {
-    qDebug() << "try to hibernate";
+    qCDebug(PK_POWER) << "try to hibernate";
     if (lockScreenOnSuspend) { LockScreen(); }
     if (HasLogind()) {
         return executeAction(PKHibernateAction, PKLogind);
@@ -649,7 +991,7 @@ QString PowerKit::Hibernate()
 
 QString PowerKit::HybridSleep()
 {
-    qDebug() << "try to hybridsleep";
+    qCDebug(PK_POWER) << "try to hybridsleep";
     if (lockScreenOnSuspend) { LockScreen(); }
     if (HasLogind()) {
         return executeAction(PKHybridSleepAction, PKLogind);
@@ -663,13 +1005,17 @@ bool PowerKit::setWakeAlarm(const QDateTime &date)
 {
     if (pmd && date.isValid() && CanHibernate()) {
         if (!pmd->isValid()) { return false; }
-        QDBusMessage reply = pmd->call("setWakeAlarm",
+        CallTimer call(&callCount, &callTime, "addWakeAlarm");
+        QDBusMessage reply = pmd->call("addWakeAlarm",
+                                       PMD_ALARM_HIBERNATE,
                                        date.toString("yyyy-MM-dd HH:mm:ss"));
-        bool alarm = reply.arguments().first().toBool() && reply.errorMessage().isEmpty();
-        qDebug() << "WAKE OK?" << alarm;
+        bool alarm = reply.errorMessage().isEmpty() &&
+                     !reply.arguments().isEmpty() &&
+                     reply.arguments().first().toBool();
+        qCDebug(PK_POWER) << "WAKE OK?" << alarm;
         wakeAlarm = alarm;
         if (alarm) {
-            qDebug() << "wake alarm was set to" << date;
+            qCDebug(PK_POWER) << "wake alarm was set to" << date;
             wakeAlarmDate = date;
         }
         return alarm;
@@ -677,36 +1023,157 @@ bool PowerKit::setWakeAlarm(const QDateTime &date)
     return false;
 }
 
+// named profile (see CpuProfile), turbo stays off under
+// the battery saver cap
+bool PowerKit::setCpuProfile(const QString &name)
+{
+    QVariantMap profile = CpuProfile::profile(name);
+    if (profile.isEmpty()) { return false; }
+    cpuProfile = name;
+    if (cpuLimit<100) { profile[CPU_BOOST] = false; }
+    bool result = applyCpuProfile(profile);
+    qCDebug(PK_POWER) << "cpu profile" << name << "set?" << result;
+    FlightRecorder::record("cpu_profile", result);
+    return result;
+}
+
+// battery saver, caps the frequency and turns turbo off. the
+// values from before the first cap are saved, 100 restores them
+// (turbo as in the current profile if one was set)
+bool PowerKit::setCpuLimit(int percent)
+{
+    percent = qBound(1, percent, 100);
+    QVariantMap limit;
+    if (percent<100) {
+        if (cpuSaved.isEmpty()) {
+            QVariantMap state = cpuProfileState();
+            if (state.contains(CPU_MAX_FREQ)) { cpuSaved[CPU_MAX_FREQ] = state.value(CPU_MAX_FREQ); }
+            if (state.contains(CPU_BOOST)) { cpuSaved[CPU_BOOST] = state.value(CPU_BOOST); }
+        }
+        limit[CPU_MAX_FREQ] = percent;
+        limit[CPU_BOOST] = false;
+    } else {
+        limit = cpuSaved;
+        QVariantMap profile = CpuProfile::profile(cpuProfile);
+        if (profile.contains(CPU_BOOST)) { limit[CPU_BOOST] = profile.value(CPU_BOOST); }
+    }
+    cpuLimit = percent;
+    // nothing saved and no profile, leave the hardware as it is
+    if (limit.isEmpty()) { return true; }
+    bool result = applyCpuProfile(limit);
+    if (result && percent == 100) { cpuSaved.clear(); }
+    qCDebug(PK_POWER) << "cpu limit" << cpuLimit << "set?" << result;
+    FlightRecorder::record("cpu_limit", cpuLimit, result);
+    return result;
+}
+
+// runtime PM of PCI and USB devices (see RuntimePM), one call to
+// powerkitd. disabled restores what was there before
+bool PowerKit::setRuntimePM(bool enabled,
+                            const QStringList &allow,
+                            const QStringList &deny,
+                            int delay)
+{
+    if (!enabled && !runtimePM) { return true; }
+    if (!pmd || !pmd->isValid()) { return false; }
+    CallTimer call(&callCount, &callTime, "setRuntimePM");
+    QDBusMessage reply = pmd->call("setRuntimePM", enabled, allow, deny, delay);
+    bool result = reply.errorMessage().isEmpty() &&
+                  !reply.arguments().isEmpty() &&
+                  reply.arguments().first().toBool();
+    qCDebug(PK_POWER) << "runtime pm" << enabled << "set?" << result;
+    FlightRecorder::record("runtime_pm", enabled, result);
+    if (result) { runtimePM = enabled; }
+    // devices suspend after their delay
+    if (result && enabled) {
+        QTimer::singleShot(qBound(0, delay, RUNTIME_PM_DELAY_MAX)+RUNTIME_PM_REPORT,
+                           this,
+                           SLOT(reportRuntimePM()));
+    }
+    return result;
+}
+
+void PowerKit::reportRuntimePM()
+{
+    QVariantMap state = RuntimePMState();
+    QStringList suspended = state.value("suspended").toStringList();
+    qCDebug(PK_POWER) << "runtime suspended devices" << suspended;
+    FlightRecorder::record("runtime_pm_suspended",
+                           suspended.size(),
+                           state.value("managed").toStringList().size());
+}
+
+// enabled, managed and runtime suspended devices, from powerkitd
+QVariantMap PowerKit::RuntimePMState()
+{
+    if (!pmd || !pmd->isValid()) { return QVariantMap(); }
+    CallTimer call(&callCount, &callTime, "runtimePMState");
+    QDBusReply<QVariantMap> reply = pmd->call("runtimePMState");
+    if (!reply.isValid()) { return QVariantMap(); }
+    return reply.value();
+}
+
+// one call to powerkitd, all written or none
+bool PowerKit::applyCpuProfile(const QVariantMap &profile)
+{
+    if (!pmd || !pmd->isValid()) { return false; }
+    CallTimer call(&callCount, &callTime, "setCpuProfile");
+    QDBusMessage reply = pmd->call("setCpuProfile", profile);
+    return reply.errorMessage().isEmpty() &&
+           !reply.arguments().isEmpty() &&
+           reply.arguments().first().toBool();
+}
+
+// max_freq, boost and the rest as read by powerkitd, empty on failure
+QVariantMap PowerKit::cpuProfileState()
+{
+    if (!pmd || !pmd->isValid()) { return QVariantMap(); }
+    CallTimer call(&callCount, &callTime, "cpuProfileState");
+    QDBusReply<QVariantMap> reply = pmd->call("cpuProfileState");
+    if (!reply.isValid()) { return QVariantMap(); }
+    return reply.value();
+}
+
+// other alarms in the daemon queue are kept, don't wait for the reply
 void PowerKit::clearWakeAlarm()
 {
+    if (wakeAlarm && pmd && pmd->isValid()) {
+        pmd->asyncCall("cancelWakeAlarm", PMD_ALARM_HIBERNATE);
+    }
     wakeAlarm = false;
 }
 
 bool PowerKit::IsDocked()
 {
-    if (logind->isValid()) { return logind->property(LOGIND_DOCKED).toBool(); }
-    if (upower->isValid()) { return upower->property(UPOWER_DOCKED).toBool(); }
+    if (logind->isValid()) { return readProperty(logind, LOGIND_DOCKED).toBool(); }
+    if (upower->isValid()) { return readProperty(upower, UPOWER_DOCKED).toBool(); }
     return false;
 }
 
 bool PowerKit::LidIsPresent()
 {
-    if (upower->isValid()) { return upower->property(UPOWER_LID_IS_PRESENT).toBool(); }
+    if (upower->isValid()) { return readProperty(upower, UPOWER_LID_IS_PRESENT).toBool(); }
     return false;
 }
 
 bool PowerKit::LidIsClosed()
 {
-    if (upower->isValid()) { return upower->property(UPOWER_LID_IS_CLOSED).toBool(); }
+    if (upower->isValid()) { return readProperty(upower, UPOWER_LID_IS_CLOSED).toBool(); }
     return false;
 }
 
 bool PowerKit::OnBattery()
 {
-    if (upower->isValid()) { return upower->property(UPOWER_ON_BATTERY).toBool(); }
+    if (upower->isValid()) { return readProperty(upower, UPOWER_ON_BATTERY).toBool(); }
     return false;
 }
 
+QVariant PowerKit::readProperty(QDBusInterface *iface, const char *name)
+{
+    CallTimer call(&callCount, &callTime, "Get");
+    return iface->property(name);
+}
+
 double PowerKit::BatteryLeft()
 {
     if (OnBattery()) { UpdateBattery(); }
@@ -728,10 +1195,13 @@ double PowerKit::BatteryLeft()
 
 void PowerKit::LockScreen()
 {
-    qDebug() << "lock screen";
+    qCDebug(PK_POWER) << "lock screen";
+    PK_PROBE(lock_screen_start);
     QProcess proc;
     proc.start(XSCREENSAVER_LOCK);
     proc.waitForFinished();
+    PK_PROBE1(lock_screen_end, proc.exitCode());
+    FlightRecorder::record("lock_screen", proc.exitCode());
     proc.close();
 }
 
@@ -748,6 +1218,12 @@ bool PowerKit::HasBattery()
 qlonglong PowerKit::TimeToEmpty()
 {
     if (OnBattery()) { UpdateBattery(); }
+    if (estimator.isValid()) { return estimator.timeToEmpty(BatteryEnergy()); }
+
+    // batteries drain in parallel, summing each
+    // battery time to empty is wrong
+    double energy = 0;
+    double rate = 0;
     qlonglong result = 0;
     QMapIterator<QString, Device*> device(devices);
     while (device.hasNext()) {
@@ -755,7 +1231,88 @@ qlonglong PowerKit::TimeToEmpty()
         if (device.value()->isBattery &&
             device.value()->isPresent &&
             !device.value()->nativePath.isEmpty())
-        { result += device.value()->timeToEmpty; }
+        {
+            energy += device.value()->energy;
+            rate += device.value()->energyRate;
+            if (device.value()->timeToEmpty>result) {
+                result = device.value()->timeToEmpty;
+            }
+        }
+    }
+    if (rate>0) { return (qlonglong)(energy*3600.0/rate); }
+    return result;
+}
+
+qlonglong PowerKit::TimeToEmptyLow()
+{
+    if (!estimator.isValid()) { return TimeToEmpty(); }
+    return estimator.timeToEmptyLow(BatteryEnergy());
+}
+
+qlonglong PowerKit::TimeToEmptyHigh()
+{
+    if (!estimator.isValid()) { return TimeToEmpty(); }
+    return estimator.timeToEmptyHigh(BatteryEnergy());
+}
+
+double PowerKit::DischargeRate()
+{
+    if (estimator.isValid()) { return estimator.power(); }
+    double result = 0;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        if (device.value()->isBattery &&
+            device.value()->isPresent &&
+            !device.value()->nativePath.isEmpty())
+        { result += device.value()->energyRate; }
+    }
+    return result;
+}
+
+// predicted seconds until the batteries are at 'percent', -1 if unknown
+qlonglong PowerKit::TimeToLevel(double percent)
+{
+    if (!estimator.isValid()) { return -1; }
+    double full = 0;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        if (device.value()->isBattery &&
+            device.value()->isPresent &&
+            !device.value()->nativePath.isEmpty())
+        { full += device.value()->energyFull; }
+    }
+    if (full<=0) { return -1; }
+    return estimator.secondsUntilAt(clock->currentTime_t(),
+                                    full*percent/100.0);
+}
+
+QVariantMap PowerKit::BatteryHealth()
+{
+    QVariantMap result;
+    if (!recording) { health.reload(); }
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        if (!device.value()->isBattery) { continue; }
+        QString key = HealthTracker::keyForDevice(device.value());
+        if (!health.contains(key)) { continue; }
+        result[device.value()->name] = health.report(key);
+    }
+    return result;
+}
+
+double PowerKit::BatteryEnergy()
+{
+    double result = 0;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        if (device.value()->isBattery &&
+            device.value()->isPresent &&
+            !device.value()->nativePath.isEmpty())
+        { result += device.value()->energy; }
     }
     return result;
 }
@@ -829,30 +1386,292 @@ const QDateTime PowerKit::getWakeAlarm()
 
 void PowerKit::releaseSuspendLock()
 {
-    qDebug() << "release suspend lock";
+    qCDebug(PK_POWER) << "release suspend lock";
     suspendLock.reset(NULL);
 }
 
 void PowerKit::setSuspendWakeAlarmOnBattery(int value)
 {
-    qDebug() << "set suspend wake alarm on battery" << value;
+    qCDebug(PK_CORE) << "set suspend wake alarm on battery" << value;
     suspendWakeupBattery = value;
 }
 
 void PowerKit::setSuspendWakeAlarmOnAC(int value)
 {
-    qDebug() << "set suspend wake alarm on ac" << value;
+    qCDebug(PK_CORE) << "set suspend wake alarm on ac" << value;
     suspendWakeupAC = value;
 }
 
+// wake alarm from the measured suspend drain, on battery
+void PowerKit::setSuspendWakeAlarmAuto(bool enabled)
+{
+    qCDebug(PK_CORE) << "set automatic suspend wake alarm" << enabled;
+    suspendWakeupAuto = enabled;
+}
+
+void PowerKit::setSuspendWakeAlarmReserve(int percent)
+{
+    qCDebug(PK_CORE) << "set suspend wake alarm reserve" << percent;
+    suspendWakeupReserve = qBound(0, percent, 100);
+}
+
+// daily maintenance wake (HH:mm), empty to disable
+void PowerKit::setMaintenanceTime(const QString &time)
+{
+    qCDebug(PK_CORE) << "set maintenance time" << time;
+    maintenanceTime = QTime::fromString(time, "HH:mm");
+}
+
 void PowerKit::setLockScreenOnSuspend(bool lock)
 {
-    qDebug() << "set lock screen on suspend" << lock;
+    qCDebug(PK_CORE) << "set lock screen on suspend" << lock;
     lockScreenOnSuspend = lock;
 }
 
 void PowerKit::setLockScreenOnResume(bool lock)
 {
-    qDebug() << "set lock screen on resume" << lock;
+    qCDebug(PK_CORE) << "set lock screen on resume" << lock;
     lockScreenOnResume = lock;
 }
+
+QVariantMap PowerKit::Stats()
+{
+    QVariantMap result;
+    Scheduler *scheduler = Scheduler::global();
+    result["wakeups"] = scheduler->wakeups();
+    result["wakeups_per_hour"] = scheduler->wakeupsPerHour();
+    result["wakeups_per_hour_planned"] = scheduler->plannedWakeupsPerHour();
+    result["scheduler_active_tasks"] = scheduler->activeTasks();
+    result["x11"] = XStats::stats();
+    return result;
+}
+
+// jobs are per owner, two applications may pick the same name
+static QString jobKey(const QString &owner, const QString &name)
+{
+    return QString("%1 %2").arg(owner).arg(name);
+}
+
+// battery level from the device cache, -1 without a battery
+double PowerKit::cachedBatteryLeft()
+{
+    double batteryLeft = 0;
+    int batteries = 0;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        if (!device.value()->isBattery ||
+            !device.value()->isPresent ||
+            device.value()->nativePath.isEmpty()) { continue; }
+        batteryLeft += device.value()->percentage;
+        batteries++;
+    }
+    return batteries>0?batteryLeft/batteries:-1;
+}
+
+// on device changes and idle transitions, nothing is polled
+void PowerKit::updateJobs()
+{
+    if (jobs.isEmpty()) { return; }
+    double battery = cachedBatteryLeft();
+    QMutableMapIterator<QString, DeferredJob> i(jobs);
+    while (i.hasNext()) {
+        i.next();
+        DeferredJob &job = i.value();
+        bool allowed = job.allowed(wasOnBattery, battery, idleMsecs);
+        if (allowed == job.running) { continue; }
+        job.running = allowed;
+        qCDebug(PK_CORE) << "deferred job" << job.name << job.owner << "may run?" << allowed;
+        if (allowed) {
+            FlightRecorder::record("job_may_run", jobs.size());
+            emit JobMayRun(job.owner, job.name);
+        } else {
+            FlightRecorder::record("job_must_pause", jobs.size());
+            emit JobMustPause(job.owner, job.name);
+        }
+    }
+}
+
+// one idle alarm per distinct job threshold, the watcher
+// (and its display connection) only runs while needed
+void PowerKit::updateIdleThresholds()
+{
+    QList<qint64> thresholds;
+    foreach (DeferredJob job, jobs) {
+        if (job.idle>0 && !thresholds.contains(job.idle)) { thresholds << job.idle; }
+    }
+    if (thresholds.isEmpty()) {
+        if (idleWatch) { idleWatch->requestStop(); }
+        idleMsecs = 0;
+        return;
+    }
+    if (idleWatch == NULL) {
+        idleWatch = new IdleWatch();
+        connect(idleWatch, SIGNAL(idle(qint64)),
+                this, SLOT(handleIdle(qint64)));
+        connect(idleWatch, SIGNAL(active()),
+                this, SLOT(handleActive()));
+    }
+    idleWatch->setThresholds(thresholds);
+    idleWatch->requestWatch();
+}
+
+void PowerKit::handleIdle(qint64 msecs)
+{
+    if (msecs<=idleMsecs) { return; }
+    idleMsecs = msecs;
+    updateJobs();
+}
+
+void PowerKit::handleActive()
+{
+    if (idleMsecs == 0) { return; }
+    idleMsecs = 0;
+    updateJobs();
+}
+
+void PowerKit::handleJobOwnerGone(const QString &service)
+{
+    qCDebug(PK_CORE) << "deferred job owner left" << service;
+    QMutableMapIterator<QString, DeferredJob> i(jobs);
+    while (i.hasNext()) {
+        if (i.next().value().owner == service) { i.remove(); }
+    }
+    jobWatcher->removeWatchedService(service);
+    updateIdleThresholds();
+}
+
+// the job starts paused, JobMayRun follows when the conditions
+// hold. registering the same name again replaces the conditions
+bool PowerKit::RegisterDeferredJob(const QString &name,
+                                   const QVariantMap &conditions)
+{
+    if (name.isEmpty() || !DeferredJob::validConditions(conditions)) { return false; }
+    QString owner = calledFromDBus()?message().service():QString();
+    QString key = jobKey(owner, name);
+    if (!jobs.contains(key) && jobs.size()>=JOB_MAX) { return false; }
+    DeferredJob job(owner, name, conditions);
+    if (jobs.contains(key)) { job.running = jobs[key].running; }
+    jobs[key] = job;
+    qCDebug(PK_CORE) << "register deferred job" << name << owner << conditions;
+    FlightRecorder::record("job_register", jobs.size());
+
+    if (!owner.isEmpty()) {
+        if (jobWatcher == NULL) {
+            jobWatcher = new QDBusServiceWatcher(this);
+            jobWatcher->setConnection(connection());
+            jobWatcher->setWatchMode(QDBusServiceWatcher::WatchForUnregistration);
+            connect(jobWatcher, SIGNAL(serviceUnregistered(QString)),
+                    this, SLOT(handleJobOwnerGone(QString)));
+        }
+        if (!jobWatcher->watchedServices().contains(owner)) {
+            jobWatcher->addWatchedService(owner);
+        }
+    }
+    updateIdleThresholds();
+    // after the reply
+    QTimer::singleShot(0, this, SLOT(updateJobs()));
+    return true;
+}
+
+void PowerKit::UnregisterDeferredJob(const QString &name)
+{
+    QString owner = calledFromDBus()?message().service():QString();
+    if (jobs.remove(jobKey(owner, name)) == 0) { return; }
+    qCDebug(PK_CORE) << "unregister deferred job" << name << owner;
+    FlightRecorder::record("job_unregister", jobs.size());
+    bool owned = false;
+    foreach (DeferredJob job, jobs) {
+        if (job.owner == owner) {
+            owned = true;
+            break;
+        }
+    }
+    if (!owned && jobWatcher) { jobWatcher->removeWatchedService(owner); }
+    updateIdleThresholds();
+}
+
+QVariantMap PowerKit::DeferredJobs()
+{
+    QVariantMap result;
+    foreach (DeferredJob job, jobs) {
+        result[jobKey(job.owner, job.name)] = job.toMap();
+    }
+    return result;
+}
+
+// cached state only, safe to call as often as needed (no bus calls)
+QVariantMap PowerKit::Snapshot()
+{
+    QVariantMap result = Stats();
+    result["on_battery"] = wasOnBattery;
+    result["lid_closed"] = wasLidClosed;
+    result["suspends"] = suspends;
+    result["resumes"] = resumes;
+    result["suspend_seconds"] = suspendSeconds;
+    result["suspend_seconds_last"] = lastSuspendSeconds;
+    result["resume_msecs_last"] = suspendReport.last().latency();
+    result["suspend_drain_wh_per_hour"] = suspendReport.drainRate();
+    result["cpu_limit"] = cpuLimit;
+
+    QVariantMap batteries;
+    qlonglong reads = deviceReads;
+    qlonglong readTime = deviceReadTime;
+    QMapIterator<QString, Device*> device(devices);
+    while (device.hasNext()) {
+        device.next();
+        Device *dev = device.value();
+        reads += dev->propertyReads;
+        readTime += dev->propertyReadTime;
+        if (!dev->isBattery || !dev->isPresent) { continue; }
+        QVariantMap battery;
+        battery["energy"] = dev->energy;
+        battery["energy_full"] = dev->energyFull;
+        battery["energy_full_design"] = dev->energyFullDesign;
+        battery["percentage"] = dev->percentage;
+        battery["rate"] = dev->energyRate;
+        battery["time_to_empty"] = dev->timeToEmpty;
+        battery["time_to_full"] = dev->timeToFull;
+        batteries[dev->name] = battery;
+    }
+    result["batteries"] = batteries;
+
+    // device property reads are counted by each device
+    QMap<QString, qlonglong> count = callCount;
+    QMap<QString, qlonglong> time = callTime;
+    count["Get"] += reads;
+    time["Get"] += readTime;
+    QVariantMap calls, seconds;
+    QMapIterator<QString, qlonglong> i(count);
+    while (i.hasNext()) {
+        i.next();
+        calls[i.key()] = i.value();
+        seconds[i.key()] = (double)time.value(i.key())/1000000.0;
+    }
+    result["dbus_calls"] = calls;
+    result["dbus_call_seconds"] = seconds;
+
+    QVariantMap ss, pm;
+    foreach (QString app, ssInhibitors.values()) {
+        ss[app] = ss.value(app).toInt()+1;
+    }
+    foreach (QString app, pmInhibitors.values()) {
+        pm[app] = pm.value(app).toInt()+1;
+    }
+    result["inhibitors_screensaver"] = ss;
+    result["inhibitors_power"] = pm;
+    return result;
+}
+
+// recent events, oldest first
+QStringList PowerKit::FlightLog()
+{
+    return FlightRecorder::dump();
+}
+
+// suspend/resume timing per cycle and the kernel suspend stats
+QVariantMap PowerKit::SuspendHistory()
+{
+    if (!recording) { suspendReport.reload(); }
+    return suspendReport.report();
+}
@@ -17,8 +17,18 @@
 #include <QTimer>
 #include <QDateTime>
 #include <QDBusUnixFileDescriptor>
+#include <QDBusServiceWatcher>
+#include <QDBusContext>
+#include <QVariantMap>
 
 #include "device.h"
+#include "history.h"
+#include "estimator.h"
+#include "health.h"
+#include "clock.h"
+#include "suspendreport.h"
+#include "idlewatch.h"
+#include "deferredjob.h"
 
 #define POWERKIT_SERVICE "org.freedesktop.PowerKit"
 #define POWERKIT_PATH "/PowerKit"
@@ -69,13 +79,19 @@
 #define DBUS_DEVICE_ADDED "DeviceAdded"
 #define DBUS_DEVICE_REMOVED "DeviceRemoved"
 #define DBUS_DEVICE_CHANGED "DeviceChanged"
+#define DBUS_LOCAL_PATH "/org/freedesktop/DBus/Local"
+#define DBUS_LOCAL_INTERFACE "org.freedesktop.DBus.Local"
+#define DBUS_LOCAL_DISCONNECTED "Disconnected"
 
 #define XSCREENSAVER "xscreensaver-command -deactivate"
 #define XSCREENSAVER_LOCK "xscreensaver-command -lock"
 
-#define TIMEOUT_CHECK 60000
+#define TIMEOUT_RECONNECT 60000
+#define HISTORY_MIN_INTERVAL 30
+#define SUSPEND_WAKEUP_RESERVE 15 // % of full left at the automatic wake alarm
+#define RUNTIME_PM_REPORT 5000 // ms after the autosuspend delay
 
-class PowerKit : public QObject
+class PowerKit : public QObject, protected QDBusContext
 {
     Q_OBJECT
 
@@ -110,9 +126,20 @@ public:
     explicit PowerKit(QObject *parent = 0);
     ~PowerKit();
     QMap<QString, Device*> getDevices();
+    BatteryHistory *getHistory(const QString &device);
+    void setRecording(bool enabled);
+    void setClock(Clock *clock);
+    void resumeReady(SuspendReport::Stage stage);
+    bool hasSuspendLock();
 
 private:
     QMap<QString, Device*> devices;
+    QMap<QString, BatteryHistory*> history;
+    DischargeEstimator estimator;
+    HealthTracker health;
+    SuspendReport suspendReport;
+    bool recording;
+    Clock *clock;
     QMap<quint32,QString> ssInhibitors;
     QMap<quint32,QString> pmInhibitors;
 
@@ -121,7 +148,8 @@ private:
     QDBusInterface *ckit;
     QDBusInterface *pmd;
 
-    QTimer timer;
+    QDBusServiceWatcher *watcher;
+    int reconnectTask;
 
     bool wasDocked;
     bool wasLidClosed;
@@ -130,14 +158,45 @@ private:
     bool wakeAlarm;
     QDateTime wakeAlarmDate;
 
+    qlonglong suspends;
+    qlonglong resumes;
+    qlonglong suspendSeconds;
+    qlonglong lastSuspendSeconds;
+
+    QMap<QString, qlonglong> callCount;
+    QMap<QString, qlonglong> callTime; // usec
+    qlonglong deviceReads; // from removed devices
+    qlonglong deviceReadTime;
+
+    void suspendStarted();
+    void resumed();
+    QVariant readProperty(QDBusInterface *iface, const char *name);
+
     QScopedPointer<QDBusUnixFileDescriptor> suspendLock;
 
     int suspendWakeupBattery;
     int suspendWakeupAC;
+    bool suspendWakeupAuto;
+    int suspendWakeupReserve;
+    QTime maintenanceTime;
+    QDateTime maintenanceDate; // programmed maintenance wake
 
     bool lockScreenOnSuspend;
     bool lockScreenOnResume;
 
+    QString cpuProfile;
+    int cpuLimit; // battery saver cap, % of max frequency
+    QVariantMap cpuSaved; // max_freq and boost from before the cap
+    bool runtimePM;
+
+    QMap<QString, DeferredJob> jobs; // owner and name
+    QDBusServiceWatcher *jobWatcher;
+    IdleWatch *idleWatch;
+    qint64 idleMsecs; // highest job threshold passed
+
+    void updateIdleThresholds();
+    double cachedBatteryLeft();
+
 signals:
     void Update();
     void UpdatedDevices();
@@ -150,6 +209,9 @@ signals:
     void DeviceWasRemoved(const QString &path);
     void DeviceWasAdded(const QString &path);
     void UpdatedInhibitors();
+    void MaintenanceWakeup();
+    void JobMayRun(const QString &owner, const QString &name);
+    void JobMustPause(const QString &owner, const QString &name);
 
 private slots:
     bool availableService(const QString &service,
@@ -164,6 +226,9 @@ private slots:
     void setup();
     void check();
     void scan();
+    void handleServiceRegistered(const QString &service);
+    void handleServiceUnregistered(const QString &service);
+    void handleDisconnected();
 
     void deviceAdded(const QDBusObjectPath &obj);
     void deviceAdded(const QString &path);
@@ -174,7 +239,11 @@ private slots:
     void handleResume();
     void handleSuspend();
     void handlePrepareForSuspend(bool prepare);
+    void resumeBattery();
+    void resumeDevices();
     void clearDevices();
+    void recordHistory(Device *device);
+    void updateEstimator();
     void handleNewInhibitScreenSaver(const QString &application,
                                      const QString &reason,
                                      quint32 cookie);
@@ -186,6 +255,16 @@ private slots:
     
     bool registerSuspendLock();
     void setWakeAlarmFromSettings();
+    void setMaintenanceAlarm();
+    bool applyCpuProfile(const QVariantMap &profile);
+    QVariantMap cpuProfileState();
+    void reportRuntimePM();
+    int autoWakeAlarmMinutes();
+    double batteryEnergyFull();
+    void updateJobs();
+    void handleIdle(qint64 msecs);
+    void handleActive();
+    void handleJobOwnerGone(const QString &service);
 
 public slots:
     bool HasConsoleKit();
@@ -216,6 +295,12 @@ public slots:
     void LockScreen();
     bool HasBattery();
     qlonglong TimeToEmpty();
+    qlonglong TimeToEmptyLow();
+    qlonglong TimeToEmptyHigh();
+    double DischargeRate();
+    double BatteryEnergy();
+    qlonglong TimeToLevel(double percent);
+    QVariantMap BatteryHealth();
     qlonglong TimeToFull();
     void UpdateDevices();
     void UpdateBattery();
@@ -226,8 +311,26 @@ public slots:
     void releaseSuspendLock();
     void setSuspendWakeAlarmOnBattery(int value);
     void setSuspendWakeAlarmOnAC(int value);
+    void setSuspendWakeAlarmAuto(bool enabled);
+    void setSuspendWakeAlarmReserve(int percent);
+    void setMaintenanceTime(const QString &time);
+    bool setCpuProfile(const QString &name);
+    bool setCpuLimit(int percent);
+    bool setRuntimePM(bool enabled,
+                      const QStringList &allow,
+                      const QStringList &deny,
+                      int delay);
+    QVariantMap RuntimePMState();
     void setLockScreenOnSuspend(bool lock);
     void setLockScreenOnResume(bool lock);
+    QVariantMap Stats();
+    QVariantMap Snapshot();
+    QStringList FlightLog();
+    QVariantMap SuspendHistory();
+    bool RegisterDeferredJob(const QString &name,
+                             const QVariantMap &conditions);
+    void UnregisterDeferredJob(const QString &name);
+    QVariantMap DeferredJobs();
 };
 
 #endif // POWERKIT_H
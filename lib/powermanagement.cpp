@@ -13,13 +13,21 @@
 #include <QProcess>
 
 #include "def.h"
+#include "scheduler.h"
+#include "probes.h"
+#include "log.h"
 
 PowerManagement::PowerManagement(QObject *parent) : QObject(parent)
+  , task(-1)
+  , clock(Clock::system())
 {
-    timer.setInterval(PM_TIMEOUT);
-    connect(&timer, SIGNAL(timeout()),
-            this, SLOT(timeOut()));
-    timer.start();
+    // only wake up while someone holds an inhibit
+    task = Scheduler::global()->addTask(this, "timeOut", PM_TIMEOUT, false);
+}
+
+void PowerManagement::setClock(Clock *clock)
+{
+    this->clock = clock?clock:Clock::system();
 }
 
 int PowerManagement::randInt(int low, int high)
@@ -35,7 +43,7 @@ quint32 PowerManagement::genCookie()
     int high = 1000;
     quint32 cookie = (quint32)randInt(low, high);
     while(!clients.contains(cookie)) {
-        if (!clients.contains(cookie)) { clients[cookie] = QTime::currentTime(); }
+        if (!clients.contains(cookie)) { clients[cookie] = clock->monotonicMsecs(); }
         else { cookie = (quint32)randInt(low, high); }
     }
     return cookie;
@@ -43,11 +51,11 @@ quint32 PowerManagement::genCookie()
 
 void PowerManagement::checkForExpiredClients()
 {
-    QMapIterator<quint32, QTime> client(clients);
+    qint64 now = clock->monotonicMsecs();
+    QMapIterator<quint32, qint64> client(clients);
     while (client.hasNext()) {
         client.next();
-        if (client.value()
-            .secsTo(QTime::currentTime())>=PM_MAX_INHIBIT) {
+        if ((now-client.value())/1000>=PM_MAX_INHIBIT) {
             clients.remove(client.key());
         }
     }
@@ -63,6 +71,12 @@ bool PowerManagement::canInhibit()
 void PowerManagement::timeOut()
 {
     if (canInhibit()) { SimulateUserActivity(); }
+    updateTask();
+}
+
+void PowerManagement::updateTask()
+{
+    Scheduler::global()->setTaskActive(task, !clients.isEmpty());
 }
 
 void PowerManagement::SimulateUserActivity()
@@ -74,6 +88,10 @@ quint32 PowerManagement::Inhibit(const QString &application,
                                  const QString &reason)
 {
     quint32 cookie = genCookie();
+    if (PK_PROBE_ENABLED(inhibit_add)) {
+        PK_PROBE3(inhibit_add, 1, application.toUtf8().constData(), cookie);
+    }
+    FlightRecorder::record("inhibit_add", 1, cookie);
     timeOut();
     emit newInhibit(application, reason, cookie);
     emit HasInhibitChanged(canInhibit());
@@ -83,6 +101,8 @@ quint32 PowerManagement::Inhibit(const QString &application,
 void PowerManagement::UnInhibit(quint32 cookie)
 {
     if (clients.contains(cookie)) { clients.remove(cookie); }
+    PK_PROBE2(inhibit_remove, 1, cookie);
+    FlightRecorder::record("inhibit_remove", 1, cookie);
     timeOut();
     emit removedInhibit(cookie);
     emit HasInhibitChanged(canInhibit());
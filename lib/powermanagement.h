@@ -10,21 +10,24 @@
 #define POWERMANAGEMENT_H
 
 #include <QObject>
-#include <QTimer>
 #include <QMap>
 #include <QTime>
 #include <QString>
 
+#include "clock.h"
+
 class PowerManagement : public QObject
 {
     Q_OBJECT
 
 public:
     explicit PowerManagement(QObject *parent = NULL);
+    void setClock(Clock *clock);
 
 private:
-    QTimer timer;
-    QMap<quint32, QTime> clients;
+    int task;
+    Clock *clock;
+    QMap<quint32, qint64> clients; // monotonic msecs at inhibit
 
 signals:
     void HasInhibitChanged(bool has_inhibit);
@@ -39,6 +42,7 @@ private slots:
     void checkForExpiredClients();
     bool canInhibit();
     void timeOut();
+    void updateTask();
 
 public slots:
     void SimulateUserActivity();
@@ -0,0 +1,16 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "probes.h"
+
+#ifdef HAVE_SDT
+// one semaphore per probe, in .probes where the tracer looks for them
+#define PK_PROBE_DEFINE(name) \
+    unsigned short powerkit_##name##_semaphore __attribute__((section(".probes"))) = 0;
+PK_PROBE_LIST(PK_PROBE_DEFINE)
+#endif
@@ -0,0 +1,54 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef PROBES_H
+#define PROBES_H
+
+// USDT probes, provider "powerkit". Enabled with CONFIG+=sdt
+// (needs sys/sdt.h from systemtap), otherwise the probes and their
+// arguments compile to nothing. Keep the list in powerkit.1 in sync.
+//
+//   bpftrace -l 'usdt:/usr/bin/powerkit:powerkit:*'
+//
+// Every probe has a semaphore (defined in probes.cpp) that is set while
+// the probe is attached, probes with arguments that cost something to
+// compute (strings) are wrapped in PK_PROBE_ENABLED(name).
+
+#define PK_PROBE_LIST(X) \
+    X(action_dispatch) \
+    X(action_reply) \
+    X(idle_decision) \
+    X(inhibit_add) \
+    X(inhibit_remove) \
+    X(lid_closed) \
+    X(lid_opened) \
+    X(lock_screen_end) \
+    X(lock_screen_start) \
+    X(prepare_for_suspend)
+
+#ifdef HAVE_SDT
+#define _SDT_HAS_SEMAPHORES 1
+#include <sys/sdt.h>
+#define PK_PROBE_SEMAPHORE(name) extern "C" unsigned short powerkit_##name##_semaphore;
+PK_PROBE_LIST(PK_PROBE_SEMAPHORE)
+#define PK_PROBE_ENABLED(name) __builtin_expect(powerkit_##name##_semaphore != 0, 0)
+#define PK_PROBE(name) DTRACE_PROBE(powerkit, name)
+#define PK_PROBE1(name, a) DTRACE_PROBE1(powerkit, name, a)
+#define PK_PROBE2(name, a, b) DTRACE_PROBE2(powerkit, name, a, b)
+#define PK_PROBE3(name, a, b, c) DTRACE_PROBE3(powerkit, name, a, b, c)
+#define PK_PROBE4(name, a, b, c, d) DTRACE_PROBE4(powerkit, name, a, b, c, d)
+#else
+#define PK_PROBE_ENABLED(name) 0
+#define PK_PROBE(name) do {} while (0)
+#define PK_PROBE1(name, a) do {} while (0)
+#define PK_PROBE2(name, a, b) do {} while (0)
+#define PK_PROBE3(name, a, b, c) do {} while (0)
+#define PK_PROBE4(name, a, b, c, d) do {} while (0)
+#endif
+
+#endif // PROBES_H
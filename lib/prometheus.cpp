@@ -0,0 +1,237 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "prometheus.h"
+#include "scheduler.h"
+#include "log.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QMapIterator>
+#include <QDebug>
+
+#include <stdio.h>
+#include <unistd.h>
+
+PrometheusExporter::PrometheusExporter(PowerKit *kit, QObject *parent)
+    : QObject(parent)
+    , kit(kit)
+    , interval(PROMETHEUS_INTERVAL)
+    , task(-1)
+{
+}
+
+PrometheusExporter::~PrometheusExporter()
+{
+    if (task>=0) { Scheduler::global()->removeTask(task); }
+}
+
+void PrometheusExporter::setFile(const QString &path)
+{
+    if (file == path) { return; }
+    file = path;
+    updateTask();
+    if (!file.isEmpty()) { write(); }
+}
+
+void PrometheusExporter::setInterval(int seconds)
+{
+    if (seconds<PROMETHEUS_MIN_INTERVAL) { seconds = PROMETHEUS_MIN_INTERVAL; }
+    if (interval == seconds) { return; }
+    interval = seconds;
+    if (task>=0) {
+        Scheduler::global()->removeTask(task);
+        task = -1;
+    }
+    updateTask();
+}
+
+QString PrometheusExporter::fileName()
+{
+    return file;
+}
+
+// only run while there is something to write
+void PrometheusExporter::updateTask()
+{
+    if (task<0) {
+        task = Scheduler::global()->addTask(this,
+                                            "write",
+                                            interval*1000,
+                                            false);
+    }
+    Scheduler::global()->setTaskActive(task, !file.isEmpty());
+}
+
+bool PrometheusExporter::write()
+{
+    if (!kit || file.isEmpty()) { return false; }
+    QString tmp = QString("%1/.%2.tmp")
+                  .arg(QFileInfo(file).absolutePath())
+                  .arg(QFileInfo(file).fileName());
+    QFile out(tmp);
+    if (!out.open(QIODevice::WriteOnly|QIODevice::Truncate)) {
+        qCWarning(PK_CORE) << "failed to write" << tmp;
+        return false;
+    }
+    QByteArray data = format(kit->Snapshot()).toUtf8();
+    bool ok = out.write(data) == data.size() && out.flush();
+    if (ok) { ok = fsync(out.handle()) == 0; }
+    out.close();
+    // rename() replaces the old file atomically, QFile::rename() won't
+    if (ok) { ok = ::rename(QFile::encodeName(tmp).constData(),
+                            QFile::encodeName(file).constData()) == 0; }
+    if (!ok) {
+        qCWarning(PK_CORE) << "failed to write" << file;
+        QFile::remove(tmp);
+    }
+    return ok;
+}
+
+QString PrometheusExporter::format(const QVariantMap &snapshot)
+{
+    QString out;
+    QVariantMap batteries = snapshot.value("batteries").toMap();
+
+    header(&out, "battery_energy_wh", "gauge", "Energy left in the battery.");
+    QMapIterator<QString, QVariant> i(batteries);
+    while (i.hasNext()) {
+        i.next();
+        sample(&out, "battery_energy_wh",
+               QString("device=\"%1\"").arg(escape(i.key())),
+               i.value().toMap().value("energy").toDouble());
+    }
+    header(&out, "battery_energy_full_wh", "gauge", "Energy when the battery is full.");
+    i.toFront();
+    while (i.hasNext()) {
+        i.next();
+        sample(&out, "battery_energy_full_wh",
+               QString("device=\"%1\"").arg(escape(i.key())),
+               i.value().toMap().value("energy_full").toDouble());
+    }
+    header(&out, "battery_energy_full_design_wh", "gauge", "Design energy of the battery.");
+    i.toFront();
+    while (i.hasNext()) {
+        i.next();
+        sample(&out, "battery_energy_full_design_wh",
+               QString("device=\"%1\"").arg(escape(i.key())),
+               i.value().toMap().value("energy_full_design").toDouble());
+    }
+    header(&out, "battery_percentage", "gauge", "Battery charge in percent.");
+    i.toFront();
+    while (i.hasNext()) {
+        i.next();
+        sample(&out, "battery_percentage",
+               QString("device=\"%1\"").arg(escape(i.key())),
+               i.value().toMap().value("percentage").toDouble());
+    }
+    header(&out, "battery_rate_watts", "gauge", "Battery charge or discharge rate.");
+    i.toFront();
+    while (i.hasNext()) {
+        i.next();
+        sample(&out, "battery_rate_watts",
+               QString("device=\"%1\"").arg(escape(i.key())),
+               i.value().toMap().value("rate").toDouble());
+    }
+
+    header(&out, "on_battery", "gauge", "1 if running on battery, 0 on AC.");
+    sample(&out, "on_battery", QString(), snapshot.value("on_battery").toBool()?1:0);
+    header(&out, "lid_closed", "gauge", "1 if the lid is closed.");
+    sample(&out, "lid_closed", QString(), snapshot.value("lid_closed").toBool()?1:0);
+
+    header(&out, "inhibitors", "gauge", "Active inhibitors by type and application.");
+    QStringList types;
+    types << "screensaver" << "power";
+    foreach (QString type, types) {
+        QMapIterator<QString, QVariant> app(snapshot.value(QString("inhibitors_%1").arg(type)).toMap());
+        while (app.hasNext()) {
+            app.next();
+            sample(&out, "inhibitors",
+                   QString("type=\"%1\",application=\"%2\"").arg(type).arg(escape(app.key())),
+                   app.value().toDouble());
+        }
+    }
+
+    header(&out, "suspends_total", "counter", "Suspend requests seen.");
+    sample(&out, "suspends_total", QString(), snapshot.value("suspends").toDouble());
+    header(&out, "resumes_total", "counter", "Resumes seen.");
+    sample(&out, "resumes_total", QString(), snapshot.value("resumes").toDouble());
+    header(&out, "suspend_seconds_total", "counter", "Time spent suspended.");
+    sample(&out, "suspend_seconds_total", QString(), snapshot.value("suspend_seconds").toDouble());
+    header(&out, "suspend_last_seconds", "gauge", "Duration of the last suspend.");
+    sample(&out, "suspend_last_seconds", QString(), snapshot.value("suspend_seconds_last").toDouble());
+
+    QVariantMap calls = snapshot.value("dbus_calls").toMap();
+    QVariantMap seconds = snapshot.value("dbus_call_seconds").toMap();
+    header(&out, "dbus_calls_total", "counter", "Blocking D-Bus calls made by PowerKit.");
+    QMapIterator<QString, QVariant> call(calls);
+    while (call.hasNext()) {
+        call.next();
+        sample(&out, "dbus_calls_total",
+               QString("method=\"%1\"").arg(escape(call.key())),
+               call.value().toDouble());
+    }
+    header(&out, "dbus_call_seconds_total", "counter", "Time spent in blocking D-Bus calls.");
+    call.toFront();
+    while (call.hasNext()) {
+        call.next();
+        sample(&out, "dbus_call_seconds_total",
+               QString("method=\"%1\"").arg(escape(call.key())),
+               seconds.value(call.key()).toDouble());
+    }
+
+    QVariantMap x11 = snapshot.value("x11").toMap();
+    QStringList counters;
+    counters << "calls" << "requests" << "round_trips";
+    foreach (QString counter, counters) {
+        QString name = QString("x11_%1_total").arg(counter);
+        header(&out, name, "counter", QString("X11 %1 by operation.").arg(counter).replace("_", " "));
+        QMapIterator<QString, QVariant> op(x11);
+        while (op.hasNext()) {
+            op.next();
+            sample(&out, name,
+                   QString("operation=\"%1\"").arg(escape(op.key())),
+                   op.value().toMap().value(counter).toDouble());
+        }
+    }
+
+    header(&out, "wakeups_total", "counter", "Scheduler timer wakeups.");
+    sample(&out, "wakeups_total", QString(), snapshot.value("wakeups").toDouble());
+    header(&out, "scheduler_active_tasks", "gauge", "Active scheduler tasks.");
+    sample(&out, "scheduler_active_tasks", QString(), snapshot.value("scheduler_active_tasks").toDouble());
+    return out;
+}
+
+QString PrometheusExporter::escape(const QString &value)
+{
+    QString result = value;
+    result.replace("\\", "\\\\");
+    result.replace("\"", "\\\"");
+    result.replace("\n", "\\n");
+    return result;
+}
+
+void PrometheusExporter::header(QString *out,
+                                const QString &name,
+                                const QString &type,
+                                const QString &help)
+{
+    out->append(QString("# HELP %1%2 %3\n").arg(PROMETHEUS_PREFIX).arg(name).arg(help));
+    out->append(QString("# TYPE %1%2 %3\n").arg(PROMETHEUS_PREFIX).arg(name).arg(type));
+}
+
+void PrometheusExporter::sample(QString *out,
+                                const QString &name,
+                                const QString &labels,
+                                double value)
+{
+    out->append(PROMETHEUS_PREFIX);
+    out->append(name);
+    if (!labels.isEmpty()) { out->append(QString("{%1}").arg(labels)); }
+    out->append(QString(" %1\n").arg(value, 0, 'g', 12));
+}
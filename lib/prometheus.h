@@ -0,0 +1,62 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef PROMETHEUS_H
+#define PROMETHEUS_H
+
+#include <QObject>
+#include <QPointer>
+#include <QString>
+#include <QVariantMap>
+
+#include "powerkit.h"
+
+#define PROMETHEUS_INTERVAL 60 // seconds between writes
+#define PROMETHEUS_MIN_INTERVAL 5
+#define PROMETHEUS_PREFIX "powerkit_"
+
+// Writes PowerKit::Snapshot() in the Prometheus text format,
+// meant for the node_exporter textfile collector. The file is written
+// to a temporary file next to the target and renamed, so a scrape never
+// sees a partial file. The snapshot is cached state, no bus calls.
+class PrometheusExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit PrometheusExporter(PowerKit *kit, QObject *parent = NULL);
+    ~PrometheusExporter();
+
+    void setFile(const QString &path);
+    void setInterval(int seconds);
+    QString fileName();
+
+    static QString format(const QVariantMap &snapshot);
+
+private:
+    QPointer<PowerKit> kit;
+    QString file;
+    int interval;
+    int task;
+
+    void updateTask();
+    static QString escape(const QString &value);
+    static void header(QString *out,
+                       const QString &name,
+                       const QString &type,
+                       const QString &help);
+    static void sample(QString *out,
+                       const QString &name,
+                       const QString &labels,
+                       double value);
+
+public slots:
+    bool write();
+};
+
+#endif // PROMETHEUS_H
@@ -8,61 +8,185 @@
 
 #include "rtc.h"
 
+#include <QFile>
+#include <QTextStream>
+
 #ifdef Q_OS_LINUX
 #include <linux/rtc.h>
 #include <sys/ioctl.h>
-#include <sys/time.h>
 #include <sys/types.h>
+#include <string.h>
 #include <fcntl.h>
 #include <unistd.h>
-#define RTC_DEV "/dev/rtc"
 #endif
 
-bool RTC::setAlarm(const QDateTime &date)
+RTC::RTC(const QString &device,
+         const QString &sysfs)
+    : device(device)
+    , sysfs(sysfs)
+    , fd(-1)
+    , lastMethod(MethodNone)
 {
-#ifdef Q_OS_LINUX
-    if (!date.isValid() || date.isNull()) { return false; }
-
-    int fd, result = 0;
-    struct rtc_time rtc;
+}
 
-    fd = open(RTC_DEV, O_RDONLY);
-    if (fd ==  -1) { return false; }
+RTC::~RTC()
+{
+#ifdef Q_OS_LINUX
+    if (fd != -1) { close(fd); }
+#endif
+}
 
-    result = ioctl(fd, RTC_UIE_OFF, 0);
-    if (result == -1) {
-        close(fd);
-        return false;
+// set and verify, ioctl first then sysfs
+bool RTC::setAlarm(const QDateTime &date)
+{
+    if (!date.isValid() || date.isNull()) { return false; }
+    if (date<=QDateTime::currentDateTime()) { return false; }
+    QDateTime utc = date.toUTC();
+    bool enabled = false;
+    bool ok = false;
+    if (setIoctl(utc, true)) {
+        QDateTime verify = readIoctl(&enabled, &ok);
+        if (ok && enabled && verify.toTime_t() == utc.toTime_t()) {
+            lastMethod = MethodIoctl;
+            return true;
+        }
     }
-
-    result = ioctl(fd, RTC_RD_TIME, &rtc);
-    if (result == -1) {
-        close(fd);
-        return false;
+    if (setSysfs(utc)) {
+        QDateTime verify = readSysfs(&ok);
+        if (ok && verify.toTime_t() == utc.toTime_t()) {
+            lastMethod = MethodSysfs;
+            return true;
+        }
     }
+    lastMethod = MethodNone;
+    return false;
+}
 
-    rtc.tm_year = date.date().year();
-    rtc.tm_mon = date.date().month();
-    rtc.tm_mday = date.date().day();
-    rtc.tm_hour = date.time().hour();
-    rtc.tm_min = date.time().minute();
-    rtc.tm_sec = date.time().second();
+bool RTC::clearAlarm()
+{
+    bool result = setIoctl(QDateTime::currentDateTime().toUTC(), false);
+    if (setSysfs(QDateTime())) { result = true; }
+    return result;
+}
 
-    result = ioctl(fd, RTC_ALM_SET, &rtc);
-    if (result == -1) {
-        close(fd);
-        return false;
+// the pending alarm (local time), invalid if none
+QDateTime RTC::alarm(bool *enabled)
+{
+    bool ok = false;
+    bool on = false;
+    QDateTime result = readIoctl(&on, &ok);
+    if (!ok) {
+        result = readSysfs(&ok);
+        on = ok && result.isValid();
     }
+    if (enabled) { *enabled = on; }
+    if (!on) { return QDateTime(); }
+    return result.toLocalTime();
+}
+
+// method of the last successful setAlarm()
+int RTC::method()
+{
+    return lastMethod;
+}
 
-    result = ioctl(fd, RTC_AIE_ON, 0);
-    if (result == -1) {
-        close(fd);
-        return false;
+QString RTC::methodName(int method)
+{
+    switch (method) {
+    case MethodIoctl:
+        return "ioctl";
+    case MethodSysfs:
+        return "sysfs";
+    default:;
     }
+    return "none";
+}
+
+bool RTC::openDevice()
+{
+#ifdef Q_OS_LINUX
+    if (fd != -1) { return true; }
+    fd = open(device.toLocal8Bit().constData(), O_RDONLY|O_CLOEXEC);
+    return fd != -1;
+#else
+    return false;
+#endif
+}
 
-    close(fd);
-    return true;
+bool RTC::setIoctl(const QDateTime &date, bool enabled)
+{
+#ifdef Q_OS_LINUX
+    if (!openDevice()) { return false; }
+    struct rtc_wkalrm alarm;
+    memset(&alarm, 0, sizeof(alarm));
+    alarm.enabled = enabled?1:0;
+    alarm.time.tm_year = date.date().year()-1900;
+    alarm.time.tm_mon = date.date().month()-1;
+    alarm.time.tm_mday = date.date().day();
+    alarm.time.tm_hour = date.time().hour();
+    alarm.time.tm_min = date.time().minute();
+    alarm.time.tm_sec = date.time().second();
+    alarm.time.tm_wday = -1;
+    alarm.time.tm_yday = -1;
+    alarm.time.tm_isdst = -1;
+    return ioctl(fd, RTC_WKALM_SET, &alarm) != -1;
 #else
+    Q_UNUSED(date)
+    Q_UNUSED(enabled)
     return false;
 #endif
 }
+
+QDateTime RTC::readIoctl(bool *enabled, bool *ok)
+{
+    *ok = false;
+    *enabled = false;
+#ifdef Q_OS_LINUX
+    if (!openDevice()) { return QDateTime(); }
+    struct rtc_wkalrm alarm;
+    memset(&alarm, 0, sizeof(alarm));
+    if (ioctl(fd, RTC_WKALM_RD, &alarm) == -1) { return QDateTime(); }
+    *ok = true;
+    *enabled = alarm.enabled;
+    return QDateTime(QDate(alarm.time.tm_year+1900,
+                           alarm.time.tm_mon+1,
+                           alarm.time.tm_mday),
+                     QTime(alarm.time.tm_hour,
+                           alarm.time.tm_min,
+                           alarm.time.tm_sec),
+                     Qt::UTC);
+#else
+    return QDateTime();
+#endif
+}
+
+// the kernel refuses a new alarm while one is set, clear first.
+// an invalid date only clears
+bool RTC::setSysfs(const QDateTime &date)
+{
+    QFile file(QString("%1/%2").arg(sysfs).arg(RTC_WAKEALARM));
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) { return false; }
+    if (file.write("0\n") == -1 || !file.flush()) { return false; }
+    if (!date.isValid()) { return true; }
+    file.close();
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Truncate)) { return false; }
+    QByteArray value = QByteArray::number(date.toTime_t()).append('\n');
+    return file.write(value) == value.size() && file.flush();
+}
+
+// empty when no alarm is set
+QDateTime RTC::readSysfs(bool *ok)
+{
+    *ok = false;
+    QFile file(QString("%1/%2").arg(sysfs).arg(RTC_WAKEALARM));
+    if (!file.open(QIODevice::ReadOnly)) { return QDateTime(); }
+    *ok = true;
+    QByteArray value = file.readAll().trimmed();
+    bool number = false;
+    uint seconds = value.toUInt(&number);
+    if (!number || seconds == 0) { return QDateTime(); }
+    QDateTime result;
+    result.setTimeSpec(Qt::UTC);
+    result.setTime_t(seconds);
+    return result;
+}
@@ -10,11 +10,49 @@
 #define RTC_H
 
 #include <QDateTime>
+#include <QString>
 
+#define RTC_DEV "/dev/rtc0"
+#define RTC_SYSFS "/sys/class/rtc/rtc0"
+#define RTC_WAKEALARM "wakealarm"
+
+// RTC wake alarm, full date.
+//
+// Uses the RTC_WKALM_SET ioctl on the device (kept open), and
+// <sysfs>/wakealarm (seconds since epoch) if that fails. Every alarm
+// is read back and verified. The RTC runs in UTC.
 class RTC
 {
 public:
-    static bool setAlarm(const QDateTime &date);
+    enum Method
+    {
+        MethodNone,
+        MethodIoctl,
+        MethodSysfs
+    };
+
+    explicit RTC(const QString &device = RTC_DEV,
+                 const QString &sysfs = RTC_SYSFS);
+    ~RTC();
+
+    bool setAlarm(const QDateTime &date);
+    bool clearAlarm();
+    QDateTime alarm(bool *enabled = NULL);
+    int method();
+
+    static QString methodName(int method);
+
+private:
+    QString device;
+    QString sysfs;
+    int fd;
+    int lastMethod;
+
+    bool openDevice();
+    bool setIoctl(const QDateTime &date, bool enabled);
+    QDateTime readIoctl(bool *enabled, bool *ok);
+    bool setSysfs(const QDateTime &date);
+    QDateTime readSysfs(bool *ok);
 };
 
 #endif // RTC_H
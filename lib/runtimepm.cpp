@@ -0,0 +1,161 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "runtimepm.h"
+
+#include <QDir>
+#include <QFile>
+
+RuntimePM::RuntimePM(const QString &root)
+    : root(root)
+    , enabled(false)
+{
+}
+
+// "0x8086" and "8086" alike
+static QString hexId(const QString &value)
+{
+    QString result = value.trimmed().toLower();
+    if (result.startsWith("0x")) { result = result.mid(2); }
+    return result;
+}
+
+QList<RuntimePM::Device> RuntimePM::devices()
+{
+    QList<Device> result;
+    QDir pci(QString("%1%2").arg(root).arg(RUNTIME_PM_PCI));
+    foreach (QString name, pci.entryList(QDir::Dirs|QDir::NoDotAndDotDot, QDir::Name)) {
+        Device device;
+        device.bus = "pci";
+        device.name = name;
+        device.path = pci.absoluteFilePath(name);
+        device.id = QString("%1:%2")
+                    .arg(hexId(SysfsTransaction::read(QString("%1/vendor").arg(device.path))))
+                    .arg(hexId(SysfsTransaction::read(QString("%1/device").arg(device.path))));
+        device.input = false;
+        result << device;
+    }
+    // interfaces (1-1:1.0) have no power/control of their own
+    QDir usb(QString("%1%2").arg(root).arg(RUNTIME_PM_USB));
+    foreach (QString name, usb.entryList(QDir::Dirs|QDir::NoDotAndDotDot, QDir::Name)) {
+        if (name.contains(":")) { continue; }
+        Device device;
+        device.bus = "usb";
+        device.name = name;
+        device.path = usb.absoluteFilePath(name);
+        device.id = QString("%1:%2")
+                    .arg(hexId(SysfsTransaction::read(QString("%1/idVendor").arg(device.path))))
+                    .arg(hexId(SysfsTransaction::read(QString("%1/idProduct").arg(device.path))));
+        device.input = false;
+        QDir interfaces(device.path);
+        foreach (QString interface, interfaces.entryList(QStringList() << QString("%1:*").arg(name),
+                                                         QDir::Dirs|QDir::NoDotAndDotDot)) {
+            if (SysfsTransaction::read(QString("%1/%2/bInterfaceClass")
+                                       .arg(device.path).arg(interface)) == "03") {
+                device.input = true;
+                break;
+            }
+        }
+        result << device;
+    }
+    return result;
+}
+
+bool RuntimePM::matches(const QString &id, const QStringList &list)
+{
+    foreach (QString entry, list) {
+        QString wanted = hexId(entry);
+        if (wanted.isEmpty()) { continue; }
+        if (wanted == id || wanted == id.section(":", 0, 0)) { return true; }
+    }
+    return false;
+}
+
+// all or nothing. enabled again (new lists) the earlier values are
+// restored first, so restore() always goes back to the original
+bool RuntimePM::enable(const QStringList &allow,
+                       const QStringList &deny,
+                       int delay)
+{
+    lastError.clear();
+    if (enabled && !restore()) { return false; }
+    delay = qBound(0, delay, RUNTIME_PM_DELAY_MAX);
+    SysfsTransaction transaction;
+    QStringList names;
+    foreach (Device device, devices()) {
+        QString control = QString("%1/power/control").arg(device.path);
+        if (!QFile::exists(control)) { continue; }
+        bool allowed = matches(device.id, allow);
+        if (matches(device.id, deny)) { continue; }
+        if (!allow.isEmpty() && !allowed) { continue; }
+        if (device.input && !allowed) { continue; }
+        // the delay first, then the device may suspend
+        QString autosuspend = QString("%1/power/autosuspend_delay_ms").arg(device.path);
+        if (QFile::exists(autosuspend)) { transaction.add(autosuspend, QString::number(delay)); }
+        transaction.add(control, "auto");
+        names << QString("%1 %2 (%3)").arg(device.bus).arg(device.name).arg(device.id);
+    }
+    if (!transaction.commit()) {
+        lastError = transaction.error();
+        return false;
+    }
+    active = transaction;
+    managedDevices = names;
+    enabled = true;
+    return true;
+}
+
+bool RuntimePM::restore()
+{
+    if (!enabled) { return true; }
+    if (!active.revert()) {
+        lastError = "failed to restore runtime pm";
+        return false;
+    }
+    active = SysfsTransaction();
+    managedDevices.clear();
+    enabled = false;
+    return true;
+}
+
+bool RuntimePM::isEnabled()
+{
+    return enabled;
+}
+
+QStringList RuntimePM::managed()
+{
+    return managedDevices;
+}
+
+// devices runtime suspended right now, managed or not
+QStringList RuntimePM::suspended()
+{
+    QStringList result;
+    foreach (Device device, devices()) {
+        if (SysfsTransaction::read(QString("%1/power/runtime_status").arg(device.path)) != "suspended") {
+            continue;
+        }
+        result << QString("%1 %2 (%3)").arg(device.bus).arg(device.name).arg(device.id);
+    }
+    return result;
+}
+
+QVariantMap RuntimePM::state()
+{
+    QVariantMap result;
+    result["enabled"] = enabled;
+    result["managed"] = managedDevices;
+    result["suspended"] = suspended();
+    return result;
+}
+
+QString RuntimePM::error()
+{
+    return lastError;
+}
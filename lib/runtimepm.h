@@ -0,0 +1,68 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef RUNTIMEPM_H
+#define RUNTIMEPM_H
+
+#include <QString>
+#include <QStringList>
+#include <QVariantMap>
+
+#include "sysfstransaction.h"
+
+#define RUNTIME_PM_PCI "/sys/bus/pci/devices"
+#define RUNTIME_PM_USB "/sys/bus/usb/devices"
+#define RUNTIME_PM_DELAY 2000 // ms, autosuspend_delay_ms
+#define RUNTIME_PM_DELAY_MAX 600000
+
+// Runtime PM for PCI and USB devices.
+//
+// enable() sets power/control to auto and the autosuspend delay on
+// every device that has them, in one SysfsTransaction, the values
+// it replaced are kept for restore(). Devices are matched by
+// "vendor:product" or "vendor" (hex, as in lspci -n and lsusb).
+// A device on the deny list is skipped, with an allow list only the
+// devices on it are managed. USB input devices are skipped unless
+// allowed, autosuspend makes most of them lag.
+// The root is prepended to every path, a fake sysfs tree for tests.
+class RuntimePM
+{
+public:
+    explicit RuntimePM(const QString &root = QString());
+
+    bool enable(const QStringList &allow,
+                const QStringList &deny,
+                int delay = RUNTIME_PM_DELAY);
+    bool restore();
+    bool isEnabled();
+    QStringList managed();
+    QStringList suspended();
+    QVariantMap state();
+    QString error();
+
+private:
+    struct Device
+    {
+        QString bus;
+        QString name;
+        QString path;
+        QString id; // vendor:product
+        bool input;
+    };
+
+    QString root;
+    QString lastError;
+    SysfsTransaction active;
+    QStringList managedDevices;
+    bool enabled;
+
+    QList<Device> devices();
+    static bool matches(const QString &id, const QStringList &list);
+};
+
+#endif // RUNTIMEPM_H
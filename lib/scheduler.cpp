@@ -0,0 +1,326 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "scheduler.h"
+#include "clock.h"
+
+#include <QCoreApplication>
+#include <QMetaObject>
+#include <algorithm>
+
+#ifdef Q_OS_LINUX
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+#include <stdint.h>
+#endif
+
+static QPointer<Scheduler> globalScheduler;
+
+Scheduler::Scheduler(QObject *parent) : QObject(parent)
+  , timerFd(-1)
+  , timerNotifier(0)
+  , lastId(0)
+  , wakeupCount(0)
+  , started(monotonicMsecs())
+  , planned(-1)
+{
+#ifdef Q_OS_LINUX
+    timerFd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK|TFD_CLOEXEC);
+    if (timerFd != -1) {
+        timerNotifier = new QSocketNotifier(timerFd,
+                                            QSocketNotifier::Read,
+                                            this);
+        connect(timerNotifier, SIGNAL(activated(int)),
+                this, SLOT(handleTimerFd()));
+        return;
+    }
+#endif
+    // fallback
+    timer.setSingleShot(true);
+#if QT_VERSION >= 0x050000
+    timer.setTimerType(Qt::VeryCoarseTimer);
+#endif
+    connect(&timer, SIGNAL(timeout()),
+            this, SLOT(fire()));
+}
+
+Scheduler::~Scheduler()
+{
+#ifdef Q_OS_LINUX
+    if (timerFd != -1) { close(timerFd); }
+#endif
+}
+
+// shared scheduler, owned by the application
+Scheduler *Scheduler::global()
+{
+    if (!globalScheduler) {
+        globalScheduler = new Scheduler(QCoreApplication::instance());
+    }
+    return globalScheduler;
+}
+
+int Scheduler::addTask(QObject *receiver,
+                       const char *member,
+                       int interval,
+                       bool active,
+                       int slack)
+{
+    if (!receiver || !member || interval<1) { return -1; }
+    Task task;
+    task.receiver = receiver;
+    task.member = member;
+    task.interval = interval;
+    task.slack = slack<0?interval/SCHEDULER_SLACK_DIVISOR:slack;
+    task.deadline = 0;
+    task.generation = 0;
+    task.active = active;
+    tasks[++lastId] = task;
+    planned = -1;
+    if (active) {
+        schedule(lastId, monotonicMsecs());
+        arm();
+    }
+    return lastId;
+}
+
+void Scheduler::removeTask(int id)
+{
+    if (!tasks.contains(id)) { return; }
+    tasks.remove(id); // heap entries are dropped when popped
+    planned = -1;
+    arm();
+}
+
+void Scheduler::setTaskActive(int id, bool active)
+{
+    if (!tasks.contains(id) || tasks[id].active == active) { return; }
+    tasks[id].active = active;
+    tasks[id].generation++;
+    planned = -1;
+    if (active) { schedule(id, monotonicMsecs()); }
+    arm();
+}
+
+void Scheduler::setTaskSlack(int id, int slack)
+{
+    if (!tasks.contains(id) || slack<0) { return; }
+    tasks[id].slack = slack;
+    planned = -1;
+    if (tasks[id].active) {
+        tasks[id].generation++;
+        schedule(id, monotonicMsecs());
+    }
+    arm();
+}
+
+bool Scheduler::isTaskActive(int id)
+{
+    if (!tasks.contains(id)) { return false; }
+    return tasks[id].active;
+}
+
+qlonglong Scheduler::wakeups()
+{
+    return wakeupCount;
+}
+
+double Scheduler::wakeupsPerHour()
+{
+    qint64 elapsed = monotonicMsecs()-started;
+    if (elapsed<1) { return 0; }
+    return (double)wakeupCount*3600000.0/(double)elapsed;
+}
+
+int Scheduler::activeTasks()
+{
+    int result = 0;
+    QMapIterator<int, Task> i(tasks);
+    while (i.hasNext()) {
+        i.next();
+        if (i.value().active) { result++; }
+    }
+    return result;
+}
+
+int Scheduler::pending()
+{
+    return byDeadline.size()+byLatest.size();
+}
+
+// count the wakeups needed to serve the current tasks for
+// 'duration' ms, without sleeping or running anything
+qlonglong Scheduler::simulate(qint64 duration)
+{
+    QMap<int, Task> savedTasks = tasks;
+    QVector<Entry> savedDeadline = byDeadline;
+    QVector<Entry> savedLatest = byLatest;
+
+    qlonglong result = 0;
+    qint64 end = monotonicMsecs()+duration;
+    qint64 now = nextWakeup();
+    while (now>=0 && now<=end) {
+        result++;
+        QList<int> due = takeDue(now);
+        for (int i=0;i<due.size();++i) { schedule(due.at(i), now); }
+        now = nextWakeup();
+    }
+
+    tasks = savedTasks;
+    byDeadline = savedDeadline;
+    byLatest = savedLatest;
+    return result;
+}
+
+// replaying an hour of heap operations is too much for every
+// stats call, only done again when a task was added, removed or
+// changed
+qlonglong Scheduler::plannedWakeupsPerHour()
+{
+    if (planned<0) { planned = simulate(3600000); }
+    return planned;
+}
+
+// the timer is always real time, see Clock for simulated time
+qint64 Scheduler::monotonicMsecs()
+{
+    return Clock::system()->monotonicMsecs();
+}
+
+qint64 Scheduler::alignedDeadline(qint64 now, qint64 interval)
+{
+    return ((now/interval)+1)*interval;
+}
+
+void Scheduler::schedule(int id, qint64 now)
+{
+    Task &task = tasks[id];
+    task.deadline = alignedDeadline(now, task.interval);
+    Entry entry;
+    entry.id = id;
+    entry.generation = task.generation;
+    entry.key = task.deadline;
+    byDeadline.append(entry);
+    std::push_heap(byDeadline.begin(), byDeadline.end());
+    entry.key = task.deadline+task.slack;
+    byLatest.append(entry);
+    std::push_heap(byLatest.begin(), byLatest.end());
+}
+
+bool Scheduler::isStale(const Entry &entry)
+{
+    if (!tasks.contains(entry.id)) { return true; }
+    const Task &task = tasks[entry.id];
+    return !task.active || task.generation != entry.generation;
+}
+
+// drop stale entries from the top, and from the whole heap
+// when most of it is stale (tasks toggled between wakeups)
+void Scheduler::prune(QVector<Entry> &heap)
+{
+    while (!heap.isEmpty() && isStale(heap.first())) {
+        std::pop_heap(heap.begin(), heap.end());
+        heap.removeLast();
+    }
+    if (heap.size()<=SCHEDULER_COMPACT*(tasks.size()+1)) { return; }
+    QVector<Entry> live;
+    for (int i=0;i<heap.size();++i) {
+        if (!isStale(heap.at(i))) { live.append(heap.at(i)); }
+    }
+    std::make_heap(live.begin(), live.end());
+    heap = live;
+}
+
+// earliest point where a task runs out of slack, -1 if idle
+qint64 Scheduler::nextWakeup()
+{
+    prune(byDeadline);
+    prune(byLatest);
+    if (byLatest.isEmpty()) { return -1; }
+    return byLatest.first().key;
+}
+
+// pop every task with a deadline at or before 'now'
+QList<int> Scheduler::takeDue(qint64 now)
+{
+    QList<int> result;
+    while (!byDeadline.isEmpty() && byDeadline.first().key<=now) {
+        Entry entry = byDeadline.first();
+        std::pop_heap(byDeadline.begin(), byDeadline.end());
+        byDeadline.removeLast();
+        if (isStale(entry)) { continue; }
+        tasks[entry.id].generation++;
+        result << entry.id;
+    }
+    return result;
+}
+
+void Scheduler::arm()
+{
+    qint64 next = nextWakeup();
+#ifdef Q_OS_LINUX
+    if (timerFd != -1) {
+        struct itimerspec spec;
+        spec.it_interval.tv_sec = 0;
+        spec.it_interval.tv_nsec = 0;
+        spec.it_value.tv_sec = 0;
+        spec.it_value.tv_nsec = 0;
+        if (next>=0) {
+            if (next<1) { next = 1; } // zero would disarm
+            spec.it_value.tv_sec = next/1000;
+            spec.it_value.tv_nsec = (next%1000)*1000000;
+        }
+        timerfd_settime(timerFd, TFD_TIMER_ABSTIME, &spec, NULL);
+        return;
+    }
+#endif
+    if (next<0) {
+        timer.stop();
+        return;
+    }
+    qint64 wait = next-monotonicMsecs();
+    if (wait<0) { wait = 0; }
+    timer.start((int)wait);
+}
+
+void Scheduler::fire()
+{
+    wakeupCount++;
+    qint64 now = monotonicMsecs();
+    QList<int> due = takeDue(now);
+    QList<QPointer<QObject> > receivers;
+    QList<QByteArray> members;
+    for (int i=0;i<due.size();++i) {
+        int id = due.at(i);
+        if (!tasks[id].receiver) {
+            tasks.remove(id);
+            continue;
+        }
+        schedule(id, now);
+        receivers << tasks[id].receiver;
+        members << tasks[id].member;
+    }
+    arm();
+    for (int i=0;i<receivers.size();++i) {
+        if (!receivers.at(i)) { continue; }
+        QMetaObject::invokeMethod(receivers.at(i),
+                                  members.at(i).constData());
+    }
+}
+
+void Scheduler::handleTimerFd()
+{
+#ifdef Q_OS_LINUX
+    uint64_t expirations = 0;
+    if (read(timerFd, &expirations, sizeof(expirations)) != sizeof(expirations)) {
+        return;
+    }
+#endif
+    fire();
+}
@@ -0,0 +1,102 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SCHEDULER_H
+#define SCHEDULER_H
+
+#include <QObject>
+#include <QTimer>
+#include <QMap>
+#include <QVector>
+#include <QPointer>
+#include <QByteArray>
+#include <QSocketNotifier>
+
+// default slack is a fraction of the task interval
+#define SCHEDULER_SLACK_DIVISOR 10
+// heaps are rebuilt without stale entries past this many per task
+#define SCHEDULER_COMPACT 4
+
+// all periodic work in powerkit goes through one timer.
+// deadlines are aligned to multiples of the task interval and every
+// task may run up to 'slack' ms late, the timer is armed for the
+// earliest point where some task would run out of slack and all tasks
+// that are due at that point run in the same wakeup.
+// on Linux the timer is a timerfd (CLOCK_MONOTONIC, absolute),
+// elsewhere a very coarse QTimer.
+class Scheduler : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit Scheduler(QObject *parent = NULL);
+    ~Scheduler();
+    static Scheduler *global();
+
+    int addTask(QObject *receiver,
+                const char *member,
+                int interval,
+                bool active = true,
+                int slack = -1);
+    void removeTask(int id);
+    void setTaskActive(int id, bool active);
+    void setTaskSlack(int id, int slack);
+    bool isTaskActive(int id);
+
+    qlonglong wakeups();
+    double wakeupsPerHour();
+    int activeTasks();
+    int pending(); // heap entries, stale ones included
+    qlonglong simulate(qint64 duration);
+    qlonglong plannedWakeupsPerHour(); // simulate(1h), cached per task set
+
+    static qint64 monotonicMsecs();
+
+private:
+    struct Task
+    {
+        QPointer<QObject> receiver;
+        QByteArray member;
+        qint64 interval;
+        qint64 slack;
+        qint64 deadline;
+        quint32 generation;
+        bool active;
+    };
+    struct Entry
+    {
+        qint64 key;
+        int id;
+        quint32 generation;
+        bool operator<(const Entry &other) const { return key>other.key; }
+    };
+    QMap<int, Task> tasks;
+    QVector<Entry> byDeadline; // min-heap on deadline
+    QVector<Entry> byLatest; // min-heap on deadline+slack
+    QTimer timer;
+    int timerFd;
+    QSocketNotifier *timerNotifier;
+    int lastId;
+    qlonglong wakeupCount;
+    qint64 started;
+    qlonglong planned; // -1 when the tasks changed
+
+    qint64 alignedDeadline(qint64 now, qint64 interval);
+    void schedule(int id, qint64 now);
+    bool isStale(const Entry &entry);
+    void prune(QVector<Entry> &heap);
+    qint64 nextWakeup();
+    QList<int> takeDue(qint64 now);
+
+private slots:
+    void arm();
+    void fire();
+    void handleTimerFd();
+};
+
+#endif // SCHEDULER_H
@@ -7,11 +7,13 @@
 */
 
 #include "screens.h"
+#include "xstats.h"
 
 QMap<QString, bool> Screens::outputsDpy(Display *dpy)
 {
     QMap<QString,bool> result;
     if (dpy == NULL) { return result; }
+    XStats::Scope stats(dpy, "outputs");
     XRRScreenResources *sr;
     XRROutputInfo *info;
     sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
@@ -47,6 +49,7 @@ QString Screens::internalDpy(Display *dpy)
 {
     QString result;
     if (dpy == NULL) { return result; }
+    XStats::Scope stats(dpy, "internal");
     XRRScreenResources *sr;
     sr = XRRGetScreenResourcesCurrent(dpy, DefaultRootWindow(dpy));
     if (sr) {
@@ -14,13 +14,21 @@
 #include <QProcess>
 
 #include "def.h"
+#include "scheduler.h"
+#include "probes.h"
+#include "log.h"
 
 ScreenSaver::ScreenSaver(QObject *parent) : QObject(parent)
+  , task(-1)
+  , clock(Clock::system())
 {
-    timer.setInterval(SS_TIMEOUT);
-    connect(&timer, SIGNAL(timeout()),
-            this, SLOT(timeOut()));
-    timer.start();
+    // only wake up while someone holds an inhibit
+    task = Scheduler::global()->addTask(this, "timeOut", SS_TIMEOUT, false);
+}
+
+void ScreenSaver::setClock(Clock *clock)
+{
+    this->clock = clock?clock:Clock::system();
 }
 
 int ScreenSaver::randInt(int low, int high)
@@ -36,7 +44,7 @@ quint32 ScreenSaver::genCookie()
     int high = 1000;
     quint32 cookie = (quint32)randInt(low, high);
     while(!clients.contains(cookie)) {
-        if (!clients.contains(cookie)) { clients[cookie] = QTime::currentTime(); }
+        if (!clients.contains(cookie)) { clients[cookie] = clock->monotonicMsecs(); }
         else { cookie = (quint32)randInt(low, high); }
     }
     return cookie;
@@ -44,11 +52,11 @@ quint32 ScreenSaver::genCookie()
 
 void ScreenSaver::checkForExpiredClients()
 {
-    QMapIterator<quint32, QTime> client(clients);
+    qint64 now = clock->monotonicMsecs();
+    QMapIterator<quint32, qint64> client(clients);
     while (client.hasNext()) {
         client.next();
-        if (client.value()
-            .secsTo(QTime::currentTime())>=SS_MAX_INHIBIT) {
+        if ((now-client.value())/1000>=SS_MAX_INHIBIT) {
             clients.remove(client.key());
         }
     }
@@ -64,6 +72,12 @@ bool ScreenSaver::canInhibit()
 void ScreenSaver::timeOut()
 {
     if (canInhibit()) { SimulateUserActivity(); }
+    updateTask();
+}
+
+void ScreenSaver::updateTask()
+{
+    Scheduler::global()->setTaskActive(task, !clients.isEmpty());
 }
 
 void ScreenSaver::pingPM()
@@ -89,6 +103,10 @@ quint32 ScreenSaver::Inhibit(const QString &application,
                              const QString &reason)
 {
     quint32 cookie = genCookie();
+    if (PK_PROBE_ENABLED(inhibit_add)) {
+        PK_PROBE3(inhibit_add, 0, application.toUtf8().constData(), cookie);
+    }
+    FlightRecorder::record("inhibit_add", 0, cookie);
     emit newInhibit(application, reason, cookie);
     timeOut();
     return cookie;
@@ -97,6 +115,8 @@ quint32 ScreenSaver::Inhibit(const QString &application,
 void ScreenSaver::UnInhibit(quint32 cookie)
 {
     if (clients.contains(cookie)) { clients.remove(cookie); }
+    PK_PROBE2(inhibit_remove, 0, cookie);
+    FlightRecorder::record("inhibit_remove", 0, cookie);
     timeOut();
     emit removedInhibit(cookie);
 }
@@ -10,21 +10,24 @@
 #define SCREENSAVER_H
 
 #include <QObject>
-#include <QTimer>
 #include <QTime>
 #include <QMap>
 #include <QString>
 
+#include "clock.h"
+
 class ScreenSaver : public QObject
 {
     Q_OBJECT
 
 public:
     explicit ScreenSaver(QObject *parent = NULL);
+    void setClock(Clock *clock);
 
 private:
-    QTimer timer;
-    QMap<quint32, QTime> clients;
+    int task;
+    Clock *clock;
+    QMap<quint32, qint64> clients; // monotonic msecs at inhibit
 
 signals:
     void newInhibit(const QString &application,
@@ -38,6 +41,7 @@ private slots:
     void checkForExpiredClients();
     bool canInhibit();
     void timeOut();
+    void updateTask();
     void pingPM();
 
 public slots:
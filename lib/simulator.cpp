@@ -0,0 +1,367 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "simulator.h"
+#include "clock.h"
+#include "def.h"
+
+#include <QRunnable>
+#include <QSettings>
+#include <QStringList>
+#include <QThreadPool>
+#include <QVector>
+
+Simulator::Model::Model()
+    : activeRate(0)
+    , suspendRate(SIM_SUSPEND_RATE)
+    , backlightShare(SIM_BACKLIGHT_SHARE)
+{
+}
+
+Simulator::Result::Result()
+    : batteryUsed(0)
+    , minLevel(100)
+    , awakeSeconds(0)
+    , suspendedSeconds(0)
+    , suspends(0)
+    , hibernates(0)
+    , powerOffs(0)
+    , criticalActions(0)
+    , warnings(0)
+    , depleted(0)
+{
+}
+
+// state of one simulation run
+class SimulatorRun
+{
+public:
+    enum State {
+        Awake,
+        Suspended,
+        Off // hibernated, powered off or depleted
+    };
+
+    SimulatorRun(const PowerSettings &settings,
+                 const Simulator::Model &model,
+                 qint64 start)
+        : clock(start)
+        , policy(settings, &clock)
+        , model(model)
+        , level(100)
+        , onBattery(false)
+        , state(Awake)
+        , userBacklight(-1)
+        , backlight(1)
+    {
+    }
+
+    TestClock clock;
+    Policy policy;
+    Simulator::Model model;
+    Simulator::Result result;
+    double level;
+    bool onBattery;
+    int state;
+    int userBacklight; // recorded brightness, -1 if not adjustable
+    double backlight; // relative to the recorded brightness
+
+    // %/hour in the current state
+    double rate()
+    {
+        if (!onBattery) { return 0; }
+        switch(state) {
+        case Awake:
+            return model.activeRate*((1.0-model.backlightShare)+
+                                     model.backlightShare*backlight);
+        case Suspended:
+            return model.suspendRate;
+        default:;
+        }
+        return 0;
+    }
+
+    void drain(qint64 msecs)
+    {
+        double used = qMin(level, rate()*(double)msecs/3600000.0);
+        level -= used;
+        result.batteryUsed += used;
+        if (level<result.minLevel) { result.minLevel = level; }
+        if (state == Suspended) { result.suspendedSeconds += msecs/1000; }
+        else if (state == Awake && onBattery) { result.awakeSeconds += msecs/1000; }
+        if (onBattery && level<=0 && state != Off) {
+            result.depleted++;
+            state = Off;
+        }
+        if (state == Awake) { clock.advance(msecs); }
+        else { clock.suspend(msecs); }
+    }
+
+    void evaluate()
+    {
+        if (state != Awake) { return; }
+        double perSecond = rate()/3600.0;
+        qlonglong timeToEmpty = 0;
+        qlonglong timeToCritical = -1;
+        if (perSecond>0) {
+            timeToEmpty = (qlonglong)(level/perSecond);
+            double critical = (double)policy.settings().criticalBattery;
+            timeToCritical = level>critical?(qlonglong)((level-critical)/perSecond):0;
+        }
+        Policy::Actions actions = policy.battery(level,
+                                                 onBattery,
+                                                 timeToEmpty,
+                                                 timeToCritical);
+        int off = result.hibernates+result.powerOffs;
+        apply(actions);
+        if (result.hibernates+result.powerOffs>off) { result.criticalActions++; }
+    }
+
+    void apply(const Policy::Actions &actions)
+    {
+        if (state != Awake) { return; }
+        foreach (Policy::Action action, actions) {
+            switch(action.type) {
+            case Policy::ActionSuspend:
+            case Policy::ActionHybridSleep:
+                result.suspends++;
+                state = Suspended;
+                return;
+            case Policy::ActionHibernate:
+                result.hibernates++;
+                state = Off;
+                return;
+            case Policy::ActionPowerOff:
+                result.powerOffs++;
+                state = Off;
+                return;
+            case Policy::ActionWarnLow:
+            case Policy::ActionWarnVeryLow:
+                result.warnings++;
+                break;
+            case Policy::ActionBacklight:
+                if (userBacklight>0) {
+                    backlight = qBound(0.0, action.value/(double)userBacklight, 2.0);
+                }
+                break;
+            default:;
+            }
+        }
+    }
+
+    // the user is back
+    void wake()
+    {
+        if (state == Awake) { return; }
+        if (onBattery && level<=0) { return; }
+        state = Awake;
+        policy.resetIdle();
+    }
+
+    // move to 'time' in SIM_STEP steps, while 'away' the user is gone
+    // and idle ticks continue from 'idle' minutes at 'awaySince'
+    void moveTo(qint64 time, bool away, int idle, qint64 awaySince)
+    {
+        while (clock.wallMsecs()<time) {
+            qint64 step = qMin((qint64)SIM_STEP, time-clock.wallMsecs());
+            drain(step);
+            if (state != Awake) { continue; }
+            if (away && step == SIM_STEP) {
+                int minutes = idle+(int)((clock.wallMsecs()-awaySince)/60000);
+                apply(policy.idle(minutes, onBattery, false));
+            }
+            if (onBattery) { evaluate(); }
+        }
+    }
+};
+
+class SimulatorJob : public QRunnable
+{
+public:
+    SimulatorJob(const Simulator *simulator,
+                 const PowerSettings &settings,
+                 Simulator::Result *result)
+        : simulator(simulator)
+        , settings(settings)
+        , result(result)
+    {
+    }
+    void run()
+    {
+        *result = simulator->run(settings);
+    }
+
+private:
+    const Simulator *simulator;
+    PowerSettings settings;
+    Simulator::Result *result;
+};
+
+Simulator::Simulator(const QList<TraceEvent> &trace,
+                     const Model &model)
+    : trace(trace)
+    , model(model)
+{
+    if (this->model.activeRate<=0) {
+        this->model.activeRate = measureActiveRate(trace);
+    }
+}
+
+Simulator::Result Simulator::run(const PowerSettings &settings) const
+{
+    if (trace.isEmpty()) { return Result(); }
+    SimulatorRun sim(settings, model, trace.first().time);
+
+    bool away = false; // recording is suspended
+    qint64 awaySince = 0;
+    int idle = 0;
+    double recorded = -1;
+
+    foreach (const TraceEvent &event, trace) {
+        sim.moveTo(event.time, away, idle, awaySince);
+        const qint64 *v = event.values;
+        switch(event.type) {
+        case TraceEvent::TraceBattery:
+        {
+            double left = (double)v[0]/100.0;
+            if (recorded<0) {
+                sim.level = left;
+                sim.result.minLevel = left;
+            }
+            else if (v[1] == 0 && left>recorded) {
+                sim.level = qMin(100.0, sim.level+left-recorded);
+            }
+            recorded = left;
+            sim.onBattery = v[1] != 0;
+            if (sim.onBattery) { sim.evaluate(); }
+            break;
+        }
+        case TraceEvent::TraceLid:
+            if (v[0]) { sim.apply(sim.policy.lidClosed(sim.onBattery, v[2] != 0)); }
+            else {
+                sim.wake();
+                sim.apply(sim.policy.lidOpened());
+            }
+            break;
+        case TraceEvent::TracePower:
+            sim.onBattery = v[0] != 0;
+            sim.userBacklight = (int)v[1];
+            sim.backlight = 1;
+            if (sim.onBattery) {
+                sim.apply(sim.policy.switchedToBattery((int)v[1]));
+            } else {
+                sim.apply(sim.policy.switchedToAC((int)v[1]));
+                sim.wake(); // depleted
+            }
+            break;
+        case TraceEvent::TraceIdle:
+            if ((int)v[0]<idle) { sim.wake(); }
+            idle = (int)v[0];
+            if (sim.state != SimulatorRun::Awake) { break; }
+            sim.apply(sim.policy.idle(idle, sim.onBattery, v[2] != 0));
+            break;
+        case TraceEvent::TraceActivity:
+            sim.wake();
+            sim.policy.resetIdle();
+            break;
+        case TraceEvent::TraceSuspend:
+            away = true;
+            awaySince = event.time;
+            break;
+        case TraceEvent::TraceResume:
+            away = false;
+            idle = 0;
+            sim.wake();
+            sim.policy.resetIdle();
+            break;
+        default:; // settings and inhibitors are not simulated
+        }
+    }
+    return sim.result;
+}
+
+// runs are independent, spread them over a thread pool
+QList<Simulator::Result> Simulator::sweep(const QList<PowerSettings> &settings,
+                                          int threads) const
+{
+    QVector<Result> results(settings.size());
+    QThreadPool pool;
+    if (threads>0) { pool.setMaxThreadCount(threads); }
+    for (int i=0;i<settings.size();++i) {
+        pool.start(new SimulatorJob(this, settings.at(i), &results[i]));
+    }
+    pool.waitForDone();
+    return results.toList();
+}
+
+double Simulator::activeRate() const
+{
+    return model.activeRate;
+}
+
+// average discharge between battery events while awake on battery
+double Simulator::measureActiveRate(const QList<TraceEvent> &trace)
+{
+    double used = 0;
+    qint64 msecs = 0;
+    int last = -1;
+    for (int i=0;i<trace.size();++i) {
+        const TraceEvent &event = trace.at(i);
+        if (event.type == TraceEvent::TraceSuspend ||
+            event.type == TraceEvent::TraceResume) {
+            last = -1;
+            continue;
+        }
+        if (event.type != TraceEvent::TraceBattery) { continue; }
+        if (!event.values[1]) {
+            last = -1;
+            continue;
+        }
+        if (last>=0 && event.values[0]<trace.at(last).values[0]) {
+            used += (double)(trace.at(last).values[0]-event.values[0])/100.0;
+            msecs += event.time-trace.at(last).time;
+        }
+        last = i;
+    }
+    if (msecs<SIM_MIN_MEASURE*1000 || used<=0) { return SIM_ACTIVE_RATE; }
+    return used*3600000.0/(double)msecs;
+}
+
+// a powerkit.conf style file, missing keys keep the default value
+PowerSettings Simulator::loadSettings(const QString &path)
+{
+    QSettings file(path, QSettings::IniFormat);
+    QVariantMap map;
+    QStringList keys = PowerSettings().toMap().keys();
+    foreach (QString key, keys) {
+        if (file.contains(key)) { map[key] = file.value(key); }
+    }
+    return PowerSettings::fromMap(map);
+}
+
+QString Simulator::header()
+{
+    return QString("settings\tbattery_used\tmin_level\tawake_hours\tsuspended_hours"
+                   "\tsuspends\thibernates\tpoweroffs\tcritical\twarnings\tdepleted");
+}
+
+QString Simulator::format(const QString &name, const Result &result)
+{
+    return QString("%1\t%2\t%3\t%4\t%5\t%6\t%7\t%8\t%9\t%10\t%11")
+            .arg(name)
+            .arg(result.batteryUsed, 0, 'f', 1)
+            .arg(result.minLevel, 0, 'f', 1)
+            .arg((double)result.awakeSeconds/3600.0, 0, 'f', 2)
+            .arg((double)result.suspendedSeconds/3600.0, 0, 'f', 2)
+            .arg(result.suspends)
+            .arg(result.hibernates)
+            .arg(result.powerOffs)
+            .arg(result.criticalActions)
+            .arg(result.warnings)
+            .arg(result.depleted);
+}
@@ -0,0 +1,79 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SIMULATOR_H
+#define SIMULATOR_H
+
+#include <QList>
+#include <QString>
+
+#include "policy.h"
+#include "trace.h"
+
+#define SIM_STEP 60000 // msecs between battery evaluations
+#define SIM_ACTIVE_RATE 10.0 // %/hour, if the trace has no usable discharge
+#define SIM_SUSPEND_RATE 0.5 // %/hour
+#define SIM_BACKLIGHT_SHARE 0.3 // part of the active power used by the backlight
+#define SIM_MIN_MEASURE 600 // seconds of discharge needed to measure the rate
+
+// What-if simulator for power settings.
+//
+// Runs a recorded trace (see TraceRecorder) through Policy with
+// candidate settings on a virtual clock. The recorded user activity
+// (idle, lid, AC, resume) is kept, the decisions and the battery level
+// are simulated: while the recording was suspended the user is
+// considered away and idle keeps growing, a simulated suspend lasts
+// until the user is back.
+//
+// The battery drains at the active rate measured from the trace
+// (scaled by the backlight), at SIM_SUSPEND_RATE while suspended and
+// not at all while hibernated or off. On AC the recorded charge is
+// applied.
+class Simulator
+{
+public:
+    struct Model
+    {
+        Model();
+        double activeRate; // %/hour, <= 0 to measure from the trace
+        double suspendRate; // %/hour
+        double backlightShare;
+    };
+    struct Result
+    {
+        Result();
+        double batteryUsed; // % of full capacity
+        double minLevel;
+        qint64 awakeSeconds; // awake on battery
+        qint64 suspendedSeconds;
+        int suspends;
+        int hibernates;
+        int powerOffs;
+        int criticalActions;
+        int warnings;
+        int depleted;
+    };
+
+    explicit Simulator(const QList<TraceEvent> &trace,
+                       const Model &model = Model());
+    Result run(const PowerSettings &settings) const;
+    QList<Result> sweep(const QList<PowerSettings> &settings,
+                        int threads = 0) const;
+    double activeRate() const;
+
+    static double measureActiveRate(const QList<TraceEvent> &trace);
+    static PowerSettings loadSettings(const QString &path);
+    static QString header();
+    static QString format(const QString &name, const Result &result);
+
+private:
+    QList<TraceEvent> trace;
+    Model model;
+};
+
+#endif // SIMULATOR_H
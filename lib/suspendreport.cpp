@@ -0,0 +1,304 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "suspendreport.h"
+#include "common.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSettings>
+#include <QStringList>
+
+SuspendReport::Cycle::Cycle()
+    : start(0)
+    , asleep(-1)
+    , hwSleep(-1)
+    , failed(false)
+    , energyBefore(-1)
+    , energyAfter(-1)
+{
+    for (int i=0;i<Stages;++i) { ready[i] = -1; }
+}
+
+// resume to the last stage reached
+qint64 SuspendReport::Cycle::latency()
+{
+    qint64 result = -1;
+    for (int i=0;i<Stages;++i) {
+        if (ready[i]>result) { result = ready[i]; }
+    }
+    return result;
+}
+
+double SuspendReport::Cycle::drain()
+{
+    if (asleep<SUSPEND_DRAIN_MIN_ASLEEP ||
+        energyBefore<0 ||
+        energyAfter<0 ||
+        energyAfter>energyBefore) { return -1; }
+    return (energyBefore-energyAfter)/((double)asleep/3600000.0);
+}
+
+SuspendReport::SuspendReport(const QString &path,
+                             const QString &stats)
+    : file(path)
+    , statsPath(stats)
+    , clock(Clock::system())
+    , saving(false)
+    , suspendBoottime(-1)
+    , suspendMonotonic(-1)
+    , resumeMonotonic(-1)
+    , energyPending(false)
+{
+    if (file.isEmpty()) {
+        file = QString("%1/%2/%3")
+               .arg(Common::confDir())
+               .arg(SUSPEND_REPORT_DIR)
+               .arg(SUSPEND_REPORT_FILE);
+        // like health.conf, saves in the config dir reloaded the tray
+        QString old = QString("%1/%2").arg(Common::confDir()).arg(SUSPEND_REPORT_FILE);
+        if (QFile::exists(old) && !QFile::exists(file)) {
+            QDir().mkpath(QFileInfo(file).absolutePath());
+            QFile::rename(old, file);
+        }
+    }
+    QDir().mkpath(QFileInfo(file).absolutePath());
+    reload();
+}
+
+void SuspendReport::setClock(Clock *clock)
+{
+    this->clock = clock?clock:Clock::system();
+}
+
+// only one process (the session) should write the report
+void SuspendReport::setSaving(bool enabled)
+{
+    saving = enabled;
+}
+
+// energy is the battery energy (Wh) if on battery
+void SuspendReport::suspending(double energy)
+{
+    suspendBoottime = clock->boottimeMsecs();
+    suspendMonotonic = clock->monotonicMsecs();
+    resumeMonotonic = -1;
+    energyPending = false;
+    statsBefore = kernelStats(statsPath);
+    Cycle cycle;
+    cycle.start = clock->wallMsecs();
+    cycle.energyBefore = energy;
+    history << cycle;
+    while (history.size()>SUSPEND_REPORT_MAX) { history.removeFirst(); }
+}
+
+void SuspendReport::resuming()
+{
+    if (!isSuspended() || history.isEmpty()) { return; }
+    qint64 boottime = clock->boottimeMsecs()-suspendBoottime;
+    qint64 monotonic = clock->monotonicMsecs()-suspendMonotonic;
+    resumeMonotonic = clock->monotonicMsecs();
+    suspendBoottime = -1;
+
+    Cycle &cycle = history.last();
+    cycle.asleep = qMax((qint64)0, boottime-monotonic);
+    energyPending = cycle.energyBefore>=0;
+    QVariantMap stats = kernelStats(statsPath);
+    if (!stats.isEmpty() && !statsBefore.isEmpty()) {
+        cycle.failed = stats.value("fail").toLongLong()>statsBefore.value("fail").toLongLong();
+        if (stats.contains("total_hw_sleep") &&
+            stats.value("total_hw_sleep") != statsBefore.value("total_hw_sleep")) {
+            cycle.hwSleep = stats.value("last_hw_sleep").toLongLong()/1000; // usecs
+        }
+    }
+    save();
+}
+
+// battery energy on each battery update after resume, -1 if on
+// AC. the first reading that differs from the one before the suspend
+// is kept, a stale one would count as no drain at all
+void SuspendReport::resumedEnergy(double energy)
+{
+    if (!energyPending || resumeMonotonic<0 || history.isEmpty()) { return; }
+    if (energy<0 || clock->monotonicMsecs()-resumeMonotonic>SUSPEND_ENERGY_WAIT) {
+        energyPending = false;
+        return;
+    }
+    Cycle &cycle = history.last();
+    if (qRound64(energy*1000) == qRound64(cycle.energyBefore*1000)) { return; }
+    cycle.energyAfter = energy;
+    energyPending = false;
+    save();
+}
+
+// time weighted drain of the recent measured cycles, Wh per hour
+double SuspendReport::drainRate()
+{
+    double energy = 0;
+    double hours = 0;
+    int samples = 0;
+    for (int i=history.size()-1;i>=0 && samples<SUSPEND_DRAIN_SAMPLES;--i) {
+        Cycle cycle = history.at(i);
+        if (cycle.drain()<0) { continue; }
+        energy += cycle.energyBefore-cycle.energyAfter;
+        hours += (double)cycle.asleep/3600000.0;
+        samples++;
+    }
+    if (samples == 0 || hours<=0) { return -1; }
+    return energy/hours;
+}
+
+// minutes until 'energy' (Wh) is down to 'reserve' percent of
+// 'full' at the measured drain, for the automatic wake alarm.
+// -1 until a suspend on battery has been measured
+int SuspendReport::minutesToReserve(double energy, double full, int reserve)
+{
+    double drain = drainRate()*SUSPEND_DRAIN_MARGIN;
+    if (drain<=0 || full<=0) { return -1; }
+    double usable = energy-full*reserve/100.0;
+    int minutes = (int)(usable/drain*60.0);
+    return qBound(SUSPEND_WAKEUP_MIN, minutes, SUSPEND_WAKEUP_MAX);
+}
+
+// first time a stage is reached after a resume
+void SuspendReport::ready(SuspendReport::Stage stage)
+{
+    if (resumeMonotonic<0 || history.isEmpty() || stage>=Stages) { return; }
+    Cycle &cycle = history.last();
+    if (cycle.ready[stage]>=0) { return; }
+    cycle.ready[stage] = clock->monotonicMsecs()-resumeMonotonic;
+    save();
+}
+
+bool SuspendReport::isSuspended()
+{
+    return suspendBoottime>=0;
+}
+
+QList<SuspendReport::Cycle> SuspendReport::cycles()
+{
+    return history;
+}
+
+SuspendReport::Cycle SuspendReport::last()
+{
+    if (history.isEmpty()) { return Cycle(); }
+    return history.last();
+}
+
+void SuspendReport::reload()
+{
+    if (isSuspended()) { return; }
+    history.clear();
+    QSettings settings(file, QSettings::IniFormat);
+    foreach (QString value, settings.value("cycles").toString()
+                            .split(",", QString::SkipEmptyParts)) {
+        QStringList values = value.split(":");
+        if (values.size() != 4+Stages && values.size() != 6+Stages) { continue; }
+        Cycle cycle;
+        cycle.start = values.at(0).toLongLong();
+        cycle.asleep = values.at(1).toLongLong();
+        cycle.hwSleep = values.at(2).toLongLong();
+        cycle.failed = values.at(3).toInt();
+        for (int i=0;i<Stages;++i) { cycle.ready[i] = values.at(4+i).toLongLong(); }
+        if (values.size() == 6+Stages) {
+            cycle.energyBefore = values.at(4+Stages).toDouble();
+            cycle.energyAfter = values.at(5+Stages).toDouble();
+        }
+        history << cycle;
+    }
+}
+
+QVariantMap SuspendReport::report()
+{
+    QVariantMap result;
+    QVariantList list;
+    qint64 asleep = 0;
+    qint64 latency = 0;
+    int resumed = 0;
+    for (int i=0;i<history.size();++i) {
+        Cycle cycle = history.at(i);
+        QVariantMap entry;
+        entry["start"] = cycle.start/1000;
+        entry["asleep_msecs"] = cycle.asleep;
+        entry["hw_sleep_msecs"] = cycle.hwSleep;
+        entry["failed"] = cycle.failed;
+        entry["resume_msecs"] = cycle.latency();
+        entry["drain_wh_per_hour"] = cycle.drain();
+        for (int s=0;s<Stages;++s) {
+            entry[QString("%1_msecs").arg(stageName(s))] = cycle.ready[s];
+        }
+        list << entry;
+        if (cycle.asleep<0) { continue; }
+        asleep += cycle.asleep;
+        if (cycle.latency()>=0) {
+            latency += cycle.latency();
+            resumed++;
+        }
+    }
+    result["cycles"] = list;
+    result["asleep_msecs"] = asleep;
+    result["resume_msecs_avg"] = resumed>0?latency/resumed:-1;
+    result["drain_wh_per_hour"] = drainRate();
+    result["kernel"] = kernelStats(statsPath);
+    return result;
+}
+
+QString SuspendReport::stageName(int stage)
+{
+    switch (stage) {
+    case StageDevices:
+        return "devices";
+    case StageLock:
+        return "lock";
+    case StageTray:
+        return "tray";
+    default:;
+    }
+    return QString();
+}
+
+// one value per file, numbers as qlonglong
+QVariantMap SuspendReport::kernelStats(const QString &path)
+{
+    QVariantMap result;
+    QDir dir(path);
+    if (!dir.exists()) { return result; }
+    foreach (QString name, dir.entryList(QDir::Files)) {
+        QFile entry(dir.absoluteFilePath(name));
+        if (!entry.open(QIODevice::ReadOnly)) { continue; }
+        QString value = QString::fromUtf8(entry.readAll()).trimmed();
+        bool ok = false;
+        qlonglong number = value.toLongLong(&ok);
+        if (ok) { result[name] = number; }
+        else { result[name] = value; }
+    }
+    return result;
+}
+
+void SuspendReport::save()
+{
+    if (!saving) { return; }
+    QStringList values;
+    for (int i=0;i<history.size();++i) {
+        const Cycle &cycle = history.at(i);
+        QStringList value;
+        value << QString::number(cycle.start)
+              << QString::number(cycle.asleep)
+              << QString::number(cycle.hwSleep)
+              << QString::number(cycle.failed?1:0);
+        for (int s=0;s<Stages;++s) { value << QString::number(cycle.ready[s]); }
+        value << QString::number(cycle.energyBefore, 'f', 3)
+              << QString::number(cycle.energyAfter, 'f', 3);
+        values << value.join(":");
+    }
+    QSettings settings(file, QSettings::IniFormat);
+    settings.setValue("cycles", values.join(","));
+    settings.sync();
+}
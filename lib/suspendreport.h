@@ -0,0 +1,103 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SUSPENDREPORT_H
+#define SUSPENDREPORT_H
+
+#include <QString>
+#include <QList>
+#include <QVariantMap>
+
+#include "clock.h"
+
+#define SUSPEND_REPORT_DIR "suspend" // not in the watched config dir
+#define SUSPEND_REPORT_FILE "suspend.conf"
+#define SUSPEND_REPORT_MAX 100 // cycles kept
+#define SUSPEND_STATS_PATH "/sys/power/suspend_stats"
+#define SUSPEND_DRAIN_MIN_ASLEEP 1800000 // msecs asleep needed for a drain sample
+#define SUSPEND_DRAIN_SAMPLES 10 // recent cycles in the drain average
+#define SUSPEND_ENERGY_WAIT 300000 // msecs after resume to wait for a fresh energy reading
+#define SUSPEND_DRAIN_MARGIN 1.2 // measured suspend drain is scaled up by this
+#define SUSPEND_WAKEUP_MIN 5 // minutes
+#define SUSPEND_WAKEUP_MAX 10080
+
+// Suspend/resume timing per cycle.
+//
+// Time asleep is the boottime delta minus the monotonic delta between
+// the suspend and resume signals, so time spent awake in the suspend
+// handshake is not counted. Resume latency is measured from the
+// resume signal to each ready stage (devices refreshed, screen lock
+// confirmed, tray drawn). The kernel counters in
+// /sys/power/suspend_stats are read at resume to flag failed cycles.
+// Battery energy before and after gives the drain while suspended,
+// averaged over the recent cycles that started on battery. UPower
+// may report the energy from before the suspend for a while after
+// resume, a reading that has not moved is ignored and the next one
+// is waited for (SUSPEND_ENERGY_WAIT at most).
+// Stored in a small ini file, like HealthTracker.
+class SuspendReport
+{
+public:
+    enum Stage
+    {
+        StageDevices,
+        StageLock,
+        StageTray,
+        Stages
+    };
+    struct Cycle
+    {
+        Cycle();
+        qint64 start; // wall msecs at suspend
+        qint64 asleep; // msecs, -1 while suspended
+        qint64 ready[Stages]; // msecs after resume, -1 if not reached
+        qint64 hwSleep; // msecs in the lowest state (last_hw_sleep), -1 if unknown
+        bool failed; // the kernel counted a failed suspend
+        double energyBefore; // Wh, -1 if not on battery
+        double energyAfter;
+        qint64 latency();
+        double drain(); // Wh per hour asleep, -1 if unknown
+    };
+
+    explicit SuspendReport(const QString &path = QString(),
+                           const QString &stats = SUSPEND_STATS_PATH);
+    void setClock(Clock *clock);
+    void setSaving(bool enabled);
+
+    void suspending(double energy = -1);
+    void resuming();
+    void resumedEnergy(double energy);
+    void ready(Stage stage);
+    double drainRate();
+    int minutesToReserve(double energy, double full, int reserve);
+
+    bool isSuspended();
+    QList<Cycle> cycles();
+    Cycle last();
+    void reload();
+    QVariantMap report();
+
+    static QString stageName(int stage);
+    static QVariantMap kernelStats(const QString &path = SUSPEND_STATS_PATH);
+
+private:
+    QString file;
+    QString statsPath;
+    Clock *clock;
+    bool saving;
+    QList<Cycle> history;
+    qint64 suspendBoottime;
+    qint64 suspendMonotonic;
+    qint64 resumeMonotonic;
+    bool energyPending; // waiting for the energy after resume
+    QVariantMap statsBefore;
+
+    void save();
+};
+
+#endif // SUSPENDREPORT_H
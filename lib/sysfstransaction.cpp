@@ -0,0 +1,85 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "sysfstransaction.h"
+
+#include <QFile>
+
+QString SysfsTransaction::read(const QString &path)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly)) { return QString(); }
+    return QString::fromUtf8(file.readAll()).trimmed();
+}
+
+// unbuffered, sysfs reports a refused value on the write itself
+bool SysfsTransaction::write(const QString &path, const QString &value)
+{
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Unbuffered)) { return false; }
+    QByteArray data = value.toUtf8();
+    return file.write(data) == data.size();
+}
+
+// false if the attribute can't be read
+bool SysfsTransaction::add(const QString &path, const QString &value)
+{
+    if (!QFile::exists(path)) {
+        lastError = QString("missing %1").arg(path);
+        return false;
+    }
+    Write entry;
+    entry.path = path;
+    entry.value = value;
+    entry.previous = read(path);
+    if (entry.previous == value) { return true; }
+    pending << entry;
+    return true;
+}
+
+bool SysfsTransaction::commit()
+{
+    for (int i=0;i<pending.size();++i) {
+        if (write(pending.at(i).path, pending.at(i).value)) { continue; }
+        lastError = QString("failed to write %1 to %2")
+                    .arg(pending.at(i).value)
+                    .arg(pending.at(i).path);
+        restore(i);
+        return false;
+    }
+    return true;
+}
+
+bool SysfsTransaction::revert()
+{
+    return restore(pending.size());
+}
+
+bool SysfsTransaction::restore(int count)
+{
+    bool result = true;
+    for (int i=0;i<count && i<pending.size();++i) {
+        if (!write(pending.at(i).path, pending.at(i).previous)) { result = false; }
+    }
+    return result;
+}
+
+int SysfsTransaction::size()
+{
+    return pending.size();
+}
+
+QList<SysfsTransaction::Write> SysfsTransaction::writes()
+{
+    return pending;
+}
+
+QString SysfsTransaction::error()
+{
+    return lastError;
+}
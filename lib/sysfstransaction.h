@@ -0,0 +1,49 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef SYSFSTRANSACTION_H
+#define SYSFSTRANSACTION_H
+
+#include <QString>
+#include <QList>
+
+// A set of sysfs writes applied all or nothing.
+//
+// The current value of each attribute is read when the write is
+// added, values already in place are dropped. On a failed write the
+// attributes written so far are restored, in the order they were
+// written, as later writes may depend on earlier ones (the EPP can
+// only be set once the governor allows it).
+class SysfsTransaction
+{
+public:
+    struct Write
+    {
+        QString path;
+        QString value;
+        QString previous;
+    };
+
+    bool add(const QString &path, const QString &value);
+    bool commit();
+    bool revert(); // undo a committed transaction
+    int size();
+    QList<Write> writes();
+    QString error();
+
+    static QString read(const QString &path);
+    static bool write(const QString &path, const QString &value);
+
+private:
+    QList<Write> pending;
+    QString lastError;
+
+    bool restore(int count);
+};
+
+#endif // SYSFSTRANSACTION_H
@@ -0,0 +1,292 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "trace.h"
+#include "varint.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QElapsedTimer>
+#include <QMapIterator>
+#include <string.h>
+
+TraceEvent::TraceEvent(int type, qint64 time)
+    : time(time)
+    , type(type)
+{
+    memset(values, 0, sizeof(values));
+}
+
+int TraceEvent::valueCount(int type)
+{
+    switch(type) {
+    case TraceBattery:
+        return 4;
+    case TraceLid:
+    case TraceIdle:
+        return 3;
+    case TracePower:
+    case TraceInhibit:
+        return 2;
+    default:;
+    }
+    return 0;
+}
+
+QString TraceEvent::typeName(int type)
+{
+    switch(type) {
+    case TraceSettings: return "settings";
+    case TraceBattery: return "battery";
+    case TraceLid: return "lid";
+    case TracePower: return "power";
+    case TraceIdle: return "idle";
+    case TraceInhibit: return "inhibit";
+    case TraceActivity: return "activity";
+    case TraceSuspend: return "suspend";
+    case TraceResume: return "resume";
+    default:;
+    }
+    return "unknown";
+}
+
+TraceRecorder::TraceRecorder(const QString &path)
+    : file(path)
+    , lastTime(-1)
+{
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    if (!file.open(QIODevice::WriteOnly|QIODevice::Append)) { return; }
+    if (file.size() == 0) { file.write(TRACE_MAGIC, sizeof(TRACE_MAGIC)-1); }
+}
+
+TraceRecorder::~TraceRecorder()
+{
+    file.close();
+}
+
+bool TraceRecorder::isOpen()
+{
+    return file.isOpen();
+}
+
+QString TraceRecorder::fileName()
+{
+    return file.fileName();
+}
+
+// the first record of a session has an absolute time,
+// so sessions can be appended to the same file
+bool TraceRecorder::record(const TraceEvent &event)
+{
+    if (!file.isOpen()) { return false; }
+    QByteArray out;
+    uchar type = (uchar)event.type;
+    quint64 time = (quint64)event.time;
+    if (lastTime<0 || event.time<lastTime) { type |= TRACE_ABSOLUTE; }
+    else { time = (quint64)(event.time-lastTime); }
+    lastTime = event.time;
+
+    Varint::append(&out, time);
+    out.append((char)type);
+    for (int i=0;i<TraceEvent::valueCount(event.type);++i) {
+        Varint::append(&out, Varint::zigzag(event.values[i]));
+    }
+    if (event.type == TraceEvent::TraceSettings) {
+        QByteArray blob;
+        QDataStream stream(&blob, QIODevice::WriteOnly);
+        stream << event.data;
+        Varint::append(&out, (quint64)blob.size());
+        out.append(blob);
+    }
+    if (file.write(out) != out.size()) { return false; }
+    return file.flush();
+}
+
+QList<TraceEvent> TraceRecorder::read(const QString &path, bool *ok)
+{
+    QList<TraceEvent> result;
+    if (ok) { *ok = false; }
+    QFile in(path);
+    if (!in.open(QIODevice::ReadOnly)) { return result; }
+    QByteArray bytes = in.readAll();
+    in.close();
+    int magic = sizeof(TRACE_MAGIC)-1;
+    if (bytes.size()<magic || bytes.left(magic) != TRACE_MAGIC) { return result; }
+
+    const uchar *data = reinterpret_cast<const uchar*>(bytes.constData());
+    quint32 size = (quint32)bytes.size();
+    quint32 pos = (quint32)magic;
+    qint64 time = 0;
+    while (pos<size) {
+        quint64 value;
+        if (!Varint::get(data, size, &pos, &value) || pos>=size) { return result; }
+        uchar type = data[pos++];
+        if (type&TRACE_ABSOLUTE) { time = (qint64)value; }
+        else { time += (qint64)value; }
+        TraceEvent event(type&~TRACE_ABSOLUTE, time);
+        if (event.type>=TraceEvent::TraceTypes) { return result; }
+        for (int i=0;i<TraceEvent::valueCount(event.type);++i) {
+            if (!Varint::get(data, size, &pos, &value)) { return result; }
+            event.values[i] = Varint::unzigzag(value);
+        }
+        if (event.type == TraceEvent::TraceSettings) {
+            if (!Varint::get(data, size, &pos, &value) ||
+                value>size-pos) { return result; }
+            QByteArray blob = bytes.mid((int)pos, (int)value);
+            pos += (quint32)value;
+            QDataStream stream(blob);
+            stream >> event.data;
+        }
+        result << event;
+    }
+    if (ok) { *ok = true; }
+    return result;
+}
+
+TraceReplay::TraceReplay()
+    : recheckAt(-1)
+{
+}
+
+void TraceReplay::run(const QList<TraceEvent> &trace)
+{
+    clock = TestClock(trace.isEmpty()?0:trace.first().time);
+    policy = Policy(PowerSettings(), &clock);
+    entries.clear();
+    cost.clear();
+    recheckAt = -1;
+    lastBattery = TraceEvent();
+
+    bool suspended = false;
+    for (int i=0;i<trace.size();++i) {
+        const TraceEvent &event = trace.at(i);
+        // virtual clock, run re-checks that are due before this event
+        while (!suspended && recheckAt>=0 && recheckAt<=event.time) { recheck(); }
+        moveClock(event.time, suspended);
+        if (event.type == TraceEvent::TraceSuspend) { suspended = true; }
+        else if (event.type == TraceEvent::TraceResume) { suspended = false; }
+
+        QElapsedTimer timer;
+        timer.start();
+        Policy::Actions actions = process(event);
+        qint64 nsecs = timer.nsecsElapsed();
+        Cost &c = cost[event.type];
+        c.count++;
+        c.nsecs += nsecs;
+        if (nsecs>c.max) { c.max = nsecs; }
+        apply(event.time, i, actions);
+    }
+
+    // the battery keeps draining after the trace ends
+    int rechecks = 0;
+    while (recheckAt>=0 && rechecks++<TRACE_MAX_RECHECKS) { recheck(); }
+}
+
+QList<TraceReplay::Entry> TraceReplay::actions()
+{
+    return entries;
+}
+
+QMap<int, TraceReplay::Cost> TraceReplay::costs()
+{
+    return cost;
+}
+
+QString TraceReplay::report()
+{
+    QString result;
+    for (int i=0;i<entries.size();++i) {
+        const Entry &entry = entries.at(i);
+        result.append(QString("%1 %2 %3 %4\n")
+                      .arg(entry.time)
+                      .arg(entry.event<0?QString("recheck"):QString::number(entry.event))
+                      .arg(Policy::actionName(entry.action.type))
+                      .arg(entry.action.value));
+    }
+    result.append("\n");
+    QMapIterator<int, Cost> i(cost);
+    while (i.hasNext()) {
+        i.next();
+        result.append(QString("%1: %2 events, %3 ns avg, %4 ns max\n")
+                      .arg(TraceEvent::typeName(i.key()))
+                      .arg(i.value().count)
+                      .arg(i.value().count>0?i.value().nsecs/i.value().count:0)
+                      .arg(i.value().max));
+    }
+    return result;
+}
+
+Policy::Actions TraceReplay::process(const TraceEvent &event)
+{
+    const qint64 *v = event.values;
+    switch(event.type) {
+    case TraceEvent::TraceSettings:
+        policy.setSettings(PowerSettings::fromMap(event.data));
+        break;
+    case TraceEvent::TraceBattery:
+        lastBattery = event;
+        return policy.battery((double)v[0]/100.0, v[1] != 0, v[2], v[3]);
+    case TraceEvent::TraceLid:
+        if (v[0]) { return policy.lidClosed(v[1] != 0, v[2] != 0); }
+        return policy.lidOpened();
+    case TraceEvent::TracePower:
+        if (v[0]) { return policy.switchedToBattery((int)v[1]); }
+        return policy.switchedToAC((int)v[1]);
+    case TraceEvent::TraceIdle:
+        return policy.idle((int)v[0], v[1] != 0, v[2] != 0);
+    case TraceEvent::TraceActivity:
+    case TraceEvent::TraceResume:
+        policy.resetIdle();
+        break;
+    default:;
+    }
+    return Policy::Actions();
+}
+
+// the last battery state, with the times moved to the re-check time
+void TraceReplay::recheck()
+{
+    qint64 time = recheckAt;
+    recheckAt = -1;
+    moveClock(time, false);
+    TraceEvent event = lastBattery;
+    qint64 elapsed = (time-lastBattery.time)/1000;
+    if (event.values[2]>0) { event.values[2] = qMax((qint64)1, event.values[2]-elapsed); }
+    if (event.values[3]>0) { event.values[3] = qMax((qint64)0, event.values[3]-elapsed); }
+    Policy::Actions actions = policy.battery((double)event.values[0]/100.0,
+                                             event.values[1] != 0,
+                                             event.values[2],
+                                             event.values[3]);
+    apply(time, -1, actions);
+}
+
+void TraceReplay::moveClock(qint64 time, bool suspended)
+{
+    qint64 delta = time-clock.wallMsecs();
+    if (delta<=0) { return; }
+    if (suspended) { clock.suspend(delta); }
+    else { clock.advance(delta); }
+}
+
+void TraceReplay::apply(qint64 time, int index, const Policy::Actions &actions)
+{
+    foreach (Policy::Action action, actions) {
+        if (action.type == Policy::ActionRecheck) {
+            recheckAt = time+(qint64)action.value*1000;
+        } else if (action.type == Policy::ActionCancelRecheck) {
+            recheckAt = -1;
+            continue; // not interesting in the report
+        }
+        Entry entry;
+        entry.time = time;
+        entry.event = index;
+        entry.action = action;
+        entries << entry;
+    }
+}
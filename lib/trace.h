@@ -0,0 +1,112 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef TRACE_H
+#define TRACE_H
+
+#include <QFile>
+#include <QList>
+#include <QMap>
+#include <QString>
+#include <QVariantMap>
+
+#include "policy.h"
+#include "clock.h"
+
+#define TRACE_MAGIC "PKTRACE1"
+#define TRACE_VALUES 4
+#define TRACE_ABSOLUTE 0x80 // type flag, time is absolute, not a delta
+#define TRACE_MAX_RECHECKS 1000 // re-checks run after the last event
+
+// one input event as seen by the tray policy
+struct TraceEvent
+{
+    enum Type {
+        TraceSettings, // data: PowerSettings map
+        TraceBattery, // percent*100, on battery, time to empty, time to critical
+        TraceLid, // closed, on battery, external monitor
+        TracePower, // on battery, backlight
+        TraceIdle, // idle minutes, on battery, inhibited
+        TraceInhibit, // type (0 = screensaver, 1 = power), count
+        TraceActivity, // idle reset (inhibitor activity)
+        TraceSuspend,
+        TraceResume,
+        TraceTypes
+    };
+    TraceEvent(int type = TraceSettings, qint64 time = 0);
+    qint64 time; // msecs
+    int type;
+    qint64 values[TRACE_VALUES];
+    QVariantMap data;
+
+    static int valueCount(int type);
+    static QString typeName(int type);
+};
+
+// Append only trace of the tray inputs.
+//
+// Each record is a varint time delta (msecs), a type byte and the
+// event values as zigzag varints, settings are a length prefixed
+// QDataStream blob. A few bytes per event.
+class TraceRecorder
+{
+public:
+    explicit TraceRecorder(const QString &path);
+    ~TraceRecorder();
+    bool isOpen();
+    QString fileName();
+    bool record(const TraceEvent &event);
+
+    static QList<TraceEvent> read(const QString &path, bool *ok = NULL);
+
+private:
+    QFile file;
+    qint64 lastTime;
+};
+
+// Feeds a trace through Policy on a virtual clock, as fast as possible.
+// Requested battery re-checks are run at their virtual time, the
+// monotonic clock is stopped between a suspend and resume event.
+class TraceReplay
+{
+public:
+    struct Entry
+    {
+        qint64 time;
+        int event; // index of the event, -1 for a re-check
+        Policy::Action action;
+    };
+    struct Cost
+    {
+        Cost() : count(0), nsecs(0), max(0) {}
+        qlonglong count;
+        qint64 nsecs;
+        qint64 max;
+    };
+
+    TraceReplay();
+    void run(const QList<TraceEvent> &trace);
+    QList<Entry> actions();
+    QMap<int, Cost> costs();
+    QString report();
+
+private:
+    TestClock clock;
+    Policy policy;
+    QList<Entry> entries;
+    QMap<int, Cost> cost;
+    qint64 recheckAt;
+    TraceEvent lastBattery;
+
+    Policy::Actions process(const TraceEvent &event);
+    void recheck();
+    void moveClock(qint64 time, bool suspended);
+    void apply(qint64 time, int index, const Policy::Actions &actions);
+};
+
+#endif // TRACE_H
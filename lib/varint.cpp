@@ -0,0 +1,56 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "varint.h"
+
+int Varint::put(uchar *out, quint64 value)
+{
+    int len = 0;
+    while (value>=0x80) {
+        out[len++] = (uchar)(value|0x80);
+        value >>= 7;
+    }
+    out[len++] = (uchar)value;
+    return len;
+}
+
+void Varint::append(QByteArray *out, quint64 value)
+{
+    uchar buffer[VARINT_MAX_SIZE];
+    int len = put(buffer, value);
+    out->append(reinterpret_cast<const char*>(buffer), len);
+}
+
+bool Varint::get(const uchar *data,
+                 quint32 size,
+                 quint32 *pos,
+                 quint64 *value)
+{
+    quint64 result = 0;
+    int shift = 0;
+    while (*pos<size && shift<64) {
+        uchar byte = data[(*pos)++];
+        result |= (quint64)(byte&0x7f)<<shift;
+        if (!(byte&0x80)) {
+            *value = result;
+            return true;
+        }
+        shift += 7;
+    }
+    return false;
+}
+
+quint64 Varint::zigzag(qint64 value)
+{
+    return ((quint64)value<<1)^(quint64)(value>>63);
+}
+
+qint64 Varint::unzigzag(quint64 value)
+{
+    return (qint64)(value>>1)^-(qint64)(value&1);
+}
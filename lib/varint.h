@@ -0,0 +1,29 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef VARINT_H
+#define VARINT_H
+
+#include <QtGlobal>
+#include <QByteArray>
+
+#define VARINT_MAX_SIZE 10
+
+// LEB128 style variable length integers, zigzag for signed values.
+// used by the history ring and the trace files.
+class Varint
+{
+public:
+    static int put(uchar *out, quint64 value);
+    static void append(QByteArray *out, quint64 value);
+    static bool get(const uchar *data, quint32 size, quint32 *pos, quint64 *value);
+    static quint64 zigzag(qint64 value);
+    static qint64 unzigzag(quint64 value);
+};
+
+#endif // VARINT_H
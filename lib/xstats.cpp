@@ -0,0 +1,114 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#include "xstats.h"
+
+#include <QMap>
+#include <QMapIterator>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include <X11/Xlib.h>
+
+struct XStatsTotal
+{
+    XStatsTotal() : calls(0), requests(0), roundTrips(0) {}
+    qlonglong calls;
+    qlonglong requests;
+    qlonglong roundTrips;
+};
+
+struct XStatsDisplay
+{
+    int (*previous)(Display*);
+    unsigned long lastRead;
+    qlonglong roundTrips;
+};
+
+static QMutex xstatsMutex;
+static QMap<QString, XStatsTotal> xstatsTotals;
+static QMap<Display*, XStatsDisplay> xstatsDisplays;
+
+// Xlib after function, runs at the end of every request
+static int xstatsAfter(Display *dpy)
+{
+    int (*previous)(Display*) = NULL;
+    {
+        QMutexLocker lock(&xstatsMutex);
+        QMap<Display*, XStatsDisplay>::iterator it = xstatsDisplays.find(dpy);
+        if (it == xstatsDisplays.end()) { return 0; }
+        unsigned long read = LastKnownRequestProcessed(dpy);
+        if (read != it.value().lastRead) {
+            it.value().roundTrips++;
+            it.value().lastRead = read;
+        }
+        previous = it.value().previous;
+    }
+    if (previous) { return previous(dpy); }
+    return 0;
+}
+
+XStats::Scope::Scope(Display *dpy, const char *operation)
+    : dpy(dpy)
+    , operation(operation)
+    , firstRequest(0)
+    , active(false)
+{
+    if (dpy == NULL) { return; }
+    QMutexLocker lock(&xstatsMutex);
+    if (xstatsDisplays.contains(dpy)) { return; }
+    XStatsDisplay state;
+    state.lastRead = LastKnownRequestProcessed(dpy);
+    state.roundTrips = 0;
+    state.previous = NULL;
+    xstatsDisplays[dpy] = state;
+    lock.unlock();
+    // the previous after function (XSynchronize) keeps running
+    int (*previous)(Display*) = XSetAfterFunction(dpy, xstatsAfter);
+    lock.relock();
+    if (previous != xstatsAfter) { xstatsDisplays[dpy].previous = previous; }
+    firstRequest = NextRequest(dpy);
+    active = true;
+}
+
+XStats::Scope::~Scope()
+{
+    if (!active) { return; }
+    unsigned long requests = NextRequest(dpy)-firstRequest;
+    QMutexLocker lock(&xstatsMutex);
+    XStatsDisplay state = xstatsDisplays.take(dpy);
+    lock.unlock();
+    XSetAfterFunction(dpy, state.previous);
+    lock.relock();
+    XStatsTotal &total = xstatsTotals[operation];
+    total.calls++;
+    total.requests += requests;
+    total.roundTrips += state.roundTrips;
+}
+
+QVariantMap XStats::stats()
+{
+    QVariantMap result;
+    QMutexLocker lock(&xstatsMutex);
+    QMapIterator<QString, XStatsTotal> i(xstatsTotals);
+    while (i.hasNext()) {
+        i.next();
+        QVariantMap op;
+        op["calls"] = i.value().calls;
+        op["requests"] = i.value().requests;
+        op["round_trips"] = i.value().roundTrips;
+        result[i.key()] = op;
+    }
+    return result;
+}
+
+void XStats::reset()
+{
+    QMutexLocker lock(&xstatsMutex);
+    xstatsTotals.clear();
+}
@@ -0,0 +1,45 @@
+/*
+# PowerKit <https://github.com/rodlie/powerkit>
+# Copyright (c) 2019, Ole-André Rodlie <ole.andre.rodlie@gmail.com> All rights reserved.
+#
+# Available under the 3-clause BSD license
+# See the LICENSE file for full details
+*/
+
+#ifndef XSTATS_H
+#define XSTATS_H
+
+#include <QString>
+#include <QVariantMap>
+
+typedef struct _XDisplay Display;
+
+// X11 request accounting per high level operation.
+//
+// Requests are the change in the request sequence number, round
+// trips are counted from an Xlib after function: a request that
+// waited for a reply moves the last processed sequence number.
+// Counts are process wide and thread safe, one scope per display
+// at a time (nested scopes on the same display count in the outer).
+class XStats
+{
+public:
+    class Scope
+    {
+    public:
+        Scope(Display *dpy, const char *operation);
+        ~Scope();
+
+    private:
+        Display *dpy;
+        const char *operation;
+        unsigned long firstRequest;
+        bool active;
+    };
+
+    // operation -> calls, requests, round_trips
+    static QVariantMap stats();
+    static void reset();
+};
+
+#endif // XSTATS_H
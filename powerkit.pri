@@ -28,4 +28,6 @@ CONFIG(release, debug|release) {
     CONFIG += staticlib
 }
 
-LIBS += -lX11 -lXss -lXrandr
+CONFIG(sdt): DEFINES += HAVE_SDT
+
+LIBS += -lX11 -lXss -lXrandr -lXext
@@ -11,3 +11,7 @@ CONFIG -= ordered
 SUBDIRS += lib app daemon
 app.depends += lib
 daemon.depends += lib
+CONFIG(bench) {
+    SUBDIRS += bench
+    bench.depends += lib
+}